@@ -14,8 +14,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> /* for strchr */
+#include <stdint.h> /* for int32_t, uint16_t */
+#include <limits.h> /* for LONG_MAX */
 // #include <ctype.h> /* for toupper */
 #include "characters_to_base.h" /* mapping from char to base */
+#include "sequence_encoding.h"  /* for the codes of the bases */
+#include "thread_pool.h"        /* for the parallel implementation */
 
 /*****************************************************************************/
 
@@ -191,25 +195,52 @@ long min(long a, long b, long c)
    }
 }
 
-long EditDistance_NW_Iter(char *A, size_t lengthA, char *B, size_t lengthB)
-{
-   _init_base_match();
-   struct NW_MemoContext ctx;
+/*****************************************************************************/
+/* Iterative implementations on encoded sequences
+ * Characters that do not match a base (SKIP_BASE, eg '\n') cost 0 in every case of the recurrence:
+ * phi(i,j) = phi(i+1,j) if X[i] is skipped, phi(i,j) = phi(i,j+1) if Y[j] is skipped.
+ * So the distance between two sequences is the distance between the same sequences where those
+ * characters are removed (cf sequence_encoding.h): the engines below work on the codes of the bases,
+ * with branch-free inner loops.
+ */
+
+/** \def SubstitutionCost(x, y)
+ * \brief cost of the substitution between two base codes x and y (neither being SKIP_BASE)
+ * A substitution that involves an unknown base costs SUBSTITUTION_UNKNOWN_COST, even between two N.
+ */
+#define SubstitutionCost(x, y) \
+   (((x) == UNKOWN_BASE || (y) == UNKOWN_BASE) ? SUBSTITUTION_UNKNOWN_COST : ((x) == (y) ? 0 : SUBSTITUTION_COST))
 
-   if (lengthA >= lengthB)
+/*
+ * \brief encodes A and B in seqA and seqB (to be freed by EncodedSequence_Free), and initializes ctx
+ * with their codes: X the longest encoded sequence, Y the shortest
+ */
+static void _NW_EncodeContext(char *A, size_t lengthA, char *B, size_t lengthB,
+                              struct EncodedSequence *seqA, struct EncodedSequence *seqB, struct NW_MemoContext *ctx)
+{
+   EncodeSequence(A, lengthA, seqA);
+   EncodeSequence(B, lengthB, seqB);
+   if (seqA->length >= seqB->length)
    {
-      ctx.X = A;
-      ctx.M = lengthA;
-      ctx.Y = B;
-      ctx.N = lengthB;
+      ctx->X = (char *)seqA->codes;
+      ctx->M = seqA->length;
+      ctx->Y = (char *)seqB->codes;
+      ctx->N = seqB->length;
    }
    else
    {
-      ctx.X = B;
-      ctx.M = lengthB;
-      ctx.Y = A;
-      ctx.N = lengthA;
+      ctx->X = (char *)seqB->codes;
+      ctx->M = seqB->length;
+      ctx->Y = (char *)seqA->codes;
+      ctx->N = seqA->length;
    }
+}
+
+long EditDistance_NW_Iter(char *A, size_t lengthA, char *B, size_t lengthB)
+{
+   struct EncodedSequence seqA, seqB;
+   struct NW_MemoContext ctx;
+   _NW_EncodeContext(A, lengthA, B, lengthB, &seqA, &seqB, &ctx);
    size_t M = ctx.M;
    size_t N = ctx.N;
 
@@ -222,7 +253,7 @@ long EditDistance_NW_Iter(char *A, size_t lengthA, char *B, size_t lengthB)
    Y_col[N] = 0;
    for (int row = N - 1; row >= 0; row--)
    {
-      Y_col[row] = (isBase(ctx.Y[row]) ? INSERTION_COST : 0) + Y_col[row + 1];
+      Y_col[row] = INSERTION_COST + Y_col[row + 1];
    }
 
    long prev_value;
@@ -234,22 +265,11 @@ long EditDistance_NW_Iter(char *A, size_t lengthA, char *B, size_t lengthB)
          if (row == N)
          {
             prev_value = Y_col[row];
-            Y_col[row] = (isBase(ctx.X[col]) ? INSERTION_COST : 0) + Y_col[row];
-         }
-         else if (!isBase(ctx.X[col]))
-         {
-            prev_value = Y_col[row];
-            ManageBaseError(ctx.X[col]);
-         }
-         else if (!isBase(ctx.Y[row]))
-         {
-            prev_value = Y_col[row];
-            Y_col[row] = Y_col[row + 1];
-            ManageBaseError(ctx.Y[row]);
+            Y_col[row] = INSERTION_COST + Y_col[row];
          }
          else
          {
-            long diag = (isUnknownBase(ctx.X[col]) ? SUBSTITUTION_UNKNOWN_COST : (isSameBase(ctx.X[col], ctx.Y[row]) ? 0 : SUBSTITUTION_COST)) + prev_value;
+            long diag = SubstitutionCost(ctx.X[col], ctx.Y[row]) + prev_value;
             long top = INSERTION_COST + Y_col[row + 1];
             long right = INSERTION_COST + Y_col[row];
             prev_value = Y_col[row];
@@ -259,28 +279,16 @@ long EditDistance_NW_Iter(char *A, size_t lengthA, char *B, size_t lengthB)
    }
    long res = Y_col[0];
    free(Y_col);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
    return res;
 }
 
 long EditDistance_NW_Iter_CA(char *A, size_t lengthA, char *B, size_t lengthB)
 {
-   _init_base_match();
+   struct EncodedSequence seqA, seqB;
    struct NW_MemoContext ctx;
-
-   if (lengthA >= lengthB)
-   {
-      ctx.X = A;
-      ctx.M = lengthA;
-      ctx.Y = B;
-      ctx.N = lengthB;
-   }
-   else
-   {
-      ctx.X = B;
-      ctx.M = lengthB;
-      ctx.Y = A;
-      ctx.N = lengthA;
-   }
+   _NW_EncodeContext(A, lengthA, B, lengthB, &seqA, &seqB, &ctx);
    size_t M = ctx.M;
    size_t N = ctx.N;
 
@@ -293,7 +301,7 @@ long EditDistance_NW_Iter_CA(char *A, size_t lengthA, char *B, size_t lengthB)
    Y_col[N] = 0;
    for (int row = N - 1; row >= 0; row--)
    {
-      Y_col[row] = (isBase(ctx.Y[row]) ? INSERTION_COST : 0) + Y_col[row + 1];
+      Y_col[row] = INSERTION_COST + Y_col[row + 1];
    }
    long prev_value;
    long K = 100;
@@ -330,33 +338,14 @@ long EditDistance_NW_Iter_CA(char *A, size_t lengthA, char *B, size_t lengthB)
                if (row == N)
                {
                   prev_value = Y_col[row];
-                  Y_col[row] = (isBase(ctx.X[col]) ? INSERTION_COST : 0) + Y_col[row];
-               }
-               else if (!isBase(ctx.X[col]))
-               {
-                  prev_value = Y_col[row];
-                  ManageBaseError(ctx.X[col]);
-               }
-               else if (!isBase(ctx.Y[row]))
-               {
-                  prev_value = Y_col[row];
-                  if (counter_row == max_rows)
-                  {
-                     Y_col[row] = K_row[counter_col + K_row_length - max_cols];
-                  }
-                  else
-                  {
-
-                     Y_col[row] = Y_col[row + 1];
-                  }
-                  ManageBaseError(ctx.Y[row]);
+                  Y_col[row] = INSERTION_COST + Y_col[row];
                }
                else
                {
                   if (k_row == number_of_K_rows - 1 || counter_row != max_rows)
                   {
 
-                     diag = (isUnknownBase(ctx.X[col]) ? SUBSTITUTION_UNKNOWN_COST : (isSameBase(ctx.X[col], ctx.Y[row]) ? 0 : SUBSTITUTION_COST)) + prev_value;
+                     diag = SubstitutionCost(ctx.X[col], ctx.Y[row]) + prev_value;
                      top = INSERTION_COST + Y_col[row + 1];
                      right = INSERTION_COST + Y_col[row];
                      prev_value = Y_col[row];
@@ -368,11 +357,11 @@ long EditDistance_NW_Iter_CA(char *A, size_t lengthA, char *B, size_t lengthB)
                      if (counter_col == max_cols - 1)
                      {
 
-                        diag = (isUnknownBase(ctx.X[col]) ? SUBSTITUTION_UNKNOWN_COST : (isSameBase(ctx.X[col], ctx.Y[row]) ? 0 : SUBSTITUTION_COST)) + K_row[counter_col + K_row_length - max_cols + 1];
+                        diag = SubstitutionCost(ctx.X[col], ctx.Y[row]) + K_row[counter_col + K_row_length - max_cols + 1];
                      }
                      else
                      {
-                        diag = (isUnknownBase(ctx.X[col]) ? SUBSTITUTION_UNKNOWN_COST : (isSameBase(ctx.X[col], ctx.Y[row]) ? 0 : SUBSTITUTION_COST)) + prev_k;
+                        diag = SubstitutionCost(ctx.X[col], ctx.Y[row]) + prev_k;
                      }
 
                      top = INSERTION_COST + K_row[counter_col + K_row_length - max_cols];
@@ -395,6 +384,8 @@ long EditDistance_NW_Iter_CA(char *A, size_t lengthA, char *B, size_t lengthB)
    long res = Y_col[0];
    free(Y_col);
    free(K_row);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
    return res;
 }
 
@@ -429,25 +420,7 @@ long CalculateBlock_CO(struct NW_MemoContext ctx, long *X_row, long X_start, lon
             if (row == ctx.N)
             {
                prev_value_y = Y_col[row];
-               Y_col[row] = (isBase(ctx.X[col]) ? INSERTION_COST : 0) + Y_col[row];
-            }
-            else if (!isBase(ctx.X[col]))
-            {
-               prev_value_y = Y_col[row];
-               ManageBaseError(ctx.X[col]);
-            }
-            else if (!isBase(ctx.Y[row]))
-            {
-               prev_value_y = Y_col[row];
-               if (row == Y_end)
-               {
-                  Y_col[row] = X_row[col];
-               }
-               else
-               {
-                  Y_col[row] = Y_col[row + 1];
-               }
-               ManageBaseError(ctx.Y[row]);
+               Y_col[row] = INSERTION_COST + Y_col[row];
             }
             else
             {
@@ -456,18 +429,18 @@ long CalculateBlock_CO(struct NW_MemoContext ctx, long *X_row, long X_start, lon
                   if (col == X_end)
                   {
 
-                     diag = (isUnknownBase(ctx.X[col]) ? SUBSTITUTION_UNKNOWN_COST : (isSameBase(ctx.X[col], ctx.Y[row]) ? 0 : SUBSTITUTION_COST)) + X_row[col + 1];
+                     diag = SubstitutionCost(ctx.X[col], ctx.Y[row]) + X_row[col + 1];
                   }
                   else
                   {
-                     diag = (isUnknownBase(ctx.X[col]) ? SUBSTITUTION_UNKNOWN_COST : (isSameBase(ctx.X[col], ctx.Y[row]) ? 0 : SUBSTITUTION_COST)) + prev_value_k;
+                     diag = SubstitutionCost(ctx.X[col], ctx.Y[row]) + prev_value_k;
                   }
                   left = INSERTION_COST + Y_col[row];
                   top = INSERTION_COST + X_row[col];
                }
                else
                {
-                  diag = (isUnknownBase(ctx.X[col]) ? SUBSTITUTION_UNKNOWN_COST : (isSameBase(ctx.X[col], ctx.Y[row]) ? 0 : SUBSTITUTION_COST)) + prev_value_y;
+                  diag = SubstitutionCost(ctx.X[col], ctx.Y[row]) + prev_value_y;
                   left = INSERTION_COST + Y_col[row];
                   top = INSERTION_COST + Y_col[row + 1];
                }
@@ -488,23 +461,9 @@ long CalculateBlock_CO(struct NW_MemoContext ctx, long *X_row, long X_start, lon
 
 long EditDistance_NW_Iter_CO(char *A, size_t lengthA, char *B, size_t lengthB)
 {
-   _init_base_match();
+   struct EncodedSequence seqA, seqB;
    struct NW_MemoContext ctx;
-
-   if (lengthA >= lengthB)
-   {
-      ctx.X = A;
-      ctx.M = lengthA;
-      ctx.Y = B;
-      ctx.N = lengthB;
-   }
-   else
-   {
-      ctx.X = B;
-      ctx.M = lengthB;
-      ctx.Y = A;
-      ctx.N = lengthA;
-   }
+   _NW_EncodeContext(A, lengthA, B, lengthB, &seqA, &seqB, &ctx);
    size_t M = ctx.M;
    size_t N = ctx.N;
 
@@ -517,14 +476,14 @@ long EditDistance_NW_Iter_CO(char *A, size_t lengthA, char *B, size_t lengthB)
    Y_col[N] = 0;
    for (int row = N - 1; row >= 0; row--)
    {
-      Y_col[row] = (isBase(ctx.Y[row]) ? INSERTION_COST : 0) + Y_col[row + 1];
+      Y_col[row] = INSERTION_COST + Y_col[row + 1];
    }
 
    long *X_row = (long *)malloc((M + 1) * sizeof(long));
    X_row[M] = 0;
    for (int row = M - 1; row >= 0; row--)
    {
-      X_row[row] = (isBase(ctx.X[row]) ? INSERTION_COST : 0) + X_row[row + 1];
+      X_row[row] = INSERTION_COST + X_row[row + 1];
    }
 
    CalculateBlock_CO(ctx, X_row, 0, M - 1, Y_col, 0, N);
@@ -532,5 +491,2619 @@ long EditDistance_NW_Iter_CO(char *A, size_t lengthA, char *B, size_t lengthB)
    long res = Y_col[0];
    free(Y_col);
    free(X_row);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return res;
+}
+/*****************************************************************************/
+/* Anti-diagonal (wavefront) vectorized implementation
+ * The forward recurrence D[i][j] = min(D[i-1][j-1] + cost(X[i-1],Y[j-1]), D[i-1][j] + INSERTION_COST, D[i][j-1] + INSERTION_COST)
+ * is evaluated by anti-diagonals d = i+j: all the cells of an anti-diagonal only depend on the two previous ones.
+ * Each anti-diagonal is stored in an array indexed by j, so with p1 (resp. p2) the anti-diagonal d-1 (resp. d-2):
+ *    D[i][j] = min(p2[j-1] + cost, p1[j] + INSERTION_COST, p1[j-1] + INSERTION_COST)
+ * X is stored reversed, so that X[i-1] = X[d-j-1] is read at increasing addresses when j increases.
+ * Cells are 32-bit integers, or 16-bit unsigned integers when INSERTION_COST*(M+N) fits.
+ * The same drivers compute the semi-global alignment (cf EditDistance_NW_SemiGlobal): the boundary cells D[i][0] are 0
+ * instead of i*INSERTION_COST (free start in X, then every cell is at most INSERTION_COST*N), and the minimum of the
+ * cells D[i][N] of the last row, computed on the anti-diagonals d = i+N, gives the end i in X.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NW_SIMD_X86 /* SSE4.1 and AVX2 kernels are compiled, and selected at runtime from the cpu features */
+#endif
+
+/** \def NW_SIMD_MAXLANES
+ * \brief maximum number of cells computed by one vector instruction (16-bit lanes of AVX2); kernels may overrun by this amount
+ */
+#define NW_SIMD_MAXLANES 16
+
+/*
+ * Kernels computing count consecutive cells of an anti-diagonal, starting at j = jlo:
+ *    cur = &D_d[jlo], p1 = &D_{d-1}[jlo], p2 = &D_{d-2}[jlo-1], x = &X[d-jlo-1] (reversed X), y = &Y[jlo-1]
+ * They may compute (and store) up to NW_SIMD_MAXLANES-1 cells after the last one.
+ */
+typedef void (*NW_AntiDiagKernel32)(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                    const unsigned char *x, const unsigned char *y, size_t count);
+typedef void (*NW_AntiDiagKernel16)(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                    const unsigned char *x, const unsigned char *y, size_t count);
+
+static void _NW_AntiDiag_Scalar32(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                  const unsigned char *x, const unsigned char *y, size_t count)
+{
+   for (size_t j = 0; j < count; ++j)
+   {
+      int32_t best = p2[j] + SubstitutionCost(x[j], y[j]);
+      int32_t up = p1[j] + INSERTION_COST;
+      int32_t left = p1[j - 1] + INSERTION_COST;
+      if (up < best)
+         best = up;
+      if (left < best)
+         best = left;
+      cur[j] = best;
+   }
+}
+
+static void _NW_AntiDiag_Scalar16(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                  const unsigned char *x, const unsigned char *y, size_t count)
+{
+   for (size_t j = 0; j < count; ++j)
+   {
+      uint16_t best = p2[j] + SubstitutionCost(x[j], y[j]);
+      uint16_t up = p1[j] + INSERTION_COST;
+      uint16_t left = p1[j - 1] + INSERTION_COST;
+      if (up < best)
+         best = up;
+      if (left < best)
+         best = left;
+      cur[j] = best;
+   }
+}
+
+#ifdef NW_SIMD_X86
+/*
+ * \brief substitution costs (one byte per lane) between the base codes of two vectors of bytes
+ */
+__attribute__((target("sse4.1"))) static inline __m128i _NW_SubstitutionCost_Epi8(__m128i x, __m128i y)
+{
+   const __m128i unknown = _mm_set1_epi8(UNKOWN_BASE);
+   __m128i same = _mm_cmpeq_epi8(x, y);
+   __m128i involves_unknown = _mm_or_si128(_mm_cmpeq_epi8(x, unknown), _mm_cmpeq_epi8(y, unknown));
+   __m128i cost = _mm_andnot_si128(same, _mm_set1_epi8(SUBSTITUTION_COST));
+   return _mm_blendv_epi8(cost, _mm_set1_epi8(SUBSTITUTION_UNKNOWN_COST), involves_unknown);
+}
+
+__attribute__((target("sse4.1"))) static void _NW_AntiDiag_Sse41_32(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                                                    const unsigned char *x, const unsigned char *y, size_t count)
+{
+   const __m128i ins = _mm_set1_epi32(INSERTION_COST);
+   for (size_t j = 0; j < count; j += 4)
+   {
+      int32_t xw, yw;
+      memcpy(&xw, x + j, sizeof(xw));
+      memcpy(&yw, y + j, sizeof(yw));
+      __m128i cost = _mm_cvtepu8_epi32(_NW_SubstitutionCost_Epi8(_mm_cvtsi32_si128(xw), _mm_cvtsi32_si128(yw)));
+      __m128i best = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(p2 + j)), cost);
+      __m128i up = _mm_loadu_si128((const __m128i *)(p1 + j));
+      __m128i left = _mm_loadu_si128((const __m128i *)(p1 + j - 1));
+      best = _mm_min_epi32(best, _mm_add_epi32(_mm_min_epi32(up, left), ins));
+      _mm_storeu_si128((__m128i *)(cur + j), best);
+   }
+}
+
+__attribute__((target("sse4.1"))) static void _NW_AntiDiag_Sse41_16(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                                                    const unsigned char *x, const unsigned char *y, size_t count)
+{
+   const __m128i ins = _mm_set1_epi16(INSERTION_COST);
+   for (size_t j = 0; j < count; j += 8)
+   {
+      __m128i cost = _mm_cvtepu8_epi16(_NW_SubstitutionCost_Epi8(_mm_loadl_epi64((const __m128i *)(x + j)),
+                                                                 _mm_loadl_epi64((const __m128i *)(y + j))));
+      __m128i best = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(p2 + j)), cost);
+      __m128i up = _mm_loadu_si128((const __m128i *)(p1 + j));
+      __m128i left = _mm_loadu_si128((const __m128i *)(p1 + j - 1));
+      best = _mm_min_epu16(best, _mm_add_epi16(_mm_min_epu16(up, left), ins));
+      _mm_storeu_si128((__m128i *)(cur + j), best);
+   }
+}
+
+__attribute__((target("avx2"))) static void _NW_AntiDiag_Avx2_32(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                                                 const unsigned char *x, const unsigned char *y, size_t count)
+{
+   const __m256i ins = _mm256_set1_epi32(INSERTION_COST);
+   for (size_t j = 0; j < count; j += 8)
+   {
+      __m256i cost = _mm256_cvtepu8_epi32(_NW_SubstitutionCost_Epi8(_mm_loadl_epi64((const __m128i *)(x + j)),
+                                                                    _mm_loadl_epi64((const __m128i *)(y + j))));
+      __m256i best = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(p2 + j)), cost);
+      __m256i up = _mm256_loadu_si256((const __m256i *)(p1 + j));
+      __m256i left = _mm256_loadu_si256((const __m256i *)(p1 + j - 1));
+      best = _mm256_min_epi32(best, _mm256_add_epi32(_mm256_min_epi32(up, left), ins));
+      _mm256_storeu_si256((__m256i *)(cur + j), best);
+   }
+}
+
+__attribute__((target("avx2"))) static void _NW_AntiDiag_Avx2_16(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                                                 const unsigned char *x, const unsigned char *y, size_t count)
+{
+   const __m256i ins = _mm256_set1_epi16(INSERTION_COST);
+   for (size_t j = 0; j < count; j += 16)
+   {
+      __m256i cost = _mm256_cvtepu8_epi16(_NW_SubstitutionCost_Epi8(_mm_loadu_si128((const __m128i *)(x + j)),
+                                                                    _mm_loadu_si128((const __m128i *)(y + j))));
+      __m256i best = _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(p2 + j)), cost);
+      __m256i up = _mm256_loadu_si256((const __m256i *)(p1 + j));
+      __m256i left = _mm256_loadu_si256((const __m256i *)(p1 + j - 1));
+      best = _mm256_min_epu16(best, _mm256_add_epi16(_mm256_min_epu16(up, left), ins));
+      _mm256_storeu_si256((__m256i *)(cur + j), best);
+   }
+}
+#endif /* NW_SIMD_X86 */
+
+/** \struct NW_Scratch
+ * \brief buffer that is kept from a computation to the next one, and only grows
+ */
+struct NW_Scratch
+{
+   void *data;      /*!< the buffer (NULL if none) */
+   size_t capacity; /*!< its size in bytes */
+};
+
+/** \def NW_ANTIDIAG_SCRATCHES
+ * \brief number of buffers used by the anti-diagonal engine: the reversed codes and the anti-diagonals
+ */
+#define NW_ANTIDIAG_SCRATCHES 2
+
+/*
+ * \brief returns the data of scratch, grown to at least bytes bytes (its previous content is lost)
+ */
+static void *_NW_ScratchGet(struct NW_Scratch *scratch, size_t bytes, const char *what)
+{
+   if (scratch->capacity < bytes)
+   {
+      free(scratch->data);
+      scratch->data = malloc(bytes);
+      if (scratch->data == NULL)
+      {
+         perror(what);
+         exit(EXIT_FAILURE);
+      }
+      scratch->capacity = bytes;
+   }
+   return scratch->data;
+}
+
+/*
+ * \brief returns the reversed copy of X[0..M-1] followed by ENCODED_SEQUENCE_PADDING bytes equal to SKIP_BASE,
+ * stored in scratch
+ */
+static unsigned char *_NW_ReversedCodes(const unsigned char *X, size_t M, struct NW_Scratch *scratch)
+{
+   unsigned char *Xr = (unsigned char *)_NW_ScratchGet(scratch, M + ENCODED_SEQUENCE_PADDING, "_NW_ReversedCodes: malloc of Xr");
+   for (size_t k = 0; k < M; ++k)
+      Xr[k] = X[M - 1 - k];
+   memset(Xr + M, SKIP_BASE, ENCODED_SEQUENCE_PADDING);
+   return Xr;
+}
+
+/*
+ * The two drivers below are identical but for the type of the cells: they iterate on the anti-diagonals d = 1..M+N,
+ * set the boundary cells D[d][0] (0 if free_start) and D[0][d] and call the kernel on the interior cells j = jlo..jhi.
+ * X and Y are compacted codes (with ENCODED_SEQUENCE_PADDING), N >= 1; the buffers are taken from scratch[0..1].
+ * They return D[M][N] if end is NULL, else the minimum of D[i][N] for i = 0..M and its first i in *end.
+ */
+static long _NW_AntiDiag32(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, NW_AntiDiagKernel32 kernel,
+                          int free_start, size_t *end, struct NW_Scratch *scratch)
+{
+   unsigned char *Xr = _NW_ReversedCodes(X, M, &scratch[0]);
+   size_t width = N + 1 + NW_SIMD_MAXLANES;
+   int32_t *diags = (int32_t *)_NW_ScratchGet(&scratch[1], 3 * width * sizeof(int32_t), "_NW_AntiDiag32: malloc of diags");
+   int32_t *p2 = diags, *p1 = diags + width, *cur = diags + 2 * width;
+   int32_t best = INT32_MAX;
+   p1[0] = 0;
+   for (size_t d = 1; d <= M + N; ++d)
+   {
+      size_t jlo = (d > M) ? d - M : 1;
+      size_t jhi = (d <= N) ? d - 1 : N;
+      if (jlo <= jhi)
+         kernel(cur + jlo, p1 + jlo, p2 + jlo - 1, Xr + M - d + jlo, Y + jlo - 1, jhi - jlo + 1);
+      if (d <= M)
+         cur[0] = free_start ? 0 : (int32_t)d * INSERTION_COST;
+      if (d <= N)
+         cur[d] = (int32_t)d * INSERTION_COST;
+      if (end != NULL && d >= N && cur[N] < best)
+      {
+         best = cur[N];
+         *end = d - N;
+      }
+      int32_t *tmp = p2;
+      p2 = p1;
+      p1 = cur;
+      cur = tmp;
+   }
+   return (end != NULL) ? best : p1[N];
+}
+
+static long _NW_AntiDiag16(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, NW_AntiDiagKernel16 kernel,
+                          int free_start, size_t *end, struct NW_Scratch *scratch)
+{
+   unsigned char *Xr = _NW_ReversedCodes(X, M, &scratch[0]);
+   size_t width = N + 1 + NW_SIMD_MAXLANES;
+   uint16_t *diags = (uint16_t *)_NW_ScratchGet(&scratch[1], 3 * width * sizeof(uint16_t), "_NW_AntiDiag16: malloc of diags");
+   uint16_t *p2 = diags, *p1 = diags + width, *cur = diags + 2 * width;
+   uint16_t best = UINT16_MAX;
+   p1[0] = 0;
+   for (size_t d = 1; d <= M + N; ++d)
+   {
+      size_t jlo = (d > M) ? d - M : 1;
+      size_t jhi = (d <= N) ? d - 1 : N;
+      if (jlo <= jhi)
+         kernel(cur + jlo, p1 + jlo, p2 + jlo - 1, Xr + M - d + jlo, Y + jlo - 1, jhi - jlo + 1);
+      if (d <= M)
+         cur[0] = free_start ? 0 : (uint16_t)(d * INSERTION_COST);
+      if (d <= N)
+         cur[d] = (uint16_t)(d * INSERTION_COST);
+      if (end != NULL && d >= N && cur[N] < best)
+      {
+         best = cur[N];
+         *end = d - N;
+      }
+      uint16_t *tmp = p2;
+      p2 = p1;
+      p1 = cur;
+      cur = tmp;
+   }
+   return (end != NULL) ? best : p1[N];
+}
+
+/*
+ * \brief as _NW_AntiDiag, the boundary cells D[i][0] being 0 if free_start, and returning the minimum of the cells
+ * D[i][N] and its first i in *end if end is not NULL (cf the drivers above); N may exceed M
+ */
+static long _NW_AntiDiagEnds(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, int free_start,
+                             size_t *end, struct NW_Scratch *scratch)
+{
+   if (N == 0)
+   {
+      if (end != NULL)
+         *end = 0;
+      return (end != NULL || free_start) ? 0 : (long)M * INSERTION_COST;
+   }
+   /* Upper bound of any cell, including the ones computed after the end of an anti-diagonal */
+   double bound = (double)INSERTION_COST * ((free_start ? 0 : M) + N + NW_SIMD_MAXLANES) + SUBSTITUTION_COST +
+                  SUBSTITUTION_UNKNOWN_COST;
+   int narrow = (bound < 65535.0);
+   if (bound >= 2147483647.0)
+      return -1; /* cannot be computed in 32-bit cells */
+   struct NW_Scratch local[NW_ANTIDIAG_SCRATCHES] = {{NULL, 0}, {NULL, 0}};
+   struct NW_Scratch *s = (scratch != NULL) ? scratch : local;
+   NW_AntiDiagKernel16 kernel16 = _NW_AntiDiag_Scalar16;
+   NW_AntiDiagKernel32 kernel32 = _NW_AntiDiag_Scalar32;
+#ifdef NW_SIMD_X86
+   if (__builtin_cpu_supports("avx2"))
+   {
+      kernel16 = _NW_AntiDiag_Avx2_16;
+      kernel32 = _NW_AntiDiag_Avx2_32;
+   }
+   else if (__builtin_cpu_supports("sse4.1"))
+   {
+      kernel16 = _NW_AntiDiag_Sse41_16;
+      kernel32 = _NW_AntiDiag_Sse41_32;
+   }
+#endif
+   long res = narrow ? _NW_AntiDiag16(X, M, Y, N, kernel16, free_start, end, s)
+                     : _NW_AntiDiag32(X, M, Y, N, kernel32, free_start, end, s);
+   if (scratch == NULL)
+   {
+      for (int k = 0; k < NW_ANTIDIAG_SCRATCHES; ++k)
+         free(local[k].data);
+   }
+   return res;
+}
+
+/*
+ * \brief distance between the compacted codes X[0..M-1] and Y[0..N-1] (N <= M) by anti-diagonals,
+ * with the widest instruction set available on the running cpu and the narrowest cells that cannot overflow.
+ * The buffers are kept in scratch[0..NW_ANTIDIAG_SCRATCHES-1] for the next call, or freed if scratch is NULL.
+ */
+static long _NW_AntiDiag(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, struct NW_Scratch *scratch)
+{
+   return _NW_AntiDiagEnds(X, M, Y, N, 0, NULL, scratch);
+}
+
+long EditDistance_NW_Simd(char *A, size_t lengthA, char *B, size_t lengthB)
+{
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   unsigned char *codesA = seqA.codes, *codesB = seqB.codes;
+   size_t nA = seqA.length, nB = seqB.length;
+   long res = (nA >= nB) ? _NW_AntiDiag(codesA, nA, codesB, nB, NULL) : _NW_AntiDiag(codesB, nB, codesA, nA, NULL);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   if (res < 0) /* too long for 32-bit cells */
+      res = EditDistance_NW_Iter(A, lengthA, B, lengthB);
+   return res;
+}
+
+/*****************************************************************************/
+/* Striped vectorized implementation (Farrar) with a query profile
+ * The sequence Y[0..N-1] is split into L segments of S = ceil(N/L) bases, L being the number of lanes:
+ * lane l of vector k holds the position p = k + l*S (ie row j = p+1 of the forward matrix D[i][j]).
+ * For each base code c, the query profile stores the vectors of the substitution costs cost(c, Y[p]), so the
+ * inner loop over the S vectors of a column only loads costs. The vertical dependency
+ * D[i][j] <= D[i][j-1] + INSERTION_COST, that crosses segments, is first propagated inside the segments,
+ * then corrected lazily: the loop stops as soon as no lane is improved anymore, which happens after a few
+ * vectors for most columns.
+ */
+
+/** \struct NW_QueryProfile
+ * \brief query profile of a sequence Y, reusable for computing the distance of Y to many sequences
+ */
+struct NW_QueryProfile
+{
+   unsigned char *Y;    /*!< compacted codes of the profiled sequence */
+   size_t N;            /*!< number of bases in Y */
+   size_t segments16;   /*!< number S of vectors of 16 lanes of 16 bits */
+   size_t segments32;   /*!< number S of vectors of 8 lanes of 32 bits */
+   uint16_t *profile16; /*!< profile16[(c*segments16 + k)*16 + l] = cost(c, Y[k + l*segments16]) */
+   int32_t *profile32;  /*!< profile32[(c*segments32 + k)*8 + l] = cost(c, Y[k + l*segments32]) */
+};
+
+/** \def NW_STRIPED_LANES16
+ * \brief number of 16-bit lanes of the striped kernels (AVX2)
+ */
+#define NW_STRIPED_LANES16 16
+/** \def NW_STRIPED_LANES32
+ * \brief number of 32-bit lanes of the striped kernels (AVX2)
+ */
+#define NW_STRIPED_LANES32 8
+
+/*
+ * \brief returns a zeroed array of size bytes aligned on 32 bytes (for AVX2 aligned loads)
+ */
+static void *_NW_AlignedCalloc(size_t size, const char *what)
+{
+   void *ptr;
+   if (posix_memalign(&ptr, 32, size == 0 ? 32 : size) != 0)
+   {
+      perror(what);
+      exit(EXIT_FAILURE);
+   }
+   memset(ptr, 0, size);
+   return ptr;
+}
+
+/*
+ * \brief returns the query profile of the codes Y[0..N-1] (followed by ENCODED_SEQUENCE_PADDING bytes), that it owns:
+ * Y is freed by NW_QueryProfile_Free
+ */
+static struct NW_QueryProfile *_NW_QueryProfile_Create(unsigned char *Y, size_t N)
+{
+   struct NW_QueryProfile *prof = (struct NW_QueryProfile *)malloc(sizeof(struct NW_QueryProfile));
+   if (prof == NULL)
+   {
+      perror("NW_QueryProfile_Build: malloc of profile");
+      exit(EXIT_FAILURE);
+   }
+   prof->Y = Y;
+   prof->N = N;
+   prof->segments16 = (N + NW_STRIPED_LANES16 - 1) / NW_STRIPED_LANES16;
+   prof->segments32 = (N + NW_STRIPED_LANES32 - 1) / NW_STRIPED_LANES32;
+   prof->profile16 = (uint16_t *)_NW_AlignedCalloc((UNKOWN_BASE + 1) * prof->segments16 * NW_STRIPED_LANES16 * sizeof(uint16_t),
+                                                   "NW_QueryProfile_Build: allocation of profile16");
+   prof->profile32 = (int32_t *)_NW_AlignedCalloc((UNKOWN_BASE + 1) * prof->segments32 * NW_STRIPED_LANES32 * sizeof(int32_t),
+                                                  "NW_QueryProfile_Build: allocation of profile32");
+   for (int c = ADENINE; c <= UNKOWN_BASE; ++c)
+   {
+      for (size_t p = 0; p < N; ++p)
+      {
+         size_t k16 = p % prof->segments16, l16 = p / prof->segments16;
+         size_t k32 = p % prof->segments32, l32 = p / prof->segments32;
+         prof->profile16[(c * prof->segments16 + k16) * NW_STRIPED_LANES16 + l16] = SubstitutionCost(c, prof->Y[p]);
+         prof->profile32[(c * prof->segments32 + k32) * NW_STRIPED_LANES32 + l32] = SubstitutionCost(c, prof->Y[p]);
+      }
+   }
+   return prof;
+}
+
+struct NW_QueryProfile *NW_QueryProfile_Build(char *Y, size_t lengthY)
+{
+   struct EncodedSequence seqY;
+   EncodeSequence(Y, lengthY, &seqY);
+   return _NW_QueryProfile_Create(seqY.codes, seqY.length);
+}
+
+void NW_QueryProfile_Free(struct NW_QueryProfile *prof)
+{
+   free(prof->Y);
+   free(prof->profile16);
+   free(prof->profile32);
+   free(prof);
+}
+
+#ifdef NW_SIMD_X86
+/*
+ * \brief shifts the lanes of v by one towards the last lane (lane l receives lane l-1), lane 0 receives fill
+ */
+__attribute__((target("avx2"))) static inline __m256i _NW_ShiftLanes_Epi16(__m256i v, uint16_t fill)
+{
+   __m256i shifted = _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08), 14);
+   return _mm256_or_si256(shifted, _mm256_setr_epi16(fill, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+}
+
+__attribute__((target("avx2"))) static inline __m256i _NW_ShiftLanes_Epi32(__m256i v, int32_t fill)
+{
+   __m256i shifted = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6));
+   return _mm256_blend_epi32(shifted, _mm256_set1_epi32(fill), 1);
+}
+
+/*
+ * The two kernels below are identical but for the type of the cells (16-bit unsigned saturated, or 32-bit signed):
+ * they compute the columns D[i][.] for i = 1..M with two arrays of S vectors (previous and current column).
+ */
+__attribute__((target("avx2"))) static long _NW_Striped_Avx2_16(const struct NW_QueryProfile *prof, const unsigned char *X, size_t M)
+{
+   const size_t S = prof->segments16;
+   const uint16_t INF = UINT16_MAX;
+   const __m256i ins = _mm256_set1_epi16(INSERTION_COST);
+   __m256i *Hprev = (__m256i *)_NW_AlignedCalloc(S * sizeof(__m256i), "_NW_Striped_Avx2_16: allocation of Hprev");
+   __m256i *Hcur = (__m256i *)_NW_AlignedCalloc(S * sizeof(__m256i), "_NW_Striped_Avx2_16: allocation of Hcur");
+   { /* D[0][j] = j * INSERTION_COST */
+      uint16_t *h = (uint16_t *)Hprev;
+      for (size_t p = 0; p < S * NW_STRIPED_LANES16; ++p)
+         h[(p % S) * NW_STRIPED_LANES16 + p / S] = (uint16_t)((p + 1) * INSERTION_COST);
+   }
+   for (size_t i = 1; i <= M; ++i)
+   {
+      const __m256i *P = (const __m256i *)(prof->profile16 + (size_t)X[i - 1] * S * NW_STRIPED_LANES16);
+      __m256i vDiag = _NW_ShiftLanes_Epi16(Hprev[S - 1], (uint16_t)((i - 1) * INSERTION_COST));
+      __m256i vF = _mm256_setr_epi16((uint16_t)((i + 1) * INSERTION_COST), INF, INF, INF, INF, INF, INF, INF,
+                                     INF, INF, INF, INF, INF, INF, INF, INF);
+      for (size_t k = 0; k < S; ++k)
+      {
+         __m256i vH = _mm256_adds_epu16(vDiag, P[k]);
+         vH = _mm256_min_epu16(vH, _mm256_adds_epu16(Hprev[k], ins));
+         vH = _mm256_min_epu16(vH, vF);
+         Hcur[k] = vH;
+         vF = _mm256_adds_epu16(vH, ins);
+         vDiag = Hprev[k];
+      }
+      /* lazy correction of the vertical dependency between segments */
+      vF = _NW_ShiftLanes_Epi16(vF, INF);
+      for (size_t k = 0;;)
+      {
+         __m256i vH = Hcur[k];
+         __m256i vMin = _mm256_min_epu16(vH, vF);
+         if ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi16(vMin, vH)) == 0xFFFFFFFFu)
+            break; /* vF >= vH on every lane */
+         Hcur[k] = vMin;
+         vF = _mm256_adds_epu16(vF, ins);
+         if (++k == S)
+         {
+            k = 0;
+            vF = _NW_ShiftLanes_Epi16(vF, INF);
+         }
+      }
+      __m256i *tmp = Hprev;
+      Hprev = Hcur;
+      Hcur = tmp;
+   }
+   size_t p = prof->N - 1;
+   long res = ((uint16_t *)Hprev)[(p % S) * NW_STRIPED_LANES16 + p / S];
+   free(Hprev);
+   free(Hcur);
    return res;
-}
\ No newline at end of file
+}
+
+__attribute__((target("avx2"))) static long _NW_Striped_Avx2_32(const struct NW_QueryProfile *prof, const unsigned char *X, size_t M)
+{
+   const size_t S = prof->segments32;
+   const int32_t INF = INT32_MAX / 2;
+   const __m256i ins = _mm256_set1_epi32(INSERTION_COST);
+   __m256i *Hprev = (__m256i *)_NW_AlignedCalloc(S * sizeof(__m256i), "_NW_Striped_Avx2_32: allocation of Hprev");
+   __m256i *Hcur = (__m256i *)_NW_AlignedCalloc(S * sizeof(__m256i), "_NW_Striped_Avx2_32: allocation of Hcur");
+   { /* D[0][j] = j * INSERTION_COST */
+      int32_t *h = (int32_t *)Hprev;
+      for (size_t p = 0; p < S * NW_STRIPED_LANES32; ++p)
+         h[(p % S) * NW_STRIPED_LANES32 + p / S] = (int32_t)((p + 1) * INSERTION_COST);
+   }
+   for (size_t i = 1; i <= M; ++i)
+   {
+      const __m256i *P = (const __m256i *)(prof->profile32 + (size_t)X[i - 1] * S * NW_STRIPED_LANES32);
+      __m256i vDiag = _NW_ShiftLanes_Epi32(Hprev[S - 1], (int32_t)((i - 1) * INSERTION_COST));
+      __m256i vF = _mm256_setr_epi32((int32_t)((i + 1) * INSERTION_COST), INF, INF, INF, INF, INF, INF, INF);
+      for (size_t k = 0; k < S; ++k)
+      {
+         __m256i vH = _mm256_add_epi32(vDiag, P[k]);
+         vH = _mm256_min_epi32(vH, _mm256_add_epi32(Hprev[k], ins));
+         vH = _mm256_min_epi32(vH, vF);
+         Hcur[k] = vH;
+         vF = _mm256_add_epi32(vH, ins);
+         vDiag = Hprev[k];
+      }
+      /* lazy correction of the vertical dependency between segments */
+      vF = _NW_ShiftLanes_Epi32(vF, INF);
+      for (size_t k = 0;;)
+      {
+         __m256i vH = Hcur[k];
+         if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(vH, vF)) == 0)
+            break; /* vF >= vH on every lane */
+         Hcur[k] = _mm256_min_epi32(vH, vF);
+         vF = _mm256_add_epi32(vF, ins);
+         if (++k == S)
+         {
+            k = 0;
+            vF = _NW_ShiftLanes_Epi32(vF, INF);
+         }
+      }
+      __m256i *tmp = Hprev;
+      Hprev = Hcur;
+      Hcur = tmp;
+   }
+   size_t p = prof->N - 1;
+   long res = ((int32_t *)Hprev)[(p % S) * NW_STRIPED_LANES32 + p / S];
+   free(Hprev);
+   free(Hcur);
+   return res;
+}
+#endif /* NW_SIMD_X86 */
+
+/*
+ * \brief distance between the profiled sequence and the compacted codes X[0..M-1]
+ * Without AVX2, the anti-diagonal implementation is used instead (same result).
+ */
+static long _NW_Striped(const struct NW_QueryProfile *prof, const unsigned char *X, size_t M)
+{
+   if (prof->N == 0)
+      return (long)M * INSERTION_COST;
+   if (M == 0)
+      return (long)prof->N * INSERTION_COST;
+#ifdef NW_SIMD_X86
+   if (__builtin_cpu_supports("avx2"))
+   {
+      /* Upper bound of any cell, including the padding lanes after Y[N-1] */
+      double bound = (double)INSERTION_COST * (M + prof->segments16 * NW_STRIPED_LANES16 + 2) + SUBSTITUTION_COST + SUBSTITUTION_UNKNOWN_COST;
+      if (bound < UINT16_MAX)
+         return _NW_Striped_Avx2_16(prof, X, M);
+      if (bound < INT32_MAX / 4)
+         return _NW_Striped_Avx2_32(prof, X, M);
+   }
+#endif
+   return (prof->N <= M) ? _NW_AntiDiag(X, M, prof->Y, prof->N, NULL) : _NW_AntiDiag(prof->Y, prof->N, X, M, NULL);
+}
+
+long EditDistance_NW_Striped_Profile(const struct NW_QueryProfile *prof, char *X, size_t lengthX)
+{
+   struct EncodedSequence seqX;
+   EncodeSequence(X, lengthX, &seqX);
+   long res = _NW_Striped(prof, seqX.codes, seqX.length);
+   EncodedSequence_Free(&seqX);
+   return res;
+}
+
+long EditDistance_NW_Striped(char *A, size_t lengthA, char *B, size_t lengthB)
+{
+   /* As in EditDistance_NW_Iter_CO, Y is the shortest sequence: it is the one that is profiled */
+   struct NW_QueryProfile *prof = (lengthA >= lengthB) ? NW_QueryProfile_Build(B, lengthB) : NW_QueryProfile_Build(A, lengthA);
+   long res = (lengthA >= lengthB) ? EditDistance_NW_Striped_Profile(prof, A, lengthA) : EditDistance_NW_Striped_Profile(prof, B, lengthB);
+   NW_QueryProfile_Free(prof);
+   if (res < 0) /* too long for 32-bit cells */
+      res = EditDistance_NW_Iter(A, lengthA, B, lengthB);
+   return res;
+}
+
+/*****************************************************************************/
+/* Wavefront alignment (WFA, Marco-Sola et al. 2021)
+ * Instead of computing all the cells, for increasing scores s = 0, 1, 2, ... the wavefront of score s stores,
+ * for each diagonal k = h - v (h: position in X, v: position in Y), the furthest reaching offset h such that
+ * D[h][h-k] = s. From the wavefronts of scores s - SUBSTITUTION_COST and s - INSERTION_COST:
+ *    W_s[k] = max( W_{s-SUBSTITUTION_COST}[k] + 1, W_{s-INSERTION_COST}[k-1] + 1, W_{s-INSERTION_COST}[k+1] )
+ * then W_s[k] is extended along the diagonal while the bases match (cost 0).
+ * The computation stops when the diagonal M-N reaches h = M: the distance is s.
+ * Time O((M+N) * s) and memory O(s) for a distance s, instead of O(M*N) time.
+ */
+
+/** \def WFA_NONE
+ * \brief offset of a diagonal that is not reached by a wavefront
+ */
+#define WFA_NONE (INT32_MIN / 2)
+
+/** \struct NW_Wavefront
+ * \brief furthest reaching offsets of the diagonals lo..hi for one score
+ */
+struct NW_Wavefront
+{
+   int exists;       /*!< 0 iff no cell has this score */
+   long lo;          /*!< lowest diagonal */
+   long hi;          /*!< highest diagonal */
+   int32_t *offsets; /*!< offsets[k - lo] for k in lo..hi */
+   size_t capacity;  /*!< number of allocated offsets */
+};
+
+/*
+ * \brief returns the furthest reaching offset of diagonal k in wavefront wf, or WFA_NONE
+ */
+static inline int32_t _NW_WfaOffset(const struct NW_Wavefront *wf, long k)
+{
+   return (wf != NULL && wf->exists && k >= wf->lo && k <= wf->hi) ? wf->offsets[k - wf->lo] : WFA_NONE;
+}
+
+/*
+ * \brief returns the first position h' >= h where X[h'] != Y[h'-k], comparing 8 bases at once
+ * X and Y must be followed by at least 8 padding bytes that never match each other.
+ */
+static inline int32_t _NW_WfaExtend(const unsigned char *X, const unsigned char *Y, int32_t h, long k)
+{
+   const unsigned char *x = X + h, *y = Y + (h - k);
+   for (;;)
+   {
+      uint64_t wx, wy;
+      memcpy(&wx, x, sizeof(wx));
+      memcpy(&wy, y, sizeof(wy));
+      uint64_t diff = wx ^ wy;
+      if (diff != 0)
+         return (int32_t)(x - X) + (__builtin_ctzll(diff) >> 3); /* little endian: first differing byte */
+      x += 8;
+      y += 8;
+   }
+}
+
+/*
+ * \brief distance between the compacted codes X[0..M-1] and Y[0..N-1] by wavefronts,
+ * or -1 if it is greater than max_score.
+ */
+static long _NW_Wfa(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, long max_score)
+{
+   if (SUBSTITUTION_UNKNOWN_COST != SUBSTITUTION_COST || SUBSTITUTION_COST <= 0 || INSERTION_COST <= 0 ||
+       M >= INT32_MAX / 2 || N >= INT32_MAX / 2)
+   { /* WFA needs positive costs, the same for all mismatches */
+      long res = (N <= M) ? _NW_AntiDiag(X, M, Y, N, NULL) : _NW_AntiDiag(Y, N, X, M, NULL);
+      return (res > max_score) ? -1 : res;
+   }
+   /* Copy of Y where N never matches (UNKOWN_BASE+1 is never in X) and padding never matches X padding */
+   unsigned char *Yw = (unsigned char *)malloc(N + ENCODED_SEQUENCE_PADDING);
+   if (Yw == NULL)
+   {
+      perror("_NW_Wfa: malloc of Yw");
+      exit(EXIT_FAILURE);
+   }
+   for (size_t v = 0; v < N; ++v)
+      Yw[v] = (Y[v] == UNKOWN_BASE) ? UNKOWN_BASE + 1 : Y[v];
+   memset(Yw + N, 0xFF, ENCODED_SEQUENCE_PADDING);
+
+   /* Ring of the wavefronts of the last scores */
+   const long R = (SUBSTITUTION_COST > INSERTION_COST ? SUBSTITUTION_COST : INSERTION_COST) + 1;
+   struct NW_Wavefront ring[R];
+   memset(ring, 0, sizeof(ring));
+   const long kend = (long)M - (long)N;
+   long res = -1;
+
+   for (long s = 0; s <= max_score; ++s)
+   {
+      struct NW_Wavefront *wf = &ring[s % R];
+      struct NW_Wavefront *wfX = (s >= SUBSTITUTION_COST) ? &ring[(s - SUBSTITUTION_COST) % R] : NULL;
+      struct NW_Wavefront *wfG = (s >= INSERTION_COST) ? &ring[(s - INSERTION_COST) % R] : NULL;
+      long lo, hi;
+      if (s == 0)
+         lo = hi = 0;
+      else
+      {
+         int hasX = (wfX != NULL && wfX->exists), hasG = (wfG != NULL && wfG->exists);
+         if (!hasX && !hasG)
+         {
+            wf->exists = 0;
+            continue;
+         }
+         lo = hasX ? wfX->lo : wfG->lo - 1;
+         hi = hasX ? wfX->hi : wfG->hi + 1;
+         if (hasG && wfG->lo - 1 < lo)
+            lo = wfG->lo - 1;
+         if (hasG && wfG->hi + 1 > hi)
+            hi = wfG->hi + 1;
+         if (lo < -(long)N)
+            lo = -(long)N;
+         if (hi > (long)M)
+            hi = (long)M;
+      }
+      size_t width = hi - lo + 1;
+      if (wf->capacity < width)
+      { /* wf is overwritten: its previous content (score s - R) is not needed anymore */
+         free(wf->offsets);
+         wf->capacity = 2 * width;
+         wf->offsets = (int32_t *)malloc(wf->capacity * sizeof(int32_t));
+         if (wf->offsets == NULL)
+         {
+            perror("_NW_Wfa: malloc of wavefront");
+            exit(EXIT_FAILURE);
+         }
+      }
+      int32_t *offsets = wf->offsets;
+      for (long k = lo; k <= hi; ++k)
+      {
+         int32_t h;
+         if (s == 0)
+            h = 0;
+         else
+         {
+            h = _NW_WfaOffset(wfX, k);
+            if (h != WFA_NONE)
+               h = h + 1; /* substitution */
+            int32_t hG = _NW_WfaOffset(wfG, k - 1);
+            if (hG != WFA_NONE && hG + 1 > h)
+               h = hG + 1; /* insertion of X[h] */
+            hG = _NW_WfaOffset(wfG, k + 1);
+            if (hG > h)
+               h = hG; /* insertion of Y[v] */
+         }
+         if (h != WFA_NONE && (h > (long)M || h - k > (long)N || h - k < 0))
+            h = WFA_NONE;
+         if (h != WFA_NONE)
+            h = _NW_WfaExtend(X, Yw, h, k);
+         offsets[k - lo] = h;
+      }
+      wf->exists = 1;
+      wf->lo = lo;
+      wf->hi = hi;
+      if (_NW_WfaOffset(wf, kend) >= (long)M)
+      {
+         res = s;
+         break;
+      }
+   }
+   for (long r = 0; r < R; ++r)
+      free(ring[r].offsets);
+   free(Yw);
+   return res;
+}
+
+long EditDistance_NW_Wfa(char *A, size_t lengthA, char *B, size_t lengthB)
+{
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   unsigned char *codesA = seqA.codes, *codesB = seqB.codes;
+   size_t nA = seqA.length, nB = seqB.length;
+   long res = (nA >= nB) ? _NW_Wfa(codesA, nA, codesB, nB, LONG_MAX) : _NW_Wfa(codesB, nB, codesA, nA, LONG_MAX);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return res;
+}
+
+/*****************************************************************************/
+/* Banded implementation with Ukkonen doubling
+ * Same backward sweep as EditDistance_NW_Iter (columns col = M-1..0, rows descending), but only the cells of
+ * the diagonals d = row - col in [N-M-w, w] are computed. Both corners (0,0) (diagonal 0) and (M,N) (diagonal N-M)
+ * are in the band. The column is stored by diagonal instead of by row: band[d] holds phi(col, col+d),
+ * so the single column has M-N+2w+1 cells and is updated in place, as Y_col in EditDistance_NW_Iter:
+ * when computing diagonal d, band[d+1] is already phi(col, row+1), band[d] still phi(col+1, row+1) and
+ * band[d-1] still phi(col+1, row).
+ * A path that leaves the band reaches a diagonal w+1 or N-M-w-1, so it makes at least 2(w+1)+(M-N) insertions:
+ * if the result in the band is <= INSERTION_COST * (2(w+1) + M-N), it is the distance; else w is doubled.
+ */
+
+/** \def NW_BAND_INITIAL_WIDTH
+ * \brief initial half width w of the band of EditDistance_NW_Banded
+ */
+#define NW_BAND_INITIAL_WIDTH 32
+
+/** \def NW_INFINITE_COST
+ * \brief cost of the cells out of the band (large enough to never be chosen, small enough to never overflow)
+ */
+#define NW_INFINITE_COST (LONG_MAX / 4)
+
+/*
+ * \brief distance between the compacted codes X[0..M-1] and Y[0..N-1] (N <= M) restricted to the paths in the band
+ * of diagonals [N-M-w, w]; or -1 as soon as it is known to be greater than threshold.
+ * Any path from (0,0) to a cell of diagonal d costs at least INSERTION_COST*|d|, so the computation is abandoned
+ * when phi(col, col+d) + INSERTION_COST*|d| > threshold for every cell of a column.
+ */
+static long _NW_BandedPass(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, long w, long threshold)
+{
+   const long dlo = (long)N - (long)M - w, dhi = w;
+   const long width = dhi - dlo + 1;
+   long *cells = (long *)malloc((width + 2) * sizeof(long));
+   if (cells == NULL)
+   {
+      perror("_NW_BandedPass: malloc of band");
+      exit(EXIT_FAILURE);
+   }
+   long *band = cells + 1 - dlo; /* band[d] for d in dlo-1..dhi+1, the two extreme ones being sentinels */
+   for (long d = dlo - 1; d <= dhi + 1; ++d)
+      band[d] = NW_INFINITE_COST;
+   for (long d = dlo; d <= dhi; ++d) /* column M: phi(M, row) = (N-row) * INSERTION_COST */
+   {
+      long row = (long)M + d;
+      if (row >= 0 && row <= (long)N)
+         band[d] = ((long)N - row) * INSERTION_COST;
+   }
+   long res = -1;
+   for (long col = (long)M - 1; col >= 0; col--)
+   {
+      long dmax = ((long)N - col < dhi) ? (long)N - col : dhi;
+      long dmin = (-col > dlo) ? -col : dlo;
+      unsigned char x = X[col];
+      long lower_bound = NW_INFINITE_COST;
+      if (dmax == (long)N - col) /* row N */
+      {
+         band[dmax] = ((long)M - col) * INSERTION_COST;
+         lower_bound = band[dmax] + INSERTION_COST * labs(dmax);
+         dmax--;
+      }
+      for (long d = dmax; d >= dmin; d--)
+      {
+         long diag = band[d] + SubstitutionCost(x, Y[col + d]);
+         long right = band[d - 1] + INSERTION_COST;
+         long down = band[d + 1] + INSERTION_COST;
+         long best = (right < diag) ? right : diag;
+         best = (down < best) ? down : best;
+         band[d] = best;
+         best += INSERTION_COST * labs(d);
+         if (best < lower_bound)
+            lower_bound = best;
+      }
+      if (lower_bound > threshold)
+         goto abandon;
+   }
+   res = (band[0] > threshold) ? -1 : band[0];
+abandon:
+   free(cells);
+   return res;
+}
+
+/*
+ * \brief distance between the compacted codes X[0..M-1] and Y[0..N-1] (N <= M), doubling the band until the result is exact
+ */
+static long _NW_Banded(const unsigned char *X, size_t M, const unsigned char *Y, size_t N)
+{
+   for (long w = NW_BAND_INITIAL_WIDTH;; w *= 2)
+   {
+      long res = _NW_BandedPass(X, M, Y, N, w, NW_INFINITE_COST);
+      if (w >= (long)N || res <= INSERTION_COST * (2 * (w + 1) + (long)(M - N)))
+         return res;
+   }
+}
+
+long EditDistance_NW_Banded(char *A, size_t lengthA, char *B, size_t lengthB)
+{
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   unsigned char *codesA = seqA.codes, *codesB = seqB.codes;
+   size_t nA = seqA.length, nB = seqB.length;
+   long res = (nA >= nB) ? _NW_Banded(codesA, nA, codesB, nB) : _NW_Banded(codesB, nB, codesA, nA);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return res;
+}
+
+/*****************************************************************************/
+/* Threshold query: is the distance <= k ?
+ * A path of cost <= k makes at most k/INSERTION_COST insertions, so it stays in the band of half width
+ * w = (k/INSERTION_COST - (M-N)) / 2 (cf _NW_Banded): a single banded pass with early abandon is enough,
+ * in time O(k*M / INSERTION_COST) whatever the distance.
+ */
+
+long EditDistance_NW_Threshold(char *A, size_t lengthA, char *B, size_t lengthB, long k)
+{
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   unsigned char *codesA = seqA.codes, *codesB = seqB.codes;
+   size_t nA = seqA.length, nB = seqB.length;
+   const unsigned char *X = (nA >= nB) ? codesA : codesB, *Y = (nA >= nB) ? codesB : codesA;
+   size_t M = (nA >= nB) ? nA : nB, N = (nA >= nB) ? nB : nA;
+   long res = NW_DISTANCE_ABOVE_THRESHOLD;
+   long insertions = (k < 0) ? -1 : k / INSERTION_COST - (long)(M - N);
+   if (insertions >= 0)
+   {
+      long w = insertions / 2;
+      if (w > (long)N)
+         w = (long)N;
+      res = _NW_BandedPass(X, M, Y, N, w, k);
+      if (res < 0)
+         res = NW_DISTANCE_ABOVE_THRESHOLD;
+   }
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return res;
+}
+
+/*****************************************************************************/
+/* Parallel implementation by a wavefront of tiles
+ * As in CalculateBlock_CO, the matrix is split into blocks that only communicate through the single row X_row and
+ * the single column Y_col: here the blocks are tiles of NW_TILE_SIZE x NW_TILE_SIZE cells. In the backward sweep,
+ * tile (ci, ri) only depends on its right neighbour (ci+1, ri), that computes Y_col[rows of ri], and on its lower
+ * neighbour (ci, ri+1), that computes X_row[cols of ci]; tiles of a same anti-diagonal of tiles use disjoint parts of
+ * X_row and Y_col, so they are executed in parallel by the threads of the pool as soon as both neighbours are done.
+ * The value phi at the lower right corner of each tile, that is overwritten in X_row before the tile is computed,
+ * is kept in the array corners.
+ */
+
+/** \def NW_TILE_SIZE
+ * \brief number of rows and of columns of a tile of the parallel implementation
+ */
+#define NW_TILE_SIZE 256
+
+/** \struct NW_TileContext
+ * \brief data shared by all the tiles of the parallel implementation
+ */
+struct NW_TileContext
+{
+   const unsigned char *X; /*!< compacted codes of the longest sequence */
+   const unsigned char *Y; /*!< compacted codes of the shortest sequence */
+   size_t M;               /*!< number of bases in X */
+   size_t N;               /*!< number of bases in Y */
+   long *X_row;            /*!< X_row[col]: phi at column col on the row below the tiles computed so far */
+   long *Y_col;            /*!< Y_col[row]: phi at row row on the column right of the tiles computed so far */
+   long ncols;             /*!< number of tiles along X */
+   long nrows;             /*!< number of tiles along Y */
+   long *corners;          /*!< corners[ri*(ncols+1) + ci]: phi at the upper left cell of tile (ci, ri) */
+   atomic_int *deps;       /*!< deps[ri*ncols + ci]: number of neighbours of tile (ci, ri) not yet computed */
+   struct ThreadPool *pool;
+   struct ThreadPool_Group group;
+};
+
+/** \struct NW_Tile
+ * \brief argument of the task computing one tile
+ */
+struct NW_Tile
+{
+   struct NW_TileContext *ctx;
+   long ci; /*!< index of the tile along X */
+   long ri; /*!< index of the tile along Y */
+};
+
+static void _NW_SubmitTile(struct NW_TileContext *ctx, long ci, long ri);
+
+/*
+ * \brief task computing the cells of tile (ci, ri), then submitting its left and upper neighbours if they are ready
+ */
+static void _NW_ComputeTile(void *varg)
+{
+   struct NW_Tile *tile = (struct NW_Tile *)varg;
+   struct NW_TileContext *ctx = tile->ctx;
+   long ci = tile->ci, ri = tile->ri;
+   free(tile);
+
+   long c0 = ci * NW_TILE_SIZE, c1 = ((ci + 1) * NW_TILE_SIZE < (long)ctx->M ? (ci + 1) * NW_TILE_SIZE : (long)ctx->M) - 1;
+   long r0 = ri * NW_TILE_SIZE, r1 = ((ri + 1) * NW_TILE_SIZE < (long)ctx->N ? (ri + 1) * NW_TILE_SIZE : (long)ctx->N) - 1;
+   const unsigned char *Y = ctx->Y;
+   long *X_row = ctx->X_row, *Y_col = ctx->Y_col;
+   long corner = ctx->corners[(ri + 1) * (ctx->ncols + 1) + ci + 1]; /* phi(c1+1, r1+1) */
+   for (long col = c1; col >= c0; col--)
+   {
+      unsigned char x = ctx->X[col];
+      long down = X_row[col]; /* phi(col, r1+1) */
+      long diag = corner;     /* phi(col+1, r1+1) */
+      corner = down;
+      for (long row = r1; row >= r0; row--)
+      {
+         long right = Y_col[row]; /* phi(col+1, row) */
+         long best = diag + SubstitutionCost(x, Y[row]);
+         if (right + INSERTION_COST < best)
+            best = right + INSERTION_COST;
+         if (down + INSERTION_COST < best)
+            best = down + INSERTION_COST;
+         diag = right;
+         Y_col[row] = best;
+         down = best;
+      }
+      X_row[col] = down; /* phi(col, r0) */
+   }
+   ctx->corners[ri * (ctx->ncols + 1) + ci] = X_row[c0];
+
+   if (ci > 0 && atomic_fetch_sub(&ctx->deps[ri * ctx->ncols + ci - 1], 1) == 1)
+      _NW_SubmitTile(ctx, ci - 1, ri);
+   if (ri > 0 && atomic_fetch_sub(&ctx->deps[(ri - 1) * ctx->ncols + ci], 1) == 1)
+      _NW_SubmitTile(ctx, ci, ri - 1);
+}
+
+static void _NW_SubmitTile(struct NW_TileContext *ctx, long ci, long ri)
+{
+   struct NW_Tile *tile = (struct NW_Tile *)malloc(sizeof(struct NW_Tile));
+   if (tile == NULL)
+   {
+      perror("_NW_SubmitTile: malloc of tile");
+      exit(EXIT_FAILURE);
+   }
+   tile->ctx = ctx;
+   tile->ci = ci;
+   tile->ri = ri;
+   ThreadPool_Submit(ctx->pool, &ctx->group, _NW_ComputeTile, tile);
+}
+
+/*
+ * \brief distance between the compacted codes X[0..M-1] and Y[0..N-1] (N <= M) computed by tiles on the threads of pool
+ */
+static long _NW_Tiles(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, struct ThreadPool *pool)
+{
+   if (N == 0)
+      return (long)M * INSERTION_COST;
+   struct NW_TileContext ctx;
+   ctx.X = X;
+   ctx.Y = Y;
+   ctx.M = M;
+   ctx.N = N;
+   ctx.ncols = (M + NW_TILE_SIZE - 1) / NW_TILE_SIZE;
+   ctx.nrows = (N + NW_TILE_SIZE - 1) / NW_TILE_SIZE;
+   ctx.pool = pool;
+   atomic_init(&ctx.group.pending, 0);
+   ctx.X_row = (long *)malloc((M + 1) * sizeof(long));
+   ctx.Y_col = (long *)malloc((N + 1) * sizeof(long));
+   ctx.corners = (long *)malloc((ctx.nrows + 1) * (ctx.ncols + 1) * sizeof(long));
+   ctx.deps = (atomic_int *)malloc(ctx.nrows * ctx.ncols * sizeof(atomic_int));
+   if (ctx.X_row == NULL || ctx.Y_col == NULL || ctx.corners == NULL || ctx.deps == NULL)
+   {
+      perror("_NW_Tiles: malloc of X_row, Y_col, corners or deps");
+      exit(EXIT_FAILURE);
+   }
+   for (size_t col = 0; col <= M; ++col) /* row N: phi(col, N) */
+      ctx.X_row[col] = (long)(M - col) * INSERTION_COST;
+   for (size_t row = 0; row <= N; ++row) /* column M: phi(M, row) */
+      ctx.Y_col[row] = (long)(N - row) * INSERTION_COST;
+   for (long ci = 0; ci <= ctx.ncols; ++ci)
+      ctx.corners[ctx.nrows * (ctx.ncols + 1) + ci] = ctx.X_row[(ci * NW_TILE_SIZE < (long)M) ? ci * NW_TILE_SIZE : (long)M];
+   for (long ri = 0; ri <= ctx.nrows; ++ri)
+      ctx.corners[ri * (ctx.ncols + 1) + ctx.ncols] = ctx.Y_col[(ri * NW_TILE_SIZE < (long)N) ? ri * NW_TILE_SIZE : (long)N];
+   for (long ri = 0; ri < ctx.nrows; ++ri)
+      for (long ci = 0; ci < ctx.ncols; ++ci)
+         atomic_init(&ctx.deps[ri * ctx.ncols + ci], (ci + 1 < ctx.ncols) + (ri + 1 < ctx.nrows));
+
+   _NW_SubmitTile(&ctx, ctx.ncols - 1, ctx.nrows - 1);
+   ThreadPool_Wait(pool, &ctx.group);
+
+   long res = ctx.corners[0];
+   free(ctx.X_row);
+   free(ctx.Y_col);
+   free(ctx.corners);
+   free(ctx.deps);
+   return res;
+}
+
+long EditDistance_NW_Iter_CO_Par(char *A, size_t lengthA, char *B, size_t lengthB)
+{
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   unsigned char *codesA = seqA.codes, *codesB = seqB.codes;
+   size_t nA = seqA.length, nB = seqB.length;
+   struct ThreadPool *pool = ThreadPool_Default();
+   long res = (nA >= nB) ? _NW_Tiles(codesA, nA, codesB, nB, pool) : _NW_Tiles(codesB, nB, codesA, nA, pool);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return res;
+}
+
+/*****************************************************************************/
+/* Alignment in linear space (Hirschberg)
+ * The sequence A is cut in two halves A[0..mid-1] and A[mid..nA-1]; a forward sweep (as EditDistance_NW_Iter, but from
+ * the beginning of the sequences) gives the distances F[j] between A[0..mid-1] and B[0..j-1], and a backward sweep the
+ * distances R[j] between A[mid..nA-1] and B[j..nB-1]. An optimal alignment goes through (mid, j) where F[j]+R[j] is
+ * minimal, so the two halves are aligned independently (in parallel on the default pool when they are large).
+ * Small subproblems are aligned by a full matrix with traceback. Memory O(nA + nB), work about 2*nA*nB.
+ * The alignment is an array of operations (one per column of the alignment):
+ *    NW_OP_MATCH '=' and NW_OP_MISMATCH 'X': one base of A aligned with one base of B,
+ *    NW_OP_INSERTION 'I': one base of A only, NW_OP_DELETION 'D': one base of B only.
+ */
+
+/** \def NW_ALIGN_LEAF_CELLS
+ * \brief maximal number of cells of a subproblem aligned by a full matrix
+ */
+#define NW_ALIGN_LEAF_CELLS 4096
+
+/** \def NW_ALIGN_PARALLEL_CELLS
+ * \brief minimal number of cells of a subproblem whose two halves are aligned in parallel
+ */
+#define NW_ALIGN_PARALLEL_CELLS (1L << 20)
+
+#define NW_OP_MATCH '='
+#define NW_OP_MISMATCH 'X'
+#define NW_OP_INSERTION 'I'
+#define NW_OP_DELETION 'D'
+
+/** \struct NW_AlignTask
+ * \brief subproblem of the alignment: aligns a[0..na-1] with b[0..nb-1] and writes the operations in ops[0..na+nb-1]
+ */
+struct NW_AlignTask
+{
+   const unsigned char *a;
+   size_t na;
+   const unsigned char *b;
+   size_t nb;
+   char *ops;     /*!< at most na+nb operations are written from ops[0] */
+   size_t nops;   /*!< output: number of operations written */
+   long distance; /*!< output: distance between a and b */
+};
+
+/*
+ * \brief F[j] = distance between a[0..na-1] and b[0..j-1] for j = 0..nb (forward single column sweep)
+ */
+static void _NW_ForwardSweep(const unsigned char *a, size_t na, const unsigned char *b, size_t nb, long *F)
+{
+   for (size_t j = 0; j <= nb; ++j)
+      F[j] = (long)j * INSERTION_COST;
+   for (size_t i = 1; i <= na; ++i)
+   {
+      unsigned char x = a[i - 1];
+      long diag = F[0];
+      F[0] = (long)i * INSERTION_COST;
+      for (size_t j = 1; j <= nb; ++j)
+      {
+         long best = diag + SubstitutionCost(x, b[j - 1]);
+         diag = F[j];
+         if (F[j] + INSERTION_COST < best)
+            best = F[j] + INSERTION_COST;
+         if (F[j - 1] + INSERTION_COST < best)
+            best = F[j - 1] + INSERTION_COST;
+         F[j] = best;
+      }
+   }
+}
+
+/*
+ * \brief R[j] = distance between a[0..na-1] and b[j..nb-1] for j = 0..nb (backward single column sweep)
+ */
+static void _NW_BackwardSweep(const unsigned char *a, size_t na, const unsigned char *b, size_t nb, long *R)
+{
+   for (size_t j = 0; j <= nb; ++j)
+      R[j] = (long)(nb - j) * INSERTION_COST;
+   for (size_t i = na; i-- > 0;)
+   {
+      unsigned char x = a[i];
+      long diag = R[nb];
+      R[nb] += INSERTION_COST;
+      for (size_t j = nb; j-- > 0;)
+      {
+         long best = diag + SubstitutionCost(x, b[j]);
+         diag = R[j];
+         if (R[j] + INSERTION_COST < best)
+            best = R[j] + INSERTION_COST;
+         if (R[j + 1] + INSERTION_COST < best)
+            best = R[j + 1] + INSERTION_COST;
+         R[j] = best;
+      }
+   }
+}
+
+/*
+ * \brief aligns a small subproblem with a full matrix and a traceback
+ */
+static void _NW_AlignLeaf(struct NW_AlignTask *t)
+{
+   size_t na = t->na, nb = t->nb, w = nb + 1;
+   long *D = (long *)malloc((na + 1) * w * sizeof(long));
+   if (D == NULL)
+   {
+      perror("_NW_AlignLeaf: malloc of matrix");
+      exit(EXIT_FAILURE);
+   }
+   for (size_t j = 0; j <= nb; ++j)
+      D[j] = (long)j * INSERTION_COST;
+   for (size_t i = 1; i <= na; ++i)
+   {
+      D[i * w] = (long)i * INSERTION_COST;
+      for (size_t j = 1; j <= nb; ++j)
+      {
+         long best = D[(i - 1) * w + j - 1] + SubstitutionCost(t->a[i - 1], t->b[j - 1]);
+         if (D[(i - 1) * w + j] + INSERTION_COST < best)
+            best = D[(i - 1) * w + j] + INSERTION_COST;
+         if (D[i * w + j - 1] + INSERTION_COST < best)
+            best = D[i * w + j - 1] + INSERTION_COST;
+         D[i * w + j] = best;
+      }
+   }
+   t->distance = D[na * w + nb];
+   /* traceback from (na, nb): the operations are written backwards, then reversed */
+   size_t i = na, j = nb, k = 0;
+   while (i > 0 || j > 0)
+   {
+      if (i > 0 && j > 0 && D[i * w + j] == D[(i - 1) * w + j - 1] + SubstitutionCost(t->a[i - 1], t->b[j - 1]))
+      {
+         t->ops[k++] = (SubstitutionCost(t->a[i - 1], t->b[j - 1]) == 0) ? NW_OP_MATCH : NW_OP_MISMATCH;
+         i--;
+         j--;
+      }
+      else if (i > 0 && D[i * w + j] == D[(i - 1) * w + j] + INSERTION_COST)
+      {
+         t->ops[k++] = NW_OP_INSERTION;
+         i--;
+      }
+      else
+      {
+         t->ops[k++] = NW_OP_DELETION;
+         j--;
+      }
+   }
+   for (size_t l = 0; l < k / 2; ++l)
+   {
+      char op = t->ops[l];
+      t->ops[l] = t->ops[k - 1 - l];
+      t->ops[k - 1 - l] = op;
+   }
+   t->nops = k;
+   free(D);
+}
+
+static void _NW_AlignRec(void *varg)
+{
+   struct NW_AlignTask *t = (struct NW_AlignTask *)varg;
+   if (t->na <= 1 || t->nb == 0 || t->na * t->nb <= NW_ALIGN_LEAF_CELLS)
+   {
+      _NW_AlignLeaf(t);
+      return;
+   }
+   size_t mid = t->na / 2;
+   long *F = (long *)malloc(2 * (t->nb + 1) * sizeof(long));
+   if (F == NULL)
+   {
+      perror("_NW_AlignRec: malloc of sweeps");
+      exit(EXIT_FAILURE);
+   }
+   long *R = F + t->nb + 1;
+   _NW_ForwardSweep(t->a, mid, t->b, t->nb, F);
+   _NW_BackwardSweep(t->a + mid, t->na - mid, t->b, t->nb, R);
+   size_t jmid = 0;
+   for (size_t j = 1; j <= t->nb; ++j)
+      if (F[j] + R[j] < F[jmid] + R[jmid])
+         jmid = j;
+   t->distance = F[jmid] + R[jmid];
+   free(F);
+
+   struct NW_AlignTask left = {t->a, mid, t->b, jmid, t->ops, 0, 0};
+   struct NW_AlignTask right = {t->a + mid, t->na - mid, t->b + jmid, t->nb - jmid, t->ops + mid + jmid, 0, 0};
+   if (t->na * t->nb >= NW_ALIGN_PARALLEL_CELLS)
+   {
+      struct ThreadPool *pool = ThreadPool_Default();
+      struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+      ThreadPool_Submit(pool, &group, _NW_AlignRec, &left);
+      _NW_AlignRec(&right);
+      ThreadPool_Wait(pool, &group);
+   }
+   else
+   {
+      _NW_AlignRec(&left);
+      _NW_AlignRec(&right);
+   }
+   memmove(t->ops + left.nops, right.ops, right.nops);
+   t->nops = left.nops + right.nops;
+}
+
+/*
+ * \brief returns the (malloc allocated) run-length encoding of ops[0..nops-1], eg "12=1X3I"
+ */
+static char *_NW_OpsToCigar(const char *ops, size_t nops)
+{
+   size_t runs = 0;
+   for (size_t k = 0; k < nops; ++k)
+      if (k == 0 || ops[k] != ops[k - 1])
+         runs++;
+   char *cigar = (char *)malloc(runs * 21 + 1); /* at most 20 digits and 1 operation per run */
+   if (cigar == NULL)
+   {
+      perror("_NW_OpsToCigar: malloc of cigar");
+      exit(EXIT_FAILURE);
+   }
+   char *c = cigar;
+   *c = '\0';
+   for (size_t k = 0; k < nops;)
+   {
+      size_t l = k;
+      while (l < nops && ops[l] == ops[k])
+         l++;
+      c += sprintf(c, "%zu%c", l - k, ops[k]);
+      k = l;
+   }
+   return cigar;
+}
+
+long EditDistance_NW_Align(char *A, size_t lengthA, char *B, size_t lengthB, char **cigar)
+{
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   unsigned char *codesA = seqA.codes, *codesB = seqB.codes;
+   size_t nA = seqA.length, nB = seqB.length;
+   char *ops = (char *)malloc(nA + nB + 1);
+   if (ops == NULL)
+   {
+      perror("EditDistance_NW_Align: malloc of ops");
+      exit(EXIT_FAILURE);
+   }
+   struct NW_AlignTask t = {codesA, nA, codesB, nB, ops, 0, 0};
+   _NW_AlignRec(&t);
+   *cigar = _NW_OpsToCigar(ops, t.nops);
+   free(ops);
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return t.distance;
+}
+
+/*****************************************************************************/
+/* Incremental extension
+ * The matrix is computed from the beginning of the sequences (as the forward sweep of the alignment): column[j] is the
+ * distance between the bases of X given so far and Y[0..j-1]. Appending a base x of X computes the next column
+ *    next[0] = column[0] + INSERTION_COST,
+ *    next[j] = min(column[j-1] + SubstitutionCost(x, Y[j-1]), column[j] + INSERTION_COST, next[j-1] + INSERTION_COST)
+ * in two passes: the first two terms, independent (vectorized by the compiler, the substitution costs of x being
+ * read in a profile of Y), then the third one, a running minimum.
+ */
+
+/** \struct NW_Extension
+ * \brief the fixed sequence Y, its profile and the frontier of the matrix
+ */
+struct NW_Extension
+{
+   struct EncodedSequence Y; /*!< the codes of the fixed sequence */
+   long *profile;            /*!< profile[(c - ADENINE) * N + j] = SubstitutionCost(c, Y[j]) for the codes c of bases */
+   long *column;             /*!< the last column of the matrix, column[0..N] */
+   long *next;               /*!< the column being computed, next[0..N] */
+   struct EncodedSequence X; /*!< buffer for the codes of the appended characters */
+   size_t M;                 /*!< number of bases of X given so far */
+};
+
+struct NW_Extension *NW_Extension_Create(char *Y, size_t lengthY)
+{
+   struct NW_Extension *ext = (struct NW_Extension *)malloc(sizeof(struct NW_Extension));
+   if (ext == NULL)
+   {
+      perror("NW_Extension_Create: malloc of ext");
+      exit(EXIT_FAILURE);
+   }
+   EncodeSequence(Y, lengthY, &ext->Y);
+   size_t N = ext->Y.length;
+   size_t ncodes = UNKOWN_BASE - ADENINE + 1;
+   ext->profile = (long *)malloc((ncodes * N + 1) * sizeof(long));
+   ext->column = (long *)malloc((N + 1) * sizeof(long));
+   ext->next = (long *)malloc((N + 1) * sizeof(long));
+   if (ext->profile == NULL || ext->column == NULL || ext->next == NULL)
+   {
+      perror("NW_Extension_Create: malloc of the columns");
+      exit(EXIT_FAILURE);
+   }
+   for (size_t c = 0; c < ncodes; ++c)
+      for (size_t j = 0; j < N; ++j)
+         ext->profile[c * N + j] = SubstitutionCost((unsigned char)(c + ADENINE), ext->Y.codes[j]);
+   ext->column[0] = 0;
+   for (size_t j = 1; j <= N; ++j)
+      ext->column[j] = ext->column[j - 1] + INSERTION_COST;
+   struct EncodedSequence empty = ENCODED_SEQUENCE_EMPTY;
+   ext->X = empty;
+   ext->M = 0;
+   return ext;
+}
+
+long NW_Extension_Append(struct NW_Extension *ext, char *X, size_t lengthX)
+{
+   ReencodeSequence(X, lengthX, &ext->X);
+   size_t N = ext->Y.length;
+   for (size_t i = 0; i < ext->X.length; ++i)
+   {
+      const long *restrict sub = ext->profile + (ext->X.codes[i] - ADENINE) * N;
+      const long *restrict column = ext->column;
+      long *restrict next = ext->next;
+      next[0] = column[0] + INSERTION_COST;
+      for (size_t j = 1; j <= N; ++j)
+      {
+         long diag = column[j - 1] + sub[j - 1];
+         long right = column[j] + INSERTION_COST;
+         next[j] = (diag < right) ? diag : right;
+      }
+      for (size_t j = 1; j <= N; ++j)
+      {
+         long top = next[j - 1] + INSERTION_COST;
+         if (top < next[j])
+            next[j] = top;
+      }
+      ext->next = ext->column;
+      ext->column = next;
+   }
+   ext->M += ext->X.length;
+   return ext->column[N];
+}
+
+long NW_Extension_Distance(const struct NW_Extension *ext)
+{
+   return ext->column[ext->Y.length];
+}
+
+size_t NW_Extension_Length(const struct NW_Extension *ext)
+{
+   return ext->M;
+}
+
+void NW_Extension_Free(struct NW_Extension *ext)
+{
+   EncodedSequence_Free(&ext->Y);
+   EncodedSequence_Free(&ext->X);
+   free(ext->profile);
+   free(ext->column);
+   free(ext->next);
+   free(ext);
+}
+
+/*****************************************************************************/
+/* Semi-global alignment
+ * The fragment Q is aligned whole with a range of T, the bases of T out of the range costing 0 (free end gaps on T).
+ * With X = T and Y = Q, the anti-diagonal engine computes it with the boundary D[i][0] = 0 (the range may start at any
+ * base of T): the distance is the minimum of the last row D[i][N], first reached at the end i of the range. As every
+ * cell is then at most INSERTION_COST*N, the cells are 16-bit for fragments of up to 32 kb, whatever the length of T.
+ * The start of the range is given by the same engine on the reversed sequences from the end of the range, with a
+ * fixed start: the first row cell equal to the distance. The range has at most N + distance/INSERTION_COST bases
+ * (the others are insertions), so that second pass only covers them.
+ */
+
+long EditDistance_NW_SemiGlobal(char *Q, size_t lengthQ, char *T, size_t lengthT, struct NW_Placement *placement)
+{
+   struct EncodedSequence seqQ, seqT;
+   EncodeSequence(Q, lengthQ, &seqQ);
+   EncodeSequence(T, lengthT, &seqT);
+   size_t N = seqQ.length;
+   size_t end = 0, start = 0;
+   long best = _NW_AntiDiagEnds(seqT.codes, seqT.length, seqQ.codes, N, 1, &end, NULL);
+   if (best == 0)
+      start = end - N; /* Q is T[end-N..end-1] */
+   else if (best > 0)
+   { /* the first end of T[end-span..end-1] reversed whose distance to Q reversed is best */
+      size_t span = N + (size_t)best / INSERTION_COST, reach = 0;
+      if (span > end)
+         span = end;
+      struct NW_Scratch reversed[2] = {{NULL, 0}, {NULL, 0}};
+      unsigned char *Tr = _NW_ReversedCodes(seqT.codes + end - span, span, &reversed[0]);
+      unsigned char *Qr = _NW_ReversedCodes(seqQ.codes, N, &reversed[1]);
+      if (_NW_AntiDiagEnds(Tr, span, Qr, N, 0, &reach, NULL) < 0)
+         best = -1;
+      start = end - reach;
+      free(reversed[0].data);
+      free(reversed[1].data);
+   }
+   if (best < 0)
+   {
+      fprintf(stderr, "EditDistance_NW_SemiGlobal: fragment of %lu bases too long\n", (unsigned long)N);
+      exit(EXIT_FAILURE);
+   }
+   if (placement != NULL)
+   {
+      placement->distance = best;
+      placement->start = start;
+      placement->end = end;
+   }
+   EncodedSequence_Free(&seqQ);
+   EncodedSequence_Free(&seqT);
+   return best;
+}
+
+/*****************************************************************************/
+/* Local alignment (Smith-Waterman)
+ * The costs are converted to scores: two equal bases (SubstitutionCost 0) score NW_LOCAL_MATCH_SCORE, a substitution
+ * scores -SubstitutionCost and an insertion -INSERTION_COST; the score of the best alignment of a range of A with a
+ * range of B is the maximum of the cells of
+ *    H[i][j] = max(0, H[i-1][j-1] + score(A[i-1], B[j-1]), H[i-1][j] - INSERTION_COST, H[i][j-1] - INSERTION_COST),
+ * H[i][0] = H[0][j] = 0, reached first (smallest i, then smallest j) at the ends (i, j) of the ranges.
+ * The matrix is split into tiles that only communicate through the row X_row (H[i][j0] on the row above the tile) and
+ * the column Y_col (H[i0][j] on the column left of the tile), as in the parallel implementation above (here forward);
+ * each tile is computed by anti-diagonals with vectorized kernels, as the anti-diagonal engine, that also return the
+ * maximum of their cells. The single threaded engine computes one tile, the parallel one runs tiles of
+ * NW_LOCAL_TILE_SIZE bases by a wavefront on the threads of the pool.
+ * The starts of the ranges are then found by a pass on the reversed sequences from the ends, anchored there: the first
+ * cell equal to the score. It only visits the cells that may be on such an alignment: the cells whose score is not
+ * negative (no suffix of a best local alignment is) and that may still reach the score.
+ */
+
+/** \def NW_LOCAL_TILE_SIZE
+ * \brief number of rows and of columns of a tile of the parallel local alignment
+ */
+#define NW_LOCAL_TILE_SIZE 2048
+
+/** \def LocalScore(x, y)
+ * \brief score of the alignment of two base codes x and y (neither being SKIP_BASE)
+ */
+#define LocalScore(x, y) (SubstitutionCost(x, y) == 0 ? NW_LOCAL_MATCH_SCORE : -SubstitutionCost(x, y))
+
+/*
+ * Kernels computing count consecutive cells of an anti-diagonal of a tile, with the same arguments as the kernels of the
+ * anti-diagonal engine; they do not compute cells after the last one, and return the maximum of the cells (0 if none).
+ */
+typedef int32_t (*NW_LocalKernel32)(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                    const unsigned char *x, const unsigned char *y, size_t count);
+typedef int16_t (*NW_LocalKernel16)(int16_t *cur, const int16_t *p1, const int16_t *p2,
+                                    const unsigned char *x, const unsigned char *y, size_t count);
+
+static int32_t _NW_Local_Scalar32(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                  const unsigned char *x, const unsigned char *y, size_t count)
+{
+   int32_t max = 0;
+   for (size_t j = 0; j < count; ++j)
+   {
+      int32_t best = p2[j] + LocalScore(x[j], y[j]);
+      int32_t up = p1[j] - INSERTION_COST;
+      int32_t left = p1[j - 1] - INSERTION_COST;
+      if (up > best)
+         best = up;
+      if (left > best)
+         best = left;
+      if (best < 0)
+         best = 0;
+      cur[j] = best;
+      if (best > max)
+         max = best;
+   }
+   return max;
+}
+
+static int16_t _NW_Local_Scalar16(int16_t *cur, const int16_t *p1, const int16_t *p2,
+                                  const unsigned char *x, const unsigned char *y, size_t count)
+{
+   int16_t max = 0;
+   for (size_t j = 0; j < count; ++j)
+   {
+      int16_t best = p2[j] + LocalScore(x[j], y[j]);
+      int16_t up = p1[j] - INSERTION_COST;
+      int16_t left = p1[j - 1] - INSERTION_COST;
+      if (up > best)
+         best = up;
+      if (left > best)
+         best = left;
+      if (best < 0)
+         best = 0;
+      cur[j] = best;
+      if (best > max)
+         max = best;
+   }
+   return max;
+}
+
+#ifdef NW_SIMD_X86
+/*
+ * \brief scores (one 16-bit lane per base) of the substitution costs cost (one 16-bit lane per base)
+ */
+__attribute__((target("sse4.1"))) static inline __m128i _NW_LocalScore_Epi16(__m128i cost)
+{
+   __m128i zero = _mm_setzero_si128();
+   return _mm_blendv_epi8(_mm_sub_epi16(zero, cost), _mm_set1_epi16(NW_LOCAL_MATCH_SCORE), _mm_cmpeq_epi16(cost, zero));
+}
+
+__attribute__((target("sse4.1"))) static int32_t _NW_Local_Sse41_32(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                                                   const unsigned char *x, const unsigned char *y,
+                                                                   size_t count)
+{
+   const __m128i ins = _mm_set1_epi32(INSERTION_COST), zero = _mm_setzero_si128();
+   __m128i max = zero;
+   size_t j = 0;
+   for (; j + 4 <= count; j += 4)
+   {
+      int32_t xw, yw;
+      memcpy(&xw, x + j, sizeof(xw));
+      memcpy(&yw, y + j, sizeof(yw));
+      __m128i cost = _mm_cvtepu8_epi32(_NW_SubstitutionCost_Epi8(_mm_cvtsi32_si128(xw), _mm_cvtsi32_si128(yw)));
+      __m128i score = _mm_cvtepi16_epi32(_NW_LocalScore_Epi16(_mm_packus_epi32(cost, cost)));
+      __m128i best = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(p2 + j)), score);
+      __m128i up = _mm_loadu_si128((const __m128i *)(p1 + j));
+      __m128i left = _mm_loadu_si128((const __m128i *)(p1 + j - 1));
+      best = _mm_max_epi32(_mm_max_epi32(best, _mm_sub_epi32(_mm_max_epi32(up, left), ins)), zero);
+      _mm_storeu_si128((__m128i *)(cur + j), best);
+      max = _mm_max_epi32(max, best);
+   }
+   int32_t lanes[4];
+   _mm_storeu_si128((__m128i *)lanes, max);
+   int32_t res = _NW_Local_Scalar32(cur + j, p1 + j, p2 + j, x + j, y + j, count - j);
+   for (int l = 0; l < 4; ++l)
+      if (lanes[l] > res)
+         res = lanes[l];
+   return res;
+}
+
+__attribute__((target("sse4.1"))) static int16_t _NW_Local_Sse41_16(int16_t *cur, const int16_t *p1, const int16_t *p2,
+                                                                   const unsigned char *x, const unsigned char *y,
+                                                                   size_t count)
+{
+   const __m128i ins = _mm_set1_epi16(INSERTION_COST), zero = _mm_setzero_si128();
+   __m128i max = zero;
+   size_t j = 0;
+   for (; j + 8 <= count; j += 8)
+   {
+      __m128i cost = _mm_cvtepu8_epi16(_NW_SubstitutionCost_Epi8(_mm_loadl_epi64((const __m128i *)(x + j)),
+                                                                 _mm_loadl_epi64((const __m128i *)(y + j))));
+      __m128i best = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(p2 + j)), _NW_LocalScore_Epi16(cost));
+      __m128i up = _mm_loadu_si128((const __m128i *)(p1 + j));
+      __m128i left = _mm_loadu_si128((const __m128i *)(p1 + j - 1));
+      best = _mm_max_epi16(_mm_max_epi16(best, _mm_sub_epi16(_mm_max_epi16(up, left), ins)), zero);
+      _mm_storeu_si128((__m128i *)(cur + j), best);
+      max = _mm_max_epi16(max, best);
+   }
+   int16_t lanes[8];
+   _mm_storeu_si128((__m128i *)lanes, max);
+   int16_t res = _NW_Local_Scalar16(cur + j, p1 + j, p2 + j, x + j, y + j, count - j);
+   for (int l = 0; l < 8; ++l)
+      if (lanes[l] > res)
+         res = lanes[l];
+   return res;
+}
+
+__attribute__((target("avx2"))) static int32_t _NW_Local_Avx2_32(int32_t *cur, const int32_t *p1, const int32_t *p2,
+                                                                const unsigned char *x, const unsigned char *y,
+                                                                size_t count)
+{
+   const __m256i ins = _mm256_set1_epi32(INSERTION_COST), zero = _mm256_setzero_si256();
+   __m256i max = zero;
+   size_t j = 0;
+   for (; j + 8 <= count; j += 8)
+   {
+      __m128i cost = _mm_cvtepu8_epi16(_NW_SubstitutionCost_Epi8(_mm_loadl_epi64((const __m128i *)(x + j)),
+                                                                 _mm_loadl_epi64((const __m128i *)(y + j))));
+      __m256i score = _mm256_cvtepi16_epi32(_NW_LocalScore_Epi16(cost));
+      __m256i best = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(p2 + j)), score);
+      __m256i up = _mm256_loadu_si256((const __m256i *)(p1 + j));
+      __m256i left = _mm256_loadu_si256((const __m256i *)(p1 + j - 1));
+      best = _mm256_max_epi32(_mm256_max_epi32(best, _mm256_sub_epi32(_mm256_max_epi32(up, left), ins)), zero);
+      _mm256_storeu_si256((__m256i *)(cur + j), best);
+      max = _mm256_max_epi32(max, best);
+   }
+   int32_t lanes[8];
+   _mm256_storeu_si256((__m256i *)lanes, max);
+   int32_t res = _NW_Local_Scalar32(cur + j, p1 + j, p2 + j, x + j, y + j, count - j);
+   for (int l = 0; l < 8; ++l)
+      if (lanes[l] > res)
+         res = lanes[l];
+   return res;
+}
+
+__attribute__((target("avx2"))) static int16_t _NW_Local_Avx2_16(int16_t *cur, const int16_t *p1, const int16_t *p2,
+                                                                const unsigned char *x, const unsigned char *y,
+                                                                size_t count)
+{
+   const __m256i ins = _mm256_set1_epi16(INSERTION_COST), zero = _mm256_setzero_si256();
+   const __m256i match = _mm256_set1_epi16(NW_LOCAL_MATCH_SCORE);
+   __m256i max = zero;
+   size_t j = 0;
+   for (; j + 16 <= count; j += 16)
+   {
+      __m256i cost = _mm256_cvtepu8_epi16(_NW_SubstitutionCost_Epi8(_mm_loadu_si128((const __m128i *)(x + j)),
+                                                                    _mm_loadu_si128((const __m128i *)(y + j))));
+      __m256i score = _mm256_blendv_epi8(_mm256_sub_epi16(zero, cost), match, _mm256_cmpeq_epi16(cost, zero));
+      __m256i best = _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(p2 + j)), score);
+      __m256i up = _mm256_loadu_si256((const __m256i *)(p1 + j));
+      __m256i left = _mm256_loadu_si256((const __m256i *)(p1 + j - 1));
+      best = _mm256_max_epi16(_mm256_max_epi16(best, _mm256_sub_epi16(_mm256_max_epi16(up, left), ins)), zero);
+      _mm256_storeu_si256((__m256i *)(cur + j), best);
+      max = _mm256_max_epi16(max, best);
+   }
+   int16_t lanes[16];
+   _mm256_storeu_si256((__m256i *)lanes, max);
+   int16_t res = _NW_Local_Scalar16(cur + j, p1 + j, p2 + j, x + j, y + j, count - j);
+   for (int l = 0; l < 16; ++l)
+      if (lanes[l] > res)
+         res = lanes[l];
+   return res;
+}
+#endif /* NW_SIMD_X86 */
+
+/** \struct NW_LocalBest
+ * \brief best cell of a tile: its score and its position (i, j) in H
+ */
+struct NW_LocalBest
+{
+   long score;
+   size_t i;
+   size_t j;
+};
+
+/*
+ * \brief if the cell (i, j) of score score is better than best (higher score, or same score and first position),
+ * sets best to it
+ */
+static inline void _NW_LocalKeep(struct NW_LocalBest *best, long score, size_t i, size_t j)
+{
+   if (score > best->score || (score == best->score && (i < best->i || (i == best->i && j < best->j))))
+   {
+      best->score = score;
+      best->i = i;
+      best->j = j;
+   }
+}
+
+/** \struct NW_LocalContext
+ * \brief data shared by all the tiles of a local alignment
+ */
+struct NW_LocalContext
+{
+   const unsigned char *Xr;      /*!< reversed codes of A, with ENCODED_SEQUENCE_PADDING */
+   const unsigned char *Y;       /*!< codes of B, with ENCODED_SEQUENCE_PADDING */
+   size_t M;                     /*!< number of bases in A */
+   size_t N;                     /*!< number of bases in B */
+   size_t tile;                  /*!< number of rows and of columns of a tile */
+   long ncols;                   /*!< number of tiles along A */
+   long nrows;                   /*!< number of tiles along B */
+   long *X_row;                  /*!< X_row[i]: H[i][j] on the row j above the tiles computed so far */
+   long *Y_col;                  /*!< Y_col[j]: H[i][j] on the column i left of the tiles computed so far */
+   long *corners;                /*!< corners[ri*(ncols+1) + ci]: H at the cell above and left of tile (ci, ri) */
+   struct NW_LocalBest *bests;   /*!< bests[ri*ncols + ci]: the best cell of tile (ci, ri) */
+   int narrow;                   /*!< if the cells fit in 16 bits */
+   NW_LocalKernel16 kernel16;    /*!< kernel for 16-bit cells */
+   NW_LocalKernel32 kernel32;    /*!< kernel for 32-bit cells */
+   atomic_int *deps;             /*!< deps[ri*ncols + ci]: number of neighbours of tile (ci, ri) not yet computed */
+   struct ThreadPool *pool;      /*!< pool of the parallel engine (NULL if single threaded) */
+   struct ThreadPool_Group group;
+};
+
+/*
+ * The two drivers below are identical but for the type of the cells: they compute tile (ci, ri) of ctx, ie the cells
+ * H[i0+a][j0+b] for a = 1..w, b = 1..h, by anti-diagonals d = a+b, indexed by b. The boundary cells are read in X_row
+ * (b = 0), Y_col (a = 0) and corners; X_row and Y_col are overwritten by the last row and column of the tile (their
+ * cells are read before, at smaller anti-diagonals).
+ */
+static void _NW_LocalTile32(struct NW_LocalContext *ctx, long ci, long ri)
+{
+   size_t i0 = ci * ctx->tile, j0 = ri * ctx->tile;
+   size_t w = (i0 + ctx->tile < ctx->M) ? ctx->tile : ctx->M - i0;
+   size_t h = (j0 + ctx->tile < ctx->N) ? ctx->tile : ctx->N - j0;
+   size_t width = h + 1;
+   int32_t *diags = (int32_t *)malloc(3 * width * sizeof(int32_t));
+   if (diags == NULL)
+   {
+      perror("_NW_LocalTile32: malloc of diags");
+      exit(EXIT_FAILURE);
+   }
+   int32_t *p2 = diags, *p1 = diags + width, *cur = diags + 2 * width;
+   struct NW_LocalBest best = {0, 0, 0};
+   p1[0] = (int32_t)ctx->corners[ri * (ctx->ncols + 1) + ci];
+   for (size_t d = 1; d <= w + h; ++d)
+   {
+      size_t blo = (d > w) ? d - w : 1;
+      size_t bhi = (d <= h) ? d - 1 : h;
+      if (blo <= bhi)
+      {
+         int32_t max = ctx->kernel32(cur + blo, p1 + blo, p2 + blo - 1, ctx->Xr + ctx->M - i0 - d + blo,
+                                     ctx->Y + j0 + blo - 1, bhi - blo + 1);
+         if (max > 0 && max >= best.score)
+            for (size_t b = blo; b <= bhi; ++b)
+               _NW_LocalKeep(&best, cur[b], i0 + d - b, j0 + b);
+      }
+      if (d <= w)
+         cur[0] = (int32_t)ctx->X_row[i0 + d];
+      if (d <= h)
+         cur[d] = (int32_t)ctx->Y_col[j0 + d];
+      if (d > h)
+         ctx->X_row[i0 + d - h] = cur[h];
+      if (d > w)
+         ctx->Y_col[j0 + d - w] = cur[d - w];
+      int32_t *tmp = p2;
+      p2 = p1;
+      p1 = cur;
+      cur = tmp;
+   }
+   ctx->corners[(ri + 1) * (ctx->ncols + 1) + ci + 1] = p1[h];
+   ctx->bests[ri * ctx->ncols + ci] = best;
+   free(diags);
+}
+
+static void _NW_LocalTile16(struct NW_LocalContext *ctx, long ci, long ri)
+{
+   size_t i0 = ci * ctx->tile, j0 = ri * ctx->tile;
+   size_t w = (i0 + ctx->tile < ctx->M) ? ctx->tile : ctx->M - i0;
+   size_t h = (j0 + ctx->tile < ctx->N) ? ctx->tile : ctx->N - j0;
+   size_t width = h + 1;
+   int16_t *diags = (int16_t *)malloc(3 * width * sizeof(int16_t));
+   if (diags == NULL)
+   {
+      perror("_NW_LocalTile16: malloc of diags");
+      exit(EXIT_FAILURE);
+   }
+   int16_t *p2 = diags, *p1 = diags + width, *cur = diags + 2 * width;
+   struct NW_LocalBest best = {0, 0, 0};
+   p1[0] = (int16_t)ctx->corners[ri * (ctx->ncols + 1) + ci];
+   for (size_t d = 1; d <= w + h; ++d)
+   {
+      size_t blo = (d > w) ? d - w : 1;
+      size_t bhi = (d <= h) ? d - 1 : h;
+      if (blo <= bhi)
+      {
+         int16_t max = ctx->kernel16(cur + blo, p1 + blo, p2 + blo - 1, ctx->Xr + ctx->M - i0 - d + blo,
+                                     ctx->Y + j0 + blo - 1, bhi - blo + 1);
+         if (max > 0 && max >= best.score)
+            for (size_t b = blo; b <= bhi; ++b)
+               _NW_LocalKeep(&best, cur[b], i0 + d - b, j0 + b);
+      }
+      if (d <= w)
+         cur[0] = (int16_t)ctx->X_row[i0 + d];
+      if (d <= h)
+         cur[d] = (int16_t)ctx->Y_col[j0 + d];
+      if (d > h)
+         ctx->X_row[i0 + d - h] = cur[h];
+      if (d > w)
+         ctx->Y_col[j0 + d - w] = cur[d - w];
+      int16_t *tmp = p2;
+      p2 = p1;
+      p1 = cur;
+      cur = tmp;
+   }
+   ctx->corners[(ri + 1) * (ctx->ncols + 1) + ci + 1] = p1[h];
+   ctx->bests[ri * ctx->ncols + ci] = best;
+   free(diags);
+}
+
+/** \struct NW_LocalTile
+ * \brief argument of the task computing one tile of a local alignment
+ */
+struct NW_LocalTile
+{
+   struct NW_LocalContext *ctx;
+   long ci; /*!< index of the tile along A */
+   long ri; /*!< index of the tile along B */
+};
+
+static void _NW_SubmitLocalTile(struct NW_LocalContext *ctx, long ci, long ri);
+
+/*
+ * \brief task computing tile (ci, ri), then submitting its right and lower neighbours if they are ready
+ */
+static void _NW_ComputeLocalTile(void *varg)
+{
+   struct NW_LocalTile *tile = (struct NW_LocalTile *)varg;
+   struct NW_LocalContext *ctx = tile->ctx;
+   long ci = tile->ci, ri = tile->ri;
+   free(tile);
+   if (ctx->narrow)
+      _NW_LocalTile16(ctx, ci, ri);
+   else
+      _NW_LocalTile32(ctx, ci, ri);
+   if (ci + 1 < ctx->ncols && atomic_fetch_sub(&ctx->deps[ri * ctx->ncols + ci + 1], 1) == 1)
+      _NW_SubmitLocalTile(ctx, ci + 1, ri);
+   if (ri + 1 < ctx->nrows && atomic_fetch_sub(&ctx->deps[(ri + 1) * ctx->ncols + ci], 1) == 1)
+      _NW_SubmitLocalTile(ctx, ci, ri + 1);
+}
+
+static void _NW_SubmitLocalTile(struct NW_LocalContext *ctx, long ci, long ri)
+{
+   struct NW_LocalTile *tile = (struct NW_LocalTile *)malloc(sizeof(struct NW_LocalTile));
+   if (tile == NULL)
+   {
+      perror("_NW_SubmitLocalTile: malloc of tile");
+      exit(EXIT_FAILURE);
+   }
+   tile->ctx = ctx;
+   tile->ci = ci;
+   tile->ri = ri;
+   ThreadPool_Submit(ctx->pool, &ctx->group, _NW_ComputeLocalTile, tile);
+}
+
+/*
+ * \brief the starts (*startA, *startB) of a best local alignment of X[0..endA-1] with Y[0..endB-1] of score best that
+ * ends at (endA, endB): the first cell (k, l) (smallest k, then smallest l) of the matrix of the reversed sequences
+ * anchored at (endA, endB) whose score is best. A cell is dropped when its score is negative or when it cannot reach
+ * best anymore (score + NW_LOCAL_MATCH_SCORE * bases left < best); the cells of a row are computed from the first one
+ * kept in the row above, up to the last one kept or reached by insertions.
+ */
+static void _NW_LocalStart(const unsigned char *X, size_t endA, const unsigned char *Y, size_t endB, long best,
+                           size_t *startA, size_t *startB)
+{
+   const long dropped = LONG_MIN / 2;
+   long *row = (long *)malloc((endB + 1) * sizeof(long));
+   long *next = (long *)malloc((endB + 1) * sizeof(long));
+   if (row == NULL || next == NULL)
+   {
+      perror("_NW_LocalStart: malloc of the rows");
+      exit(EXIT_FAILURE);
+   }
+   *startA = endA;
+   *startB = endB;
+   row[0] = 0;
+   size_t lo = 0, hi = 0; /* cells kept in row: row[lo..hi] */
+   for (size_t k = 1; k <= endA && best > 0; ++k)
+   {
+      unsigned char x = X[endA - k];
+      size_t nlo = 0, nhi = 0;
+      int kept = 0, found = 0;
+      long left = dropped;
+      for (size_t l = lo; l <= endB; ++l)
+      {
+         long v = (l >= lo && l <= hi) ? row[l] - INSERTION_COST : dropped;
+         if (l > lo && l - 1 <= hi)
+         {
+            long diag = row[l - 1] + LocalScore(x, Y[endB - l]);
+            if (diag > v)
+               v = diag;
+         }
+         if (left - INSERTION_COST > v)
+            v = left - INSERTION_COST;
+         size_t rest = (endA - k < endB - l) ? endA - k : endB - l;
+         if (v < 0 || v + NW_LOCAL_MATCH_SCORE * (long)rest < best)
+            v = dropped;
+         next[l] = v;
+         left = v;
+         if (v != dropped)
+         {
+            if (!kept)
+               nlo = l;
+            nhi = l;
+            kept = 1;
+            if (v == best)
+            {
+               *startA = endA - k;
+               *startB = endB - l;
+               found = 1;
+               break;
+            }
+         }
+         else if (l > hi)
+            break;
+      }
+      if (found || !kept)
+         break;
+      long *tmp = row;
+      row = next;
+      next = tmp;
+      lo = nlo;
+      hi = nhi;
+   }
+   free(row);
+   free(next);
+}
+
+/*
+ * \brief best local alignment of A and B in local, computed by tiles of tile bases (in parallel on pool if not NULL)
+ */
+static long _NW_Local(char *A, size_t lengthA, char *B, size_t lengthB, size_t tile, struct ThreadPool *pool,
+                      struct NW_LocalAlignment *local)
+{
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   struct NW_LocalContext ctx;
+   ctx.M = seqA.length;
+   ctx.N = seqB.length;
+   struct NW_LocalBest best = {0, 0, 0};
+   size_t startA = 0, startB = 0;
+   if (ctx.M > 0 && ctx.N > 0)
+   {
+      /* Upper bound of any cell: the score of min(M, N) matches */
+      double bound = (double)NW_LOCAL_MATCH_SCORE * ((ctx.M < ctx.N) ? ctx.M : ctx.N) + INSERTION_COST +
+                     SUBSTITUTION_COST + SUBSTITUTION_UNKNOWN_COST;
+      if (bound >= 2147483647.0)
+      {
+         fprintf(stderr, "_NW_Local: sequences too long for 32-bit cells\n");
+         exit(EXIT_FAILURE);
+      }
+      ctx.narrow = (bound < 32767.0);
+      ctx.kernel16 = _NW_Local_Scalar16;
+      ctx.kernel32 = _NW_Local_Scalar32;
+#ifdef NW_SIMD_X86
+      if (__builtin_cpu_supports("avx2"))
+      {
+         ctx.kernel16 = _NW_Local_Avx2_16;
+         ctx.kernel32 = _NW_Local_Avx2_32;
+      }
+      else if (__builtin_cpu_supports("sse4.1"))
+      {
+         ctx.kernel16 = _NW_Local_Sse41_16;
+         ctx.kernel32 = _NW_Local_Sse41_32;
+      }
+#endif
+      struct NW_Scratch reversed = {NULL, 0};
+      ctx.Xr = _NW_ReversedCodes(seqA.codes, ctx.M, &reversed);
+      ctx.Y = seqB.codes;
+      ctx.tile = tile;
+      ctx.ncols = (ctx.M + tile - 1) / tile;
+      ctx.nrows = (ctx.N + tile - 1) / tile;
+      ctx.pool = pool;
+      atomic_init(&ctx.group.pending, 0);
+      ctx.X_row = (long *)calloc(ctx.M + 1, sizeof(long));
+      ctx.Y_col = (long *)calloc(ctx.N + 1, sizeof(long));
+      ctx.corners = (long *)calloc((ctx.nrows + 1) * (ctx.ncols + 1), sizeof(long));
+      ctx.bests = (struct NW_LocalBest *)malloc(ctx.nrows * ctx.ncols * sizeof(struct NW_LocalBest));
+      ctx.deps = (atomic_int *)malloc(ctx.nrows * ctx.ncols * sizeof(atomic_int));
+      if (ctx.X_row == NULL || ctx.Y_col == NULL || ctx.corners == NULL || ctx.bests == NULL || ctx.deps == NULL)
+      {
+         perror("_NW_Local: malloc of X_row, Y_col, corners, bests or deps");
+         exit(EXIT_FAILURE);
+      }
+      for (long ri = 0; ri < ctx.nrows; ++ri)
+         for (long ci = 0; ci < ctx.ncols; ++ci)
+            atomic_init(&ctx.deps[ri * ctx.ncols + ci], (ci > 0) + (ri > 0));
+
+      if (pool != NULL)
+      {
+         _NW_SubmitLocalTile(&ctx, 0, 0);
+         ThreadPool_Wait(pool, &ctx.group);
+      }
+      else /* in the order of the rows of tiles */
+         for (long ri = 0; ri < ctx.nrows; ++ri)
+            for (long ci = 0; ci < ctx.ncols; ++ci)
+               if (ctx.narrow)
+                  _NW_LocalTile16(&ctx, ci, ri);
+               else
+                  _NW_LocalTile32(&ctx, ci, ri);
+
+      for (long t = 0; t < ctx.nrows * ctx.ncols; ++t)
+         if (ctx.bests[t].score > 0)
+            _NW_LocalKeep(&best, ctx.bests[t].score, ctx.bests[t].i, ctx.bests[t].j);
+      if (best.score > 0)
+         _NW_LocalStart(seqA.codes, best.i, seqB.codes, best.j, best.score, &startA, &startB);
+      free(reversed.data);
+      free(ctx.X_row);
+      free(ctx.Y_col);
+      free(ctx.corners);
+      free(ctx.bests);
+      free(ctx.deps);
+   }
+   if (local != NULL)
+   {
+      local->score = best.score;
+      local->startA = startA;
+      local->endA = best.i;
+      local->startB = startB;
+      local->endB = best.j;
+   }
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return best.score;
+}
+
+long EditDistance_NW_Local(char *A, size_t lengthA, char *B, size_t lengthB, struct NW_LocalAlignment *local)
+{
+   size_t tile = (lengthA > lengthB) ? lengthA : lengthB;
+   return _NW_Local(A, lengthA, B, lengthB, (tile > 0) ? tile : 1, NULL, local);
+}
+
+long EditDistance_NW_Local_Par(char *A, size_t lengthA, char *B, size_t lengthB, struct NW_LocalAlignment *local)
+{
+   struct ThreadPool *pool = ThreadPool_Default();
+   if (ThreadPool_Size(pool) <= 1)
+      return EditDistance_NW_Local(A, lengthA, B, lengthB, local);
+   return _NW_Local(A, lengthA, B, lengthB, NW_LOCAL_TILE_SIZE, pool, local);
+}
+
+/*****************************************************************************/
+/* Affine gap costs (Gotoh)
+ * A gap of k bases costs gap_open + k * gap_extend, with the costs of a struct NW_Costs given at runtime. Three matrices:
+ * E[i][j] (alignments ending by a gap in Y, ie X[i-1] inserted), F[i][j] (ending by Y[j-1] inserted) and the best H:
+ *    E[i][j] = min(E[i-1][j] + gap_extend, H[i-1][j] + gap_open + gap_extend)
+ *    F[i][j] = min(F[i][j-1] + gap_extend, H[i][j-1] + gap_open + gap_extend)
+ *    H[i][j] = min(H[i-1][j-1] + cost(X[i-1], Y[j-1]), E[i][j], F[i][j])
+ * with H[i][0] = E[i][0] = gap_open + i * gap_extend (i > 0), H[0][j] = F[0][j] likewise, H[0][0] = 0, and the other
+ * boundary cells infinite. They are computed by anti-diagonals in 32-bit cells with vectorized kernels (as the
+ * anti-diagonal engine: E and F only depend on the previous anti-diagonal), or in a single column of 64-bit cells (as
+ * EditDistance_NW_Iter, with F as a running value) when 32 bits could overflow. The default costs are the linear model
+ * of the other engines, that EditDistance_NW_Affine gives to them unchanged.
+ */
+
+/** \def NW_AFFINE_INFINITE
+ * \brief infinite cost of the 32-bit cells; an infinite cell plus a cost cannot overflow (cf the bound in
+ * EditDistance_NW_Affine)
+ */
+#define NW_AFFINE_INFINITE (INT32_MAX / 2)
+
+/** \struct NW_AffineCosts32
+ * \brief the costs of a struct NW_Costs, in the type of the cells of the kernels
+ */
+struct NW_AffineCosts32
+{
+   int32_t substitution;         /*!< substitution of two different known bases */
+   int32_t substitution_unknown; /*!< substitution involving an unknown base */
+   int32_t gap_first;            /*!< first base of a gap: gap_open + gap_extend */
+   int32_t gap_extend;           /*!< next bases of a gap */
+};
+
+/*
+ * Kernels computing count consecutive cells of an anti-diagonal, starting at j = jlo:
+ *    h = &H_d[jlo], e = &E_d[jlo], f = &F_d[jlo], p1 = &H_{d-1}[jlo], p2 = &H_{d-2}[jlo-1], e1 = &E_{d-1}[jlo],
+ *    f1 = &F_{d-1}[jlo-1], x = &X[d-jlo-1] (reversed X), y = &Y[jlo-1]
+ * They do not compute cells after the last one.
+ */
+typedef void (*NW_AffineKernel32)(int32_t *h, int32_t *e, int32_t *f, const int32_t *p1, const int32_t *p2,
+                                  const int32_t *e1, const int32_t *f1, const unsigned char *x, const unsigned char *y,
+                                  size_t count, const struct NW_AffineCosts32 *costs);
+
+static void _NW_Affine_Scalar32(int32_t *h, int32_t *e, int32_t *f, const int32_t *p1, const int32_t *p2,
+                                const int32_t *e1, const int32_t *f1, const unsigned char *x, const unsigned char *y,
+                                size_t count, const struct NW_AffineCosts32 *costs)
+{
+   for (size_t j = 0; j < count; ++j)
+   {
+      int32_t cost = (x[j] == UNKOWN_BASE || y[j] == UNKOWN_BASE) ? costs->substitution_unknown
+                                                                  : ((x[j] == y[j]) ? 0 : costs->substitution);
+      int32_t ej = e1[j] + costs->gap_extend, fj = f1[j] + costs->gap_extend;
+      if (p1[j] + costs->gap_first < ej)
+         ej = p1[j] + costs->gap_first;
+      if (p1[j - 1] + costs->gap_first < fj)
+         fj = p1[j - 1] + costs->gap_first;
+      int32_t best = p2[j] + cost;
+      if (ej < best)
+         best = ej;
+      if (fj < best)
+         best = fj;
+      e[j] = ej;
+      f[j] = fj;
+      h[j] = best;
+   }
+}
+
+#ifdef NW_SIMD_X86
+__attribute__((target("sse4.1"))) static void _NW_Affine_Sse41_32(int32_t *h, int32_t *e, int32_t *f, const int32_t *p1,
+                                                                  const int32_t *p2, const int32_t *e1, const int32_t *f1,
+                                                                  const unsigned char *x, const unsigned char *y,
+                                                                  size_t count, const struct NW_AffineCosts32 *costs)
+{
+   const __m128i unknown = _mm_set1_epi32(UNKOWN_BASE), sub = _mm_set1_epi32(costs->substitution);
+   const __m128i sub_unknown = _mm_set1_epi32(costs->substitution_unknown);
+   const __m128i first = _mm_set1_epi32(costs->gap_first), extend = _mm_set1_epi32(costs->gap_extend);
+   size_t j = 0;
+   for (; j + 4 <= count; j += 4)
+   {
+      int32_t xw, yw;
+      memcpy(&xw, x + j, sizeof(xw));
+      memcpy(&yw, y + j, sizeof(yw));
+      __m128i xv = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(xw)), yv = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(yw));
+      __m128i involves_unknown = _mm_or_si128(_mm_cmpeq_epi32(xv, unknown), _mm_cmpeq_epi32(yv, unknown));
+      __m128i cost = _mm_blendv_epi8(_mm_andnot_si128(_mm_cmpeq_epi32(xv, yv), sub), sub_unknown, involves_unknown);
+      __m128i up = _mm_loadu_si128((const __m128i *)(p1 + j));
+      __m128i left = _mm_loadu_si128((const __m128i *)(p1 + j - 1));
+      __m128i ev = _mm_min_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *)(e1 + j)), extend),
+                                 _mm_add_epi32(up, first));
+      __m128i fv = _mm_min_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *)(f1 + j)), extend),
+                                 _mm_add_epi32(left, first));
+      __m128i best = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(p2 + j)), cost);
+      best = _mm_min_epi32(best, _mm_min_epi32(ev, fv));
+      _mm_storeu_si128((__m128i *)(e + j), ev);
+      _mm_storeu_si128((__m128i *)(f + j), fv);
+      _mm_storeu_si128((__m128i *)(h + j), best);
+   }
+   _NW_Affine_Scalar32(h + j, e + j, f + j, p1 + j, p2 + j, e1 + j, f1 + j, x + j, y + j, count - j, costs);
+}
+
+__attribute__((target("avx2"))) static void _NW_Affine_Avx2_32(int32_t *h, int32_t *e, int32_t *f, const int32_t *p1,
+                                                               const int32_t *p2, const int32_t *e1, const int32_t *f1,
+                                                               const unsigned char *x, const unsigned char *y,
+                                                               size_t count, const struct NW_AffineCosts32 *costs)
+{
+   const __m256i unknown = _mm256_set1_epi32(UNKOWN_BASE), sub = _mm256_set1_epi32(costs->substitution);
+   const __m256i sub_unknown = _mm256_set1_epi32(costs->substitution_unknown);
+   const __m256i first = _mm256_set1_epi32(costs->gap_first), extend = _mm256_set1_epi32(costs->gap_extend);
+   size_t j = 0;
+   for (; j + 8 <= count; j += 8)
+   {
+      __m256i xv = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(x + j)));
+      __m256i yv = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(y + j)));
+      __m256i involves_unknown = _mm256_or_si256(_mm256_cmpeq_epi32(xv, unknown), _mm256_cmpeq_epi32(yv, unknown));
+      __m256i cost = _mm256_blendv_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi32(xv, yv), sub), sub_unknown,
+                                        involves_unknown);
+      __m256i up = _mm256_loadu_si256((const __m256i *)(p1 + j));
+      __m256i left = _mm256_loadu_si256((const __m256i *)(p1 + j - 1));
+      __m256i ev = _mm256_min_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(e1 + j)), extend),
+                                    _mm256_add_epi32(up, first));
+      __m256i fv = _mm256_min_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(f1 + j)), extend),
+                                    _mm256_add_epi32(left, first));
+      __m256i best = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(p2 + j)), cost);
+      best = _mm256_min_epi32(best, _mm256_min_epi32(ev, fv));
+      _mm256_storeu_si256((__m256i *)(e + j), ev);
+      _mm256_storeu_si256((__m256i *)(f + j), fv);
+      _mm256_storeu_si256((__m256i *)(h + j), best);
+   }
+   _NW_Affine_Scalar32(h + j, e + j, f + j, p1 + j, p2 + j, e1 + j, f1 + j, x + j, y + j, count - j, costs);
+}
+#endif /* NW_SIMD_X86 */
+
+/*
+ * \brief affine distance between the compacted codes X[0..M-1] and Y[0..N-1] (N >= 1) by anti-diagonals, as
+ * _NW_AntiDiag32: the boundary cells D[d][0] and D[0][d] are set after the kernel on the interior cells j = jlo..jhi
+ */
+static long _NW_AffineAntiDiag(const unsigned char *X, size_t M, const unsigned char *Y, size_t N,
+                               const struct NW_AffineCosts32 *costs)
+{
+   NW_AffineKernel32 kernel = _NW_Affine_Scalar32;
+#ifdef NW_SIMD_X86
+   if (__builtin_cpu_supports("avx2"))
+      kernel = _NW_Affine_Avx2_32;
+   else if (__builtin_cpu_supports("sse4.1"))
+      kernel = _NW_Affine_Sse41_32;
+#endif
+   struct NW_Scratch reversed = {NULL, 0};
+   unsigned char *Xr = _NW_ReversedCodes(X, M, &reversed);
+   size_t width = N + 1;
+   int32_t *diags = (int32_t *)malloc(7 * width * sizeof(int32_t));
+   if (diags == NULL)
+   {
+      perror("_NW_AffineAntiDiag: malloc of diags");
+      exit(EXIT_FAILURE);
+   }
+   int32_t *p2 = diags, *p1 = diags + width, *h = diags + 2 * width;
+   int32_t *e1 = diags + 3 * width, *e = diags + 4 * width, *f1 = diags + 5 * width, *f = diags + 6 * width;
+   p1[0] = 0;
+   e1[0] = f1[0] = NW_AFFINE_INFINITE;
+   for (size_t d = 1; d <= M + N; ++d)
+   {
+      size_t jlo = (d > M) ? d - M : 1;
+      size_t jhi = (d <= N) ? d - 1 : N;
+      if (jlo <= jhi)
+         kernel(h + jlo, e + jlo, f + jlo, p1 + jlo, p2 + jlo - 1, e1 + jlo, f1 + jlo - 1, Xr + M - d + jlo,
+                Y + jlo - 1, jhi - jlo + 1, costs);
+      int32_t gap = costs->gap_first + (int32_t)(d - 1) * costs->gap_extend;
+      if (d <= M)
+      {
+         h[0] = e[0] = gap;
+         f[0] = NW_AFFINE_INFINITE;
+      }
+      if (d <= N)
+      {
+         h[d] = f[d] = gap;
+         e[d] = NW_AFFINE_INFINITE;
+      }
+      int32_t *tmp = p2;
+      p2 = p1;
+      p1 = h;
+      h = tmp;
+      tmp = e1;
+      e1 = e;
+      e = tmp;
+      tmp = f1;
+      f1 = f;
+      f = tmp;
+   }
+   long res = p1[N];
+   free(diags);
+   free(reversed.data);
+   return res;
+}
+
+/*
+ * \brief affine distance between the compacted codes X[0..M-1] and Y[0..N-1] in a single column of 64-bit cells
+ */
+static long _NW_AffineColumn(const unsigned char *X, size_t M, const unsigned char *Y, size_t N,
+                             const struct NW_Costs *costs)
+{
+   const long infinite = LONG_MAX / 4;
+   long first = costs->gap_open + costs->gap_extend;
+   long *H = (long *)malloc((N + 1) * sizeof(long));
+   long *E = (long *)malloc((N + 1) * sizeof(long));
+   if (H == NULL || E == NULL)
+   {
+      perror("_NW_AffineColumn: malloc of the columns");
+      exit(EXIT_FAILURE);
+   }
+   H[0] = 0;
+   E[0] = infinite;
+   for (size_t j = 1; j <= N; ++j)
+   {
+      H[j] = first + (long)(j - 1) * costs->gap_extend;
+      E[j] = infinite;
+   }
+   for (size_t i = 1; i <= M; ++i)
+   {
+      long diag = H[0];
+      long F = infinite;
+      H[0] = E[0] = first + (long)(i - 1) * costs->gap_extend;
+      for (size_t j = 1; j <= N; ++j)
+      {
+         long cost = (X[i - 1] == UNKOWN_BASE || Y[j - 1] == UNKOWN_BASE)
+                         ? costs->substitution_unknown
+                         : ((X[i - 1] == Y[j - 1]) ? 0 : costs->substitution);
+         long e = E[j] + costs->gap_extend;
+         if (H[j] + first < e)
+            e = H[j] + first;
+         F += costs->gap_extend;
+         if (H[j - 1] + first < F)
+            F = H[j - 1] + first;
+         long best = diag + cost;
+         if (e < best)
+            best = e;
+         if (F < best)
+            best = F;
+         diag = H[j];
+         E[j] = e;
+         H[j] = best;
+      }
+   }
+   long res = H[N];
+   free(H);
+   free(E);
+   return res;
+}
+
+long EditDistance_NW_Affine(char *A, size_t lengthA, char *B, size_t lengthB, const struct NW_Costs *costs)
+{
+   if (costs->substitution == SUBSTITUTION_COST && costs->substitution_unknown == SUBSTITUTION_UNKNOWN_COST &&
+       costs->gap_open == 0 && costs->gap_extend == INSERTION_COST) /* the linear model of the other engines */
+      return EditDistance_NW_Dispatch(NULL, A, lengthA, B, lengthB, NW_ENGINE_AUTO, NULL);
+   struct EncodedSequence seqA, seqB;
+   EncodeSequence(A, lengthA, &seqA);
+   EncodeSequence(B, lengthB, &seqB);
+   struct EncodedSequence *X = &seqA, *Y = &seqB;
+   if (seqA.length < seqB.length)
+   {
+      X = &seqB;
+      Y = &seqA;
+   }
+   long res;
+   if (Y->length == 0)
+      res = (X->length == 0) ? 0 : costs->gap_open + (long)X->length * costs->gap_extend;
+   else
+   {
+      /* Upper bound of any finite cell: both sequences inserted, then a gap opened and a substitution */
+      double bound = 3.0 * costs->gap_open + (double)costs->gap_extend * (X->length + Y->length + 1) +
+                     costs->substitution + costs->substitution_unknown;
+      if (bound < (double)NW_AFFINE_INFINITE / 2)
+      {
+         struct NW_AffineCosts32 costs32 = {(int32_t)costs->substitution, (int32_t)costs->substitution_unknown,
+                                            (int32_t)(costs->gap_open + costs->gap_extend), (int32_t)costs->gap_extend};
+         res = _NW_AffineAntiDiag(X->codes, X->length, Y->codes, Y->length, &costs32);
+      }
+      else
+         res = _NW_AffineColumn(X->codes, X->length, Y->codes, Y->length, costs);
+   }
+   EncodedSequence_Free(&seqA);
+   EncodedSequence_Free(&seqB);
+   return res;
+}
+
+/*****************************************************************************/
+/* Runtime selection of the engine
+ * NW_ENGINE_AUTO encodes the sequences once, then:
+ *    - small matrices (less than NW_AUTO_SMALL_CELLS cells) are computed by the anti-diagonal engine;
+ *    - if the sequences look similar (cf _NW_EstimateSimilarity), the WFA engine is tried with a bounded score,
+ *      its work O(s^2) being kept small compared to the M*N cells of a full computation;
+ *    - else (or if the distance exceeds the bound) the full matrix is computed by the striped engine when AVX2
+ *      is available, by the tiles on the default pool when there are many threads but no AVX2,
+ *      else by the anti-diagonal engine (SSE4.1 or scalar).
+ * NW_ENGINE_AUTO_PAR computes the full matrix by the tiles as soon as the default pool has several threads:
+ * it is meant for the large pairs of a batch, the other threads being busy with other pairs otherwise.
+ */
+
+/** \def NW_AUTO_SMALL_CELLS
+ * \brief number of cells under which NW_ENGINE_AUTO does not try to be clever
+ */
+#define NW_AUTO_SMALL_CELLS (1L << 16)
+
+/** \def NW_AUTO_KMER
+ * \brief length of the words of Y searched in X to estimate the similarity
+ */
+#define NW_AUTO_KMER 16
+
+/** \def NW_AUTO_SAMPLES
+ * \brief number of words of Y searched in X to estimate the similarity
+ */
+#define NW_AUTO_SAMPLES 64
+
+/** \def NW_AUTO_PARALLEL_THREADS
+ * \brief minimal number of threads of the default pool for which the scalar tiles beat the anti-diagonal engine
+ */
+#define NW_AUTO_PARALLEL_THREADS 4
+
+static const char *const _NW_engine_names[NW_ENGINE_COUNT] = {
+    [NW_ENGINE_AUTO] = "auto",
+    [NW_ENGINE_AUTO_PAR] = "auto-par",
+    [NW_ENGINE_REC] = "rec",
+    [NW_ENGINE_ITER] = "iter",
+    [NW_ENGINE_CA] = "ca",
+    [NW_ENGINE_CO] = "co",
+    [NW_ENGINE_CO_PAR] = "co-par",
+    [NW_ENGINE_SIMD] = "simd",
+    [NW_ENGINE_STRIPED] = "striped",
+    [NW_ENGINE_WFA] = "wfa",
+    [NW_ENGINE_BANDED] = "banded",
+};
+
+static long (*const _NW_engine_functions[NW_ENGINE_COUNT])(char *, size_t, char *, size_t) = {
+    [NW_ENGINE_AUTO] = NULL,
+    [NW_ENGINE_AUTO_PAR] = NULL,
+    [NW_ENGINE_REC] = EditDistance_NW_Rec,
+    [NW_ENGINE_ITER] = EditDistance_NW_Iter,
+    [NW_ENGINE_CA] = EditDistance_NW_Iter_CA,
+    [NW_ENGINE_CO] = EditDistance_NW_Iter_CO,
+    [NW_ENGINE_CO_PAR] = EditDistance_NW_Iter_CO_Par,
+    [NW_ENGINE_SIMD] = EditDistance_NW_Simd,
+    [NW_ENGINE_STRIPED] = EditDistance_NW_Striped,
+    [NW_ENGINE_WFA] = EditDistance_NW_Wfa,
+    [NW_ENGINE_BANDED] = EditDistance_NW_Banded,
+};
+
+const char *NW_EngineName(enum NW_Engine engine)
+{
+   return (engine >= 0 && engine < NW_ENGINE_COUNT) ? _NW_engine_names[engine] : "unknown";
+}
+
+int NW_EngineFromName(const char *name, enum NW_Engine *engine)
+{
+   for (int e = 0; e < NW_ENGINE_COUNT; ++e)
+   {
+      if (strcmp(name, _NW_engine_names[e]) == 0)
+      {
+         *engine = (enum NW_Engine)e;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+unsigned NW_CpuFeatures(void)
+{
+   unsigned features = 0;
+#ifdef NW_SIMD_X86
+   if (__builtin_cpu_supports("sse4.1"))
+      features |= NW_CPU_SSE41;
+   if (__builtin_cpu_supports("avx2"))
+      features |= NW_CPU_AVX2;
+   if (__builtin_cpu_supports("avx512bw"))
+      features |= NW_CPU_AVX512;
+#endif
+   return features;
+}
+
+/*
+ * \brief estimates the fraction of Y[0..N-1] that is aligned with X[0..M-1] without errors (N <= M)
+ * Words of NW_AUTO_KMER bases sampled regularly in Y are searched in X around the same relative position
+ * (the window is widened by the length difference, since the alignment may drift by that much).
+ */
+static double _NW_EstimateSimilarity(const unsigned char *X, size_t M, const unsigned char *Y, size_t N)
+{
+   if (N < NW_AUTO_KMER)
+      return 0.;
+   size_t window = 64 + (M - N);
+   if (window > 4096)
+      window = 4096;
+   size_t samples = (N / NW_AUTO_KMER < NW_AUTO_SAMPLES) ? N / NW_AUTO_KMER : NW_AUTO_SAMPLES;
+   size_t found = 0;
+   for (size_t k = 0; k < samples; ++k)
+   {
+      size_t p = k * (N - NW_AUTO_KMER) / samples;
+      size_t q = (size_t)((double)p * (double)M / (double)N);
+      size_t first = (q > window) ? q - window : 0;
+      size_t last = (q + window + NW_AUTO_KMER <= M) ? q + window : M - NW_AUTO_KMER;
+      for (size_t i = first; i <= last; ++i)
+      {
+         if (memcmp(X + i, Y + p, NW_AUTO_KMER) == 0)
+         {
+            ++found;
+            break;
+         }
+      }
+   }
+   return (double)found / (double)samples;
+}
+
+/*
+ * \brief distance between the codes X[0..M-1] and Y[0..N-1] (N <= M) by the engine that should be the fastest,
+ * that is stored in *used; the buffers of the anti-diagonal engine are kept in scratch.
+ * If parallel, the full matrix is computed by the tiles when the default pool has several threads.
+ * profile is NULL, or the query profile of X (if profile_is_x) or Y, used instead of building the one of Y.
+ */
+static long _NW_Auto(const unsigned char *X, size_t M, const unsigned char *Y, size_t N, struct NW_Scratch *scratch,
+                     int parallel, const struct NW_QueryProfile *profile, int profile_is_x, enum NW_Engine *used)
+{
+   double cells = (double)M * (double)N;
+   unsigned features = NW_CpuFeatures();
+   int threads = ThreadPool_Size(ThreadPool_Default());
+   int tiles = (cells > NW_AUTO_SMALL_CELLS) &&
+               ((parallel && threads > 1) || (!(features & NW_CPU_AVX2) && threads >= NW_AUTO_PARALLEL_THREADS));
+   long res;
+   if (cells > NW_AUTO_SMALL_CELLS && _NW_EstimateSimilarity(X, M, Y, N) >= 0.5)
+   { /* WFA while its O(s^2) work is less than 1/64 of the cells */
+      long max_score = (long)(INSERTION_COST * sqrt(cells) / 8);
+      if ((long)(M - N) * INSERTION_COST <= max_score)
+      {
+         res = _NW_Wfa(X, M, Y, N, max_score);
+         if (res >= 0)
+         {
+            *used = NW_ENGINE_WFA;
+            return res;
+         }
+      }
+   }
+   if (tiles)
+      res = -1; /* computed by the tiles below */
+   else if (cells > NW_AUTO_SMALL_CELLS && (features & NW_CPU_AVX2) && profile != NULL)
+   {
+      res = profile_is_x ? _NW_Striped(profile, Y, N) : _NW_Striped(profile, X, M);
+      *used = NW_ENGINE_STRIPED;
+   }
+   else if (cells > NW_AUTO_SMALL_CELLS && (features & NW_CPU_AVX2))
+   {
+      unsigned char *Yp = (unsigned char *)malloc(N + ENCODED_SEQUENCE_PADDING);
+      if (Yp == NULL)
+      {
+         perror("EditDistance_NW_Dispatch: malloc of profiled codes");
+         exit(EXIT_FAILURE);
+      }
+      memcpy(Yp, Y, N + ENCODED_SEQUENCE_PADDING);
+      struct NW_QueryProfile *prof = _NW_QueryProfile_Create(Yp, N);
+      res = _NW_Striped(prof, X, M);
+      NW_QueryProfile_Free(prof);
+      *used = NW_ENGINE_STRIPED;
+   }
+   else
+   {
+      res = _NW_AntiDiag(X, M, Y, N, scratch);
+      *used = NW_ENGINE_SIMD;
+   }
+   if (res < 0) /* tiles, or too long for 32-bit cells */
+   {
+      res = _NW_Tiles(X, M, Y, N, ThreadPool_Default());
+      *used = NW_ENGINE_CO_PAR;
+   }
+   return res;
+}
+
+struct NW_Workspace
+{
+   struct EncodedSequence seqA;                        /*!< codes of the last sequence A */
+   struct EncodedSequence seqB;                        /*!< codes of the last sequence B */
+   struct NW_Scratch scratch[NW_ANTIDIAG_SCRATCHES]; /*!< buffers of the anti-diagonal engine */
+};
+
+struct NW_Workspace *NW_Workspace_Create(void)
+{
+   struct NW_Workspace *ws = (struct NW_Workspace *)malloc(sizeof(struct NW_Workspace));
+   if (ws == NULL)
+   {
+      perror("NW_Workspace_Create: malloc of workspace");
+      exit(EXIT_FAILURE);
+   }
+   struct EncodedSequence empty = ENCODED_SEQUENCE_EMPTY;
+   ws->seqA = empty;
+   ws->seqB = empty;
+   for (int k = 0; k < NW_ANTIDIAG_SCRATCHES; ++k)
+   {
+      ws->scratch[k].data = NULL;
+      ws->scratch[k].capacity = 0;
+   }
+   return ws;
+}
+
+void NW_Workspace_Free(struct NW_Workspace *ws)
+{
+   EncodedSequence_Free(&ws->seqA);
+   EncodedSequence_Free(&ws->seqB);
+   for (int k = 0; k < NW_ANTIDIAG_SCRATCHES; ++k)
+      free(ws->scratch[k].data);
+   free(ws);
+}
+
+long EditDistance_NW_Dispatch(struct NW_Workspace *ws, char *A, size_t lengthA, char *B, size_t lengthB,
+                              enum NW_Engine engine, enum NW_Engine *used)
+{
+   enum NW_Engine selected = engine;
+   long res;
+   if (engine > NW_ENGINE_AUTO_PAR && engine < NW_ENGINE_COUNT)
+      res = _NW_engine_functions[engine](A, lengthA, B, lengthB);
+   else
+   {
+      struct NW_Workspace *w = (ws != NULL) ? ws : NW_Workspace_Create();
+      ReencodeSequence(A, lengthA, &w->seqA);
+      ReencodeSequence(B, lengthB, &w->seqB);
+      res = (w->seqA.length >= w->seqB.length)
+                ? _NW_Auto(w->seqA.codes, w->seqA.length, w->seqB.codes, w->seqB.length, w->scratch, engine == NW_ENGINE_AUTO_PAR, NULL, 0, &selected)
+                : _NW_Auto(w->seqB.codes, w->seqB.length, w->seqA.codes, w->seqA.length, w->scratch, engine == NW_ENGINE_AUTO_PAR, NULL, 0, &selected);
+      if (ws == NULL)
+         NW_Workspace_Free(w);
+   }
+   if (used != NULL)
+      *used = selected;
+   return res;
+}
+
+struct NW_QueryProfile *NW_QueryProfile_BuildEncoded(const struct EncodedSequence *Y)
+{
+   unsigned char *codes = (unsigned char *)malloc(Y->length + ENCODED_SEQUENCE_PADDING);
+   if (codes == NULL)
+   {
+      perror("NW_QueryProfile_BuildEncoded: malloc of codes");
+      exit(EXIT_FAILURE);
+   }
+   memcpy(codes, Y->codes, Y->length + ENCODED_SEQUENCE_PADDING);
+   return _NW_QueryProfile_Create(codes, Y->length);
+}
+
+long EditDistance_NW_Encoded(struct NW_Workspace *ws, const struct EncodedSequence *A, const struct EncodedSequence *B,
+                             const struct NW_QueryProfile *profileB, enum NW_Engine engine, enum NW_Engine *used)
+{
+   enum NW_Engine selected;
+   int parallel = (engine == NW_ENGINE_AUTO_PAR);
+   struct NW_Workspace *w = (ws != NULL) ? ws : NW_Workspace_Create();
+   long res = (A->length >= B->length)
+                  ? _NW_Auto(A->codes, A->length, B->codes, B->length, w->scratch, parallel, profileB, 0, &selected)
+                  : _NW_Auto(B->codes, B->length, A->codes, A->length, w->scratch, parallel, profileB, 1, &selected);
+   if (ws == NULL)
+      NW_Workspace_Free(w);
+   if (used != NULL)
+      *used = selected;
+   return res;
+}
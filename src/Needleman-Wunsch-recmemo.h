@@ -6,8 +6,12 @@
  * \author Jean-Louis Roch (Ensimag, Grenoble-INP - University Grenoble-Alpes) jean-louis.roch@grenoble-inp.fr
  */
 
+#ifndef __NEEDLEMAN_WUNSCH_RECMEMO_H__
+#define __NEEDLEMAN_WUNSCH_RECMEMO_H__
+
 #include <stdlib.h> /* for size_t */
 #include <math.h>
+#include "sequence_encoding.h" /* for struct EncodedSequence */
 
 /*
  * Costs for operations on canonical bases
@@ -53,4 +57,448 @@ long EditDistance_NW_Iter(char *A, size_t lengthA, char *B, size_t lengthB);
 long EditDistance_NW_Iter_CA(char *A, size_t lengthA, char *B, size_t lengthB);
 long EditDistance_NW_Iter_CO(char *A, size_t lengthA, char *B, size_t lengthB);
 long EditDistance_NW_Iter_A(char *A, size_t lengthA, char *B, size_t lengthB);
-long test_calcul_bloc(char *A, size_t lengthA, char *B, size_t lengthB);
\ No newline at end of file
+long test_calcul_bloc(char *A, size_t lengthA, char *B, size_t lengthB);
+
+/********************************************************************************
+ * Vectorized implementation by anti-diagonals
+ */
+/**
+ * \fn long EditDistance_NW_Simd(char* A, size_t lengthA, char* B, size_t lengthB);
+ * \brief computes the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1], with the same costs as EditDistance_NW_Rec
+ * \param A  : array of char representing a genetic sequence A
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \return :  edit distance between A and B
+ *
+ * The characters that are not bases are first removed from both sequences (they cost 0);
+ * then the cells of each anti-diagonal, that are independent, are computed by AVX2 (or else SSE4.1) instructions
+ * on 16-bit cells when INSERTION_COST*(lengthA+lengthB) fits, else on 32-bit cells.
+ * Memory: O(lengthA + lengthB).
+ */
+long EditDistance_NW_Simd(char *A, size_t lengthA, char *B, size_t lengthB);
+
+/********************************************************************************
+ * Striped vectorized implementation with a query profile (one sequence against many)
+ */
+/**
+ * \struct NW_QueryProfile
+ * \brief opaque query profile of a sequence: its bases laid out in interleaved AVX2 segments, with the
+ * substitution costs precomputed for each base code (cf Needleman-Wunsch-recmemo.c)
+ */
+struct NW_QueryProfile;
+
+/**
+ * \fn struct NW_QueryProfile *NW_QueryProfile_Build(char *Y, size_t lengthY);
+ * \brief builds the query profile of Y[0 .. lengthY-1]; the profile has to be freed by NW_QueryProfile_Free
+ */
+struct NW_QueryProfile *NW_QueryProfile_Build(char *Y, size_t lengthY);
+
+/**
+ * \fn void NW_QueryProfile_Free(struct NW_QueryProfile *profile);
+ * \brief frees a profile built by NW_QueryProfile_Build
+ */
+void NW_QueryProfile_Free(struct NW_QueryProfile *profile);
+
+/**
+ * \fn long EditDistance_NW_Striped_Profile(const struct NW_QueryProfile *profile, char *X, size_t lengthX);
+ * \brief computes the edit distance between the profiled sequence and X[0 .. lengthX-1]
+ *
+ * The profile is only read: it can be reused for many sequences X, and by several threads at once.
+ */
+long EditDistance_NW_Striped_Profile(const struct NW_QueryProfile *profile, char *X, size_t lengthX);
+
+/**
+ * \fn long EditDistance_NW_Striped(char* A, size_t lengthA, char* B, size_t lengthB);
+ * \brief computes the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1] by building the query profile
+ * of the shortest sequence and calling EditDistance_NW_Striped_Profile
+ *
+ * Without AVX2, the result is computed by the anti-diagonal kernels of EditDistance_NW_Simd.
+ */
+long EditDistance_NW_Striped(char *A, size_t lengthA, char *B, size_t lengthB);
+
+/********************************************************************************
+ * Wavefront implementation for similar sequences
+ */
+/**
+ * \fn long EditDistance_NW_Wfa(char* A, size_t lengthA, char* B, size_t lengthB);
+ * \brief computes the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1], with the same costs as EditDistance_NW_Rec
+ * \param A  : array of char representing a genetic sequence A
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \return :  edit distance between A and B
+ *
+ * Wavefront alignment: time O((lengthA+lengthB) * d) and memory O(d) where d is the distance,
+ * so it is the fastest engine for near-identical sequences (eg two variants of a genome).
+ * It requires SUBSTITUTION_UNKNOWN_COST == SUBSTITUTION_COST > 0 and INSERTION_COST > 0;
+ * otherwise the anti-diagonal implementation of EditDistance_NW_Simd is used.
+ */
+long EditDistance_NW_Wfa(char *A, size_t lengthA, char *B, size_t lengthB);
+
+
+/********************************************************************************
+ * Banded implementation
+ */
+/**
+ * \fn long EditDistance_NW_Banded(char* A, size_t lengthA, char* B, size_t lengthB);
+ * \brief computes the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1], with the same costs as EditDistance_NW_Rec
+ * \param A  : array of char representing a genetic sequence A
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \return :  edit distance between A and B
+ *
+ * Only the cells of a band of diagonals of half width w around the main diagonal are computed, w being doubled
+ * (Ukkonen) until the result is provably optimal: INSERTION_COST * (2(w+1) + |lengthA-lengthB|) bounds the cost
+ * of any path leaving the band. Time O((w + |lengthA-lengthB|) * lengthA) and memory O(w + |lengthA-lengthB|).
+ */
+long EditDistance_NW_Banded(char *A, size_t lengthA, char *B, size_t lengthB);
+
+
+/********************************************************************************
+ * Threshold query
+ */
+/** \def NW_DISTANCE_ABOVE_THRESHOLD
+ *  \brief value returned by EditDistance_NW_Threshold when the distance is greater than the threshold
+ */
+#define NW_DISTANCE_ABOVE_THRESHOLD -1L
+
+/**
+ * \fn long EditDistance_NW_Threshold(char* A, size_t lengthA, char* B, size_t lengthB, long k);
+ * \brief decides if the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1] is at most k
+ * \param A  : array of char representing a genetic sequence A
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \param k :  threshold
+ * \return :  edit distance between A and B if it is <= k, else NW_DISTANCE_ABOVE_THRESHOLD
+ *
+ * Only the band of diagonals that a path of cost <= k can reach is computed, and the computation stops as soon as
+ * every cell of a column exceeds k: time O(k * max(lengthA, lengthB)) and memory O(k).
+ */
+long EditDistance_NW_Threshold(char *A, size_t lengthA, char *B, size_t lengthB, long k);
+
+/********************************************************************************
+ * Parallel implementation
+ */
+/**
+ * \fn long EditDistance_NW_Iter_CO_Par(char* A, size_t lengthA, char* B, size_t lengthB);
+ * \brief computes the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1], with the same costs as EditDistance_NW_Rec
+ * \param A  : array of char representing a genetic sequence A
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \return :  edit distance between A and B
+ *
+ * The matrix is split into square tiles that communicate through a single row and a single column, as in
+ * EditDistance_NW_Iter_CO; each tile is computed by a thread of the default pool (cf thread_pool.h) as soon as
+ * its right and lower neighbours are done. Memory O(lengthA + lengthB + number of tiles).
+ */
+long EditDistance_NW_Iter_CO_Par(char *A, size_t lengthA, char *B, size_t lengthB);
+
+
+/********************************************************************************
+ * Alignment in linear space
+ */
+/**
+ * \fn long EditDistance_NW_Align(char* A, size_t lengthA, char* B, size_t lengthB, char **cigar);
+ * \brief computes the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1] and an optimal alignment
+ * \param A  : array of char representing a genetic sequence A
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \param cigar : receives the (malloc allocated, to be freed by the caller) CIGAR string of the alignment
+ * \return :  edit distance between A and B
+ *
+ * The CIGAR string describes the alignment of the bases of A (the characters that are not bases are ignored)
+ * with the bases of B, by runs of operations: '=' base of A equal to the base of B, 'X' substitution,
+ * 'I' base of A only (insertion), 'D' base of B only (deletion); eg "5=1X2I10=".
+ * Hirschberg divide and conquer: memory O(lengthA + lengthB), the independent halves being aligned in parallel
+ * by the default pool of threads.
+ */
+long EditDistance_NW_Align(char *A, size_t lengthA, char *B, size_t lengthB, char **cigar);
+
+
+/********************************************************************************
+ * Incremental extension
+ */
+/**
+ * \struct NW_Extension
+ * \brief opaque state of a distance between a fixed sequence Y and a sequence X given by pieces: the last column of
+ * the matrix (the frontier), kept from a piece to the next one (cf Needleman-Wunsch-recmemo.c)
+ */
+struct NW_Extension;
+
+/**
+ * \fn struct NW_Extension *NW_Extension_Create(char *Y, size_t lengthY);
+ * \brief returns the state of the distance between Y[0 .. lengthY-1] and an empty X, to be freed by NW_Extension_Free
+ */
+struct NW_Extension *NW_Extension_Create(char *Y, size_t lengthY);
+
+/**
+ * \fn long NW_Extension_Append(struct NW_Extension *ext, char *X, size_t lengthX);
+ * \brief appends X[0 .. lengthX-1] to the sequence X of ext
+ * \param ext : the state, updated
+ * \param X  : array of char representing the next characters of X (the characters that are not bases cost 0, as
+ * in the other engines)
+ * \param lengthX :  number of elements in X
+ * \return :  edit distance between Y and all the characters appended to X since NW_Extension_Create
+ *
+ * Only the columns of the appended bases are computed, from the frontier: time O(lengthX * lengthY) whatever the
+ * length of X already given, and memory O(lengthY).
+ */
+long NW_Extension_Append(struct NW_Extension *ext, char *X, size_t lengthX);
+
+/**
+ * \fn long NW_Extension_Distance(const struct NW_Extension *ext);
+ * \brief returns the edit distance between Y and the characters appended to X so far
+ */
+long NW_Extension_Distance(const struct NW_Extension *ext);
+
+/**
+ * \fn size_t NW_Extension_Length(const struct NW_Extension *ext);
+ * \brief returns the number of bases appended to X so far (the characters that are not bases excluded)
+ */
+size_t NW_Extension_Length(const struct NW_Extension *ext);
+
+/**
+ * \fn void NW_Extension_Free(struct NW_Extension *ext);
+ * \brief frees ext
+ */
+void NW_Extension_Free(struct NW_Extension *ext);
+
+
+/********************************************************************************
+ * Semi-global alignment
+ */
+/**
+ * \struct NW_Placement
+ * \brief where a fragment fits best in a sequence T (cf EditDistance_NW_SemiGlobal)
+ */
+struct NW_Placement
+{
+   long distance; /*!< edit distance between the fragment and T[start .. end-1] */
+   size_t start;  /*!< first base of the range of T, counted from 0 in the bases of T (the other characters excluded) */
+   size_t end;    /*!< base following the last base of the range (end = start if the range is empty) */
+};
+
+/**
+ * \fn long EditDistance_NW_SemiGlobal(char *Q, size_t lengthQ, char *T, size_t lengthT, struct NW_Placement *placement);
+ * \brief edit distance between the whole fragment Q and the range of T where it fits best: the bases of T before and
+ * after the range are free (semi-global alignment, free end gaps on T)
+ * \param Q  : array of char representing the fragment (the characters that are not bases cost 0)
+ * \param lengthQ : number of elements in Q
+ * \param T  : array of char representing the sequence in which Q is placed, usually much longer than Q
+ * \param lengthT : number of elements in T
+ * \param placement : if not NULL, set to the distance and the range of T (the first range ending at the minimum
+ * distance, and the shortest of those ranges)
+ * \return :  the minimum over the ranges R of T of the edit distance between Q and R
+ *
+ * Computed by the vectorized anti-diagonal engine (cf EditDistance_NW_Simd): memory O(lengthQ) whatever the length
+ * of T, time O(lengthQ * lengthT).
+ */
+long EditDistance_NW_SemiGlobal(char *Q, size_t lengthQ, char *T, size_t lengthT, struct NW_Placement *placement);
+
+
+/********************************************************************************
+ * Local alignment (Smith-Waterman)
+ */
+/** \def NW_LOCAL_MATCH_SCORE
+ *  \brief score of two equal bases in a local alignment; a substitution scores -SubstitutionCost (SUBSTITUTION_COST
+ *  or SUBSTITUTION_UNKNOWN_COST) and an insertion -INSERTION_COST
+ */
+#define NW_LOCAL_MATCH_SCORE SUBSTITUTION_COST
+
+/**
+ * \struct NW_LocalAlignment
+ * \brief the ranges A[startA .. endA-1] and B[startB .. endB-1] of a best local alignment, in bases counted from 0 (the
+ * other characters excluded); all 0 if no range scores more than 0
+ */
+struct NW_LocalAlignment
+{
+   long score;    /*!< score of the alignment of the two ranges */
+   size_t startA; /*!< first base of the range of A */
+   size_t endA;   /*!< base following the last base of the range of A */
+   size_t startB; /*!< first base of the range of B */
+   size_t endB;   /*!< base following the last base of the range of B */
+};
+
+/**
+ * \fn long EditDistance_NW_Local(char *A, size_t lengthA, char *B, size_t lengthB, struct NW_LocalAlignment *local);
+ * \brief best local alignment (Smith-Waterman) of A and B: the ranges of A and B whose alignment has the highest score
+ * \param A  : array of char representing a genetic sequence A (the characters that are not bases are ignored)
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \param local : if not NULL, set to the score and the ranges (the first end in A then in B, and the shortest ranges
+ * ending there, if several have the highest score)
+ * \return :  the highest score (0 if no two bases are equal)
+ *
+ * Computed by anti-diagonals with the widest instruction set available (as EditDistance_NW_Simd), in 16-bit cells when
+ * the score cannot exceed 32767; memory O(lengthA + lengthB), time O(lengthA * lengthB).
+ */
+long EditDistance_NW_Local(char *A, size_t lengthA, char *B, size_t lengthB, struct NW_LocalAlignment *local);
+
+/**
+ * \fn long EditDistance_NW_Local_Par(char *A, size_t lengthA, char *B, size_t lengthB, struct NW_LocalAlignment *local);
+ * \brief as EditDistance_NW_Local, the matrix being computed by tiles in parallel on the threads of the default pool
+ * (cf EditDistance_NW_Iter_CO_Par), each tile by anti-diagonals; same result
+ */
+long EditDistance_NW_Local_Par(char *A, size_t lengthA, char *B, size_t lengthB, struct NW_LocalAlignment *local);
+
+
+/********************************************************************************
+ * Affine gap costs (Gotoh)
+ */
+/**
+ * \struct NW_Costs
+ * \brief costs of the operations, given at runtime: a gap of k consecutive bases (of X or of Y) costs
+ * gap_open + k * gap_extend; the linear model of the other engines is NW_COSTS_DEFAULT
+ */
+struct NW_Costs
+{
+   long substitution;         /*!< substitution of a canonical base by another (SUBSTITUTION_COST) */
+   long substitution_unknown; /*!< substitution involving an unknown base (SUBSTITUTION_UNKNOWN_COST) */
+   long gap_open;             /*!< cost of opening a gap, added once per gap (0: linear costs) */
+   long gap_extend;           /*!< cost of each base of a gap (INSERTION_COST) */
+};
+
+/** \def NW_COSTS_DEFAULT
+ * \brief initial value of a struct NW_Costs: the costs of the other engines
+ */
+#define NW_COSTS_DEFAULT {SUBSTITUTION_COST, SUBSTITUTION_UNKNOWN_COST, 0, INSERTION_COST}
+
+/**
+ * \fn long EditDistance_NW_Affine(char *A, size_t lengthA, char *B, size_t lengthB, const struct NW_Costs *costs);
+ * \brief edit distance between A and B with the costs costs (Gotoh: affine gap costs)
+ * \param A  : array of char representing a genetic sequence A (the characters that are not bases cost 0)
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \param costs : the costs, that have to be non negative
+ * \return :  the minimum cost of an alignment of A with B
+ *
+ * With NW_COSTS_DEFAULT the distance is computed by EditDistance_NW_Dispatch (NW_ENGINE_AUTO), with no overhead; else
+ * by anti-diagonals in 32-bit cells with the widest instruction set available (as EditDistance_NW_Simd), or in a
+ * single column of 64-bit cells if 32 bits could overflow: memory O(min(lengthA, lengthB)), time O(lengthA * lengthB).
+ */
+long EditDistance_NW_Affine(char *A, size_t lengthA, char *B, size_t lengthB, const struct NW_Costs *costs);
+
+
+/********************************************************************************
+ * Runtime selection of the engine
+ */
+/**
+ * \enum NW_Engine
+ * \brief the engines that compute the edit distance (cf the functions above)
+ */
+enum NW_Engine
+{
+   NW_ENGINE_AUTO = 0, /*!< selected at runtime from the sizes, the similarity of the sequences and the cpu features */
+   NW_ENGINE_AUTO_PAR, /*!< as NW_ENGINE_AUTO, but a full matrix is computed in parallel (tiles) if there are several threads */
+   NW_ENGINE_REC,      /*!< EditDistance_NW_Rec */
+   NW_ENGINE_ITER,     /*!< EditDistance_NW_Iter */
+   NW_ENGINE_CA,       /*!< EditDistance_NW_Iter_CA */
+   NW_ENGINE_CO,       /*!< EditDistance_NW_Iter_CO */
+   NW_ENGINE_CO_PAR,   /*!< EditDistance_NW_Iter_CO_Par */
+   NW_ENGINE_SIMD,     /*!< EditDistance_NW_Simd */
+   NW_ENGINE_STRIPED,  /*!< EditDistance_NW_Striped */
+   NW_ENGINE_WFA,      /*!< EditDistance_NW_Wfa */
+   NW_ENGINE_BANDED,   /*!< EditDistance_NW_Banded */
+   NW_ENGINE_COUNT     /*!< number of values of enum NW_Engine */
+};
+
+/** \def NW_CPU_SSE41
+ * \brief bit of NW_CpuFeatures() set when the processor supports SSE4.1
+ */
+#define NW_CPU_SSE41 1u
+
+/** \def NW_CPU_AVX2
+ * \brief bit of NW_CpuFeatures() set when the processor supports AVX2
+ */
+#define NW_CPU_AVX2 2u
+
+/** \def NW_CPU_AVX512
+ * \brief bit of NW_CpuFeatures() set when the processor supports AVX-512 (BW); no engine uses it yet
+ */
+#define NW_CPU_AVX512 4u
+
+/**
+ * \fn unsigned NW_CpuFeatures(void);
+ * \brief returns the vector instruction sets of the processor (cpuid), as NW_CPU_* bits
+ */
+unsigned NW_CpuFeatures(void);
+
+/**
+ * \fn const char *NW_EngineName(enum NW_Engine engine);
+ * \brief returns the name of engine, as accepted by NW_EngineFromName (eg "auto", "co", "striped")
+ */
+const char *NW_EngineName(enum NW_Engine engine);
+
+/**
+ * \fn int NW_EngineFromName(const char *name, enum NW_Engine *engine);
+ * \brief stores in *engine the engine called name; returns 0 if there is none
+ */
+int NW_EngineFromName(const char *name, enum NW_Engine *engine);
+
+/**
+ * \struct NW_Workspace
+ * \brief opaque buffers (codes of the sequences, columns of the engines) reused by successive calls of EditDistance_NW_Dispatch
+ */
+struct NW_Workspace;
+
+/**
+ * \fn struct NW_Workspace *NW_Workspace_Create(void);
+ * \brief returns a new empty workspace, to be freed by NW_Workspace_Free; a workspace is used by one thread at a time
+ */
+struct NW_Workspace *NW_Workspace_Create(void);
+
+/**
+ * \fn void NW_Workspace_Free(struct NW_Workspace *ws);
+ * \brief frees ws and its buffers
+ */
+void NW_Workspace_Free(struct NW_Workspace *ws);
+
+/**
+ * \fn long EditDistance_NW_Dispatch(struct NW_Workspace *ws, char* A, size_t lengthA, char* B, size_t lengthB, enum NW_Engine engine, enum NW_Engine *used);
+ * \brief computes the edit distance between A[0 .. lengthA-1] and B[0 .. lengthB-1] with engine
+ * \param ws : buffers kept from a call to the next one (only grown when the sequences get longer), or NULL
+ * \param A  : array of char representing a genetic sequence A
+ * \param lengthA :  number of elements in A
+ * \param B  : array of char representing a genetic sequence B
+ * \param lengthB :  number of elements in B
+ * \param engine : the engine to use, or NW_ENGINE_AUTO (resp. NW_ENGINE_AUTO_PAR) to select the fastest one (resp. parallel)
+ * \param used : if not NULL, receives the engine that computed the distance
+ * \return :  edit distance between A and B
+ *
+ * NW_ENGINE_AUTO encodes the sequences once and uses the anti-diagonal engine for small inputs, the WFA engine
+ * for similar sequences (with a bound on its work), and else the striped engine (AVX2), the tiles (many threads)
+ * or the anti-diagonal engine (SSE4.1 or scalar). With a workspace, computing many small distances does not allocate.
+ */
+long EditDistance_NW_Dispatch(struct NW_Workspace *ws, char *A, size_t lengthA, char *B, size_t lengthB,
+                              enum NW_Engine engine, enum NW_Engine *used);
+
+/**
+ * \fn struct NW_QueryProfile *NW_QueryProfile_BuildEncoded(const struct EncodedSequence *Y);
+ * \brief builds the query profile of the encoded sequence Y (that is copied); to be freed by NW_QueryProfile_Free
+ */
+struct NW_QueryProfile *NW_QueryProfile_BuildEncoded(const struct EncodedSequence *Y);
+
+/**
+ * \fn long EditDistance_NW_Encoded(struct NW_Workspace *ws, const struct EncodedSequence *A, const struct EncodedSequence *B, const struct NW_QueryProfile *profileB, enum NW_Engine engine, enum NW_Engine *used);
+ * \brief as EditDistance_NW_Dispatch with NW_ENGINE_AUTO, for sequences already encoded (cf sequence_encoding.h)
+ * \param ws : buffers kept from a call to the next one, or NULL
+ * \param A : the encoded sequence A
+ * \param B : the encoded sequence B
+ * \param profileB : NULL, or the query profile of B (cf NW_QueryProfile_BuildEncoded), used if the striped engine is selected
+ * \param engine : NW_ENGINE_AUTO or NW_ENGINE_AUTO_PAR
+ * \param used : if not NULL, receives the engine that computed the distance
+ * \return :  edit distance between A and B
+ *
+ * Meant for comparing a sequence with many others: its encoding and its profile are computed once.
+ */
+long EditDistance_NW_Encoded(struct NW_Workspace *ws, const struct EncodedSequence *A, const struct EncodedSequence *B,
+                             const struct NW_QueryProfile *profileB, enum NW_Engine engine, enum NW_Engine *used);
+
+#endif /* __NEEDLEMAN_WUNSCH_RECMEMO_H__ */
@@ -0,0 +1,233 @@
+/**
+ * \file all_vs_all.c
+ * \brief implementation of the all-vs-all mode
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see all_vs_all.h
+ */
+
+#include "all_vs_all.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <err.h>
+#include "mapped_file.h"
+#include "fasta.h"
+#include "thread_pool.h"
+
+/** \struct AllVsAllContext
+ * \brief data shared by the rows of the matrix
+ */
+struct AllVsAllContext
+{
+   const struct AllVsAllOptions *options; /*!< engine of the computation */
+   size_t n;                              /*!< number of records */
+   struct FastaRecord *records;           /*!< records[0..n-1] */
+   struct EncodedSequence *encoded;       /*!< encoded[i] is the encoding of records[i] */
+   long *distances;                       /*!< upper triangle, cf AllVsAll_Index */
+   int profiles;                          /*!< if not 0, the rows build the query profile of their record */
+};
+
+/** \struct AllVsAllRow
+ * \brief task computing the distances d(i, j) for j = i+1..n-1
+ */
+struct AllVsAllRow
+{
+   struct AllVsAllContext *ctx; /*!< the matrix */
+   size_t i;                    /*!< the row */
+};
+
+/*
+ * \brief index of d(i, j), i < j, in the upper triangle of a n x n matrix stored by rows
+ */
+static size_t _AllVsAll_Index(size_t n, size_t i, size_t j)
+{
+   return i * n - i * (i + 1) / 2 + (j - i - 1);
+}
+
+static void _AllVsAll_RunRow(void *arg)
+{
+   struct AllVsAllRow *row = (struct AllVsAllRow *)arg;
+   struct AllVsAllContext *ctx = row->ctx;
+   size_t i = row->i;
+   enum NW_Engine engine = ctx->options->engine;
+   struct NW_Workspace *ws = NW_Workspace_Create();
+   if (engine == NW_ENGINE_AUTO || engine == NW_ENGINE_AUTO_PAR)
+   {
+      struct NW_QueryProfile *profile = ctx->profiles ? NW_QueryProfile_BuildEncoded(&ctx->encoded[i]) : NULL;
+      for (size_t j = i + 1; j < ctx->n; ++j)
+         ctx->distances[_AllVsAll_Index(ctx->n, i, j)] =
+             EditDistance_NW_Encoded(ws, &ctx->encoded[j], &ctx->encoded[i], profile, engine, NULL);
+      if (profile != NULL)
+         NW_QueryProfile_Free(profile);
+   }
+   else
+   {
+      for (size_t j = i + 1; j < ctx->n; ++j)
+         ctx->distances[_AllVsAll_Index(ctx->n, i, j)] =
+             EditDistance_NW_Dispatch(ws, ctx->records[j].seq, ctx->records[j].length,
+                                      ctx->records[i].seq, ctx->records[i].length, engine, NULL);
+   }
+   NW_Workspace_Free(ws);
+}
+
+/*
+ * \brief d(i, j) for any i, j
+ */
+static long _AllVsAll_Distance(const struct AllVsAllContext *ctx, size_t i, size_t j)
+{
+   if (i == j)
+      return 0;
+   return (i < j) ? ctx->distances[_AllVsAll_Index(ctx->n, i, j)] : ctx->distances[_AllVsAll_Index(ctx->n, j, i)];
+}
+
+static FILE *_AllVsAll_Open(const char *path)
+{
+   if (strcmp(path, "-") == 0)
+      return stdout;
+   FILE *out = fopen(path, "w");
+   if (out == NULL)
+      err(1, "open %s", path);
+   return out;
+}
+
+static void _AllVsAll_Close(FILE *out, const char *path)
+{
+   if (out == stdout)
+      fflush(out);
+   else if (fclose(out) != 0)
+      err(1, "write %s", path);
+}
+
+static void _AllVsAll_WriteBinary(const struct AllVsAllContext *ctx, char **names, const char *path)
+{
+   FILE *out = _AllVsAll_Open(path);
+   uint32_t version = 1;
+   uint64_t n = ctx->n;
+   fwrite("NWDM", 1, 4, out);
+   fwrite(&version, sizeof(version), 1, out);
+   fwrite(&n, sizeof(n), 1, out);
+   for (size_t i = 0; i < ctx->n; ++i)
+   {
+      uint32_t length = (uint32_t)strlen(names[i]);
+      fwrite(&length, sizeof(length), 1, out);
+      fwrite(names[i], 1, length, out);
+   }
+   for (size_t k = 0; k < ctx->n * (ctx->n - 1) / 2; ++k)
+   {
+      int64_t d = ctx->distances[k];
+      fwrite(&d, sizeof(d), 1, out);
+   }
+   if (ferror(out))
+      err(1, "write %s", path);
+   _AllVsAll_Close(out, path);
+}
+
+static void _AllVsAll_WriteText(const struct AllVsAllContext *ctx, char **names, const char *path, int phylip)
+{
+   FILE *out = _AllVsAll_Open(path);
+   if (phylip)
+      fprintf(out, "%zu\n", ctx->n);
+   else
+   {
+      for (size_t j = 0; j < ctx->n; ++j)
+         fprintf(out, "\t%s", names[j]);
+      fprintf(out, "\n");
+   }
+   for (size_t i = 0; i < ctx->n; ++i)
+   {
+      fprintf(out, "%s", names[i]);
+      for (size_t j = 0; j < ctx->n; ++j)
+         fprintf(out, phylip ? " %ld" : "\t%ld", _AllVsAll_Distance(ctx, i, j));
+      fprintf(out, "\n");
+   }
+   if (ferror(out))
+      err(1, "write %s", path);
+   _AllVsAll_Close(out, path);
+}
+
+void AllVsAll_Run(char **paths, int npaths, const struct AllVsAllOptions *options)
+{
+   struct MappedFile *files = (struct MappedFile *)malloc(npaths * sizeof(struct MappedFile));
+   struct FastaRecords records = FASTA_RECORDS_INIT;
+   if (files == NULL)
+   {
+      perror("AllVsAll_Run: malloc of files");
+      exit(EXIT_FAILURE);
+   }
+   for (int k = 0; k < npaths; ++k)
+   {
+      Fasta_Open(paths[k], &files[k]);
+      Fasta_Parse(&files[k], &records);
+   }
+   size_t n = records.count;
+   if (n < 2)
+      errx(1, "--all-vs-all: %zu record found, at least 2 are needed", n);
+
+   struct AllVsAllContext ctx;
+   ctx.options = options;
+   ctx.n = n;
+   ctx.records = records.records;
+   ctx.encoded = (struct EncodedSequence *)malloc(n * sizeof(struct EncodedSequence));
+   ctx.distances = (long *)malloc(n * (n - 1) / 2 * sizeof(long));
+   char **names = (char **)malloc(n * sizeof(char *));
+   struct AllVsAllRow *rows = (struct AllVsAllRow *)malloc(n * sizeof(struct AllVsAllRow));
+   if (ctx.encoded == NULL || ctx.distances == NULL || names == NULL || rows == NULL)
+   {
+      perror("AllVsAll_Run: malloc of the matrix");
+      exit(EXIT_FAILURE);
+   }
+   ctx.profiles = (NW_CpuFeatures() & NW_CPU_AVX2) != 0;
+
+   struct ThreadPool *pool = ThreadPool_Default();
+   for (size_t i = 0; i < n; ++i)
+   {
+      const struct FastaRecord *r = &records.records[i];
+      names[i] = (char *)malloc(r->name_length + 32);
+      if (names[i] == NULL)
+      {
+         perror("AllVsAll_Run: malloc of names");
+         exit(EXIT_FAILURE);
+      }
+      if (r->name_length > 0)
+      {
+         memcpy(names[i], r->name, r->name_length);
+         names[i][r->name_length] = '\0';
+      }
+      else
+         sprintf(names[i], "record%zu", i);
+      EncodeSequence(r->seq, r->length, &ctx.encoded[i]);
+   }
+   { /* The rows, the longest first */
+      struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+      for (size_t i = 0; i + 1 < n; ++i)
+      {
+         rows[i].ctx = &ctx;
+         rows[i].i = i;
+         ThreadPool_Submit(pool, &group, _AllVsAll_RunRow, &rows[i]);
+      }
+      ThreadPool_Wait(pool, &group);
+   }
+
+   if (options->binary != NULL)
+      _AllVsAll_WriteBinary(&ctx, names, options->binary);
+   if (options->phylip != NULL)
+      _AllVsAll_WriteText(&ctx, names, options->phylip, 1);
+   if (options->tsv != NULL || (options->binary == NULL && options->phylip == NULL))
+      _AllVsAll_WriteText(&ctx, names, (options->tsv != NULL) ? options->tsv : "-", 0);
+
+   for (size_t i = 0; i < n; ++i)
+   {
+      EncodedSequence_Free(&ctx.encoded[i]);
+      free(names[i]);
+   }
+   free(names);
+   free(rows);
+   free(ctx.encoded);
+   free(ctx.distances);
+   FastaRecords_Free(&records);
+   for (int k = 0; k < npaths; ++k)
+      MappedFile_Close(&files[k]);
+   free(files);
+}
@@ -0,0 +1,44 @@
+/**
+ * \file all_vs_all.h
+ * \brief all-vs-all mode: matrix of the distances between all the records of multi-FASTA files
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Each record is encoded once (cf sequence_encoding.h); the pairs (i, j), i < j, of the upper triangle are computed
+ * in parallel by the default pool of threads, one task per row i, the query profile of record i being built once
+ * for its row.
+ *
+ * Binary format of the matrix (integers in the byte order of the machine):
+ *    "NWDM" (4 bytes), version (uint32_t, 1), n (uint64_t) the number of records,
+ *    n names, each one as its length (uint32_t) followed by its characters,
+ *    n(n-1)/2 distances (int64_t) d(i, j) for i = 0..n-2 and j = i+1..n-1, in that order.
+ * The text formats are the full symmetric matrix: TSV with the names as first row and column,
+ * or (relaxed) PHYLIP with the number of records as first line.
+ */
+
+#ifndef __ALL_VS_ALL_H__
+#define __ALL_VS_ALL_H__
+
+#include "Needleman-Wunsch-recmemo.h"
+
+/**
+ * \struct AllVsAllOptions
+ * \brief engine and output files of the all-vs-all mode
+ */
+struct AllVsAllOptions
+{
+   enum NW_Engine engine; /*!< engine computing the distances */
+   const char *binary;    /*!< pathname of the binary matrix, or NULL */
+   const char *tsv;       /*!< pathname of the TSV matrix ("-" for stdout), or NULL */
+   const char *phylip;    /*!< pathname of the PHYLIP matrix ("-" for stdout), or NULL */
+};
+
+/**
+ * \fn void AllVsAll_Run(char **paths, int npaths, const struct AllVsAllOptions *options);
+ * \brief computes the distances between all the records of the FASTA files paths[0..npaths-1] (opened by Fasta_Open:
+ * gzip files and packed stores too) and writes them in the files of options (TSV on stdout if there is none). Exits
+ * with a message on error.
+ */
+void AllVsAll_Run(char **paths, int npaths, const struct AllVsAllOptions *options);
+
+#endif /* __ALL_VS_ALL_H__ */
@@ -0,0 +1,247 @@
+/**
+ * \file batch.c
+ * \brief implementation of the batch mode
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see batch.h
+ *
+ * Scheduling: all the jobs are read first, then submitted to the default pool of threads (cf thread_pool.h) by
+ * decreasing number of cells M*N. A thread that is idle steals the oldest submitted task, ie the largest job left,
+ * while the reading thread executes the smallest ones: the large jobs start first and the small ones fill the gaps.
+ * The jobs of more than BATCH_PARALLEL_CELLS cells are computed by NW_ENGINE_AUTO_PAR, whose tiles are tasks of the
+ * same pool, so that a single large pair does not leave the other threads idle at the end of the batch.
+ */
+
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <pthread.h>
+#include "mapped_file.h"
+#include "fasta_index.h"
+#include "packed_store.h"
+#include "thread_pool.h"
+
+/** \def BATCH_PATH_MAX
+ * \brief maximal length of a pathname in a job file
+ */
+#define BATCH_PATH_MAX 4096
+
+/** \def BATCH_PARALLEL_CELLS
+ * \brief number of cells above which a job with engine auto is itself computed in parallel (NW_ENGINE_AUTO_PAR)
+ */
+#define BATCH_PARALLEL_CELLS (1L << 24)
+
+/** \struct BatchContext
+ * \brief data shared by the jobs of a batch
+ */
+struct BatchContext
+{
+   const struct BatchOptions *options; /*!< what is computed for each job */
+   pthread_mutex_t lock;               /*!< protects the workspaces below */
+   struct NW_Workspace **workspaces;   /*!< workspaces[0..nworkspaces-1] are not used by a job */
+   size_t nworkspaces;                 /*!< number of free workspaces */
+   size_t capacity;                    /*!< allocated number of elements of workspaces */
+};
+
+/** \struct BatchJob
+ * \brief a pair of sequences and its result
+ */
+struct BatchJob
+{
+   struct BatchContext *ctx; /*!< the batch the job belongs to */
+   char *seq[2];             /*!< the two sequences, in mapped files or in decoded[i] */
+   char *decoded[2];         /*!< characters of seq[i] decoded from a packed store (malloc allocated), or NULL */
+   long length[2];           /*!< their lengths */
+   double cells;             /*!< estimated cost: length[0] * length[1] */
+   long result;              /*!< the distance, or NW_DISTANCE_ABOVE_THRESHOLD */
+   char *cigar;              /*!< CIGAR string if options->with_cigar, else NULL */
+};
+
+/*
+ * \brief returns a workspace not used by another job (created if there is none)
+ */
+static struct NW_Workspace *_Batch_TakeWorkspace(struct BatchContext *ctx)
+{
+   struct NW_Workspace *ws = NULL;
+   pthread_mutex_lock(&ctx->lock);
+   if (ctx->nworkspaces > 0)
+      ws = ctx->workspaces[--ctx->nworkspaces];
+   pthread_mutex_unlock(&ctx->lock);
+   return (ws != NULL) ? ws : NW_Workspace_Create();
+}
+
+static void _Batch_ReleaseWorkspace(struct BatchContext *ctx, struct NW_Workspace *ws)
+{
+   pthread_mutex_lock(&ctx->lock);
+   if (ctx->nworkspaces == ctx->capacity)
+   {
+      ctx->capacity = (ctx->capacity == 0) ? 8 : 2 * ctx->capacity;
+      ctx->workspaces = (struct NW_Workspace **)realloc(ctx->workspaces, ctx->capacity * sizeof(struct NW_Workspace *));
+      if (ctx->workspaces == NULL)
+      {
+         perror("Batch_Run: realloc of workspaces");
+         exit(EXIT_FAILURE);
+      }
+   }
+   ctx->workspaces[ctx->nworkspaces++] = ws;
+   pthread_mutex_unlock(&ctx->lock);
+}
+
+/*
+ * \brief task computing the job arg
+ */
+static void _Batch_RunJob(void *arg)
+{
+   struct BatchJob *job = (struct BatchJob *)arg;
+   const struct BatchOptions *options = job->ctx->options;
+   if (options->with_cigar)
+      job->result = EditDistance_NW_Align(job->seq[0], job->length[0], job->seq[1], job->length[1], &job->cigar);
+   else if (options->threshold >= 0)
+      job->result = EditDistance_NW_Threshold(job->seq[0], job->length[0], job->seq[1], job->length[1], options->threshold);
+   else
+   {
+      enum NW_Engine engine = options->engine;
+      if (engine == NW_ENGINE_AUTO && job->cells > BATCH_PARALLEL_CELLS)
+         engine = NW_ENGINE_AUTO_PAR;
+      struct NW_Workspace *ws = _Batch_TakeWorkspace(job->ctx);
+      job->result = EditDistance_NW_Dispatch(ws, job->seq[0], job->length[0], job->seq[1], job->length[1], engine, NULL);
+      _Batch_ReleaseWorkspace(job->ctx, ws);
+   }
+}
+
+/*
+ * \brief order of the jobs by decreasing cost
+ */
+static int _Batch_CompareCost(const void *a, const void *b)
+{
+   const struct BatchJob *ja = *(const struct BatchJob *const *)a, *jb = *(const struct BatchJob *const *)b;
+   return (ja->cells < jb->cells) ? 1 : (ja->cells > jb->cells) ? -1 : 0;
+}
+
+void Batch_Run(FILE *jobs, const char *name, FILE *out, const struct BatchOptions *options)
+{
+   struct MappedFileCache files = MAPPED_FILE_CACHE_INIT;
+   struct FastaIndexCache indexes = FASTA_INDEX_CACHE_INIT;
+   struct BatchContext ctx = {options, PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0};
+   struct BatchJob *job = NULL;
+   size_t njobs = 0, capacity = 0;
+
+   { /* Reads the job file */
+      char *line = NULL;
+      size_t line_capacity = 0;
+      char path[2][BATCH_PATH_MAX], region[2][BATCH_PATH_MAX];
+      struct EncodedSequence codes = ENCODED_SEQUENCE_EMPTY; // bases decoded from a packed store
+      long lineno = 0;
+      while (getline(&line, &line_capacity, jobs) != -1)
+      {
+         ++lineno;
+         char *c = line + strspn(line, " \t\r\n");
+         if (*c == '\0' || *c == '#')
+            continue;
+         long begin[2], length[2];
+         char end;
+         int by_region = 0; /* file_1 region_1 file_2 region_2, cf fasta_index.h */
+         if (sscanf(c, "%4095s %ld %ld %4095s %ld %ld %c", path[0], &begin[0], &length[0], path[1], &begin[1], &length[1], &end) != 6)
+         {
+            by_region = sscanf(c, "%4095s %4095s %4095s %4095s %c", path[0], region[0], path[1], region[1], &end) == 4 &&
+                        FastaIndex_IsRegion(region[0]) && FastaIndex_IsRegion(region[1]);
+            if (!by_region)
+               errx(1, "%s:%ld: expected file_1 begin_1 length_1 file_2 begin_2 length_2 or file_1 region_1 file_2 region_2",
+                    name, lineno);
+         }
+         if (njobs == capacity)
+         {
+            capacity = (capacity == 0) ? 64 : 2 * capacity;
+            job = (struct BatchJob *)realloc(job, capacity * sizeof(struct BatchJob));
+            if (job == NULL)
+            {
+               perror("Batch_Run: realloc of jobs");
+               exit(EXIT_FAILURE);
+            }
+         }
+         struct BatchJob *j = &job[njobs++];
+         j->ctx = &ctx;
+         for (int i = 0; i < 2; ++i)
+         {
+            const struct MappedFile *f = MappedFileCache_Get(&files, path[i]);
+            j->decoded[i] = NULL;
+            if (PackedStore_IsPacked(f))
+            { /* as the distance between two sequences: positions in bases, of the first record if there is no region */
+               struct PackedStore store;
+               const struct PackedStoreRecord *record;
+               PackedStore_Attach(f, &store);
+               if (by_region)
+                  PackedStore_Resolve(&store, region[i], &record, &begin[i], &length[i]);
+               else
+                  PackedStore_Select(&store, begin[i], length[i], &record, &length[i]);
+               PackedStore_Decode(&store, record, begin[i], length[i], &codes);
+               j->decoded[i] = (char *)malloc(length[i] + 1);
+               if (j->decoded[i] == NULL)
+               {
+                  perror("Batch_Run: malloc of a sequence");
+                  exit(EXIT_FAILURE);
+               }
+               DecodeSequence(&codes, j->decoded[i]);
+               j->seq[i] = j->decoded[i];
+               j->length[i] = length[i];
+               continue;
+            }
+            if (by_region)
+            { /* as the distance between two sequences; a gzip file is decompressed in memory (fd -1), not indexed */
+               if (f->fd == -1)
+                  errx(1, "%s:%ld: %s: a region needs an uncompressed indexed file", name, lineno, path[i]);
+               FastaIndex_Resolve(FastaIndexCache_Get(&indexes, f), region[i], &begin[i], &length[i]);
+            }
+            MappedFile_Select(f, begin[i], length[i], 0, &j->seq[i], &j->length[i]);
+         }
+         j->cells = (double)j->length[0] * (double)j->length[1];
+         j->cigar = NULL;
+      }
+      free(line);
+      EncodedSequence_Free(&codes);
+      FastaIndexCache_Free(&indexes);
+   }
+
+   { /* Computes the jobs, the largest first */
+      struct BatchJob **order = (struct BatchJob **)malloc((njobs + 1) * sizeof(struct BatchJob *));
+      if (order == NULL)
+      {
+         perror("Batch_Run: malloc of order");
+         exit(EXIT_FAILURE);
+      }
+      for (size_t k = 0; k < njobs; ++k)
+         order[k] = &job[k];
+      qsort(order, njobs, sizeof(struct BatchJob *), _Batch_CompareCost);
+      struct ThreadPool *pool = ThreadPool_Default();
+      struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+      for (size_t k = 0; k < njobs; ++k)
+         ThreadPool_Submit(pool, &group, _Batch_RunJob, order[k]);
+      ThreadPool_Wait(pool, &group);
+      free(order);
+   }
+
+   for (size_t k = 0; k < njobs; ++k)
+   { /* Writes the results in the order of the job file */
+      if (job[k].result == NW_DISTANCE_ABOVE_THRESHOLD)
+         fprintf(out, ">%ld", options->threshold);
+      else
+         fprintf(out, "%ld", job[k].result);
+      if (job[k].cigar != NULL)
+      {
+         fprintf(out, "\t%s", job[k].cigar);
+         free(job[k].cigar);
+      }
+      fprintf(out, "\n");
+      free(job[k].decoded[0]);
+      free(job[k].decoded[1]);
+   }
+
+   for (size_t k = 0; k < ctx.nworkspaces; ++k)
+      NW_Workspace_Free(ctx.workspaces[k]);
+   free(ctx.workspaces);
+   pthread_mutex_destroy(&ctx.lock);
+   free(job);
+   MappedFileCache_Close(&files);
+}
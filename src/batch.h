@@ -0,0 +1,42 @@
+/**
+ * \file batch.h
+ * \brief batch mode: computes in one process the distances of many pairs of sequences listed in a job file
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Each line of the job file describes a pair as the 6 arguments of distanceEdition:
+ *    file_1 begin_1 length_1 file_2 begin_2 length_2
+ * or as the 4 arguments file_1 region_1 file_2 region_2, a region being record:start-end (cf fasta_index.h).
+ * Empty lines and lines starting by '#' are ignored. The files are mapped once (cf MappedFile_OpenInput: a gzip file is
+ * decompressed in memory, its positions are those of the decompressed file, without regions; the positions in a packed
+ * store are in bases, cf packed_store.h) and the buffers
+ * of the engines are reused from a pair to the next (cf NW_Workspace), so small pairs cost only their computation.
+ * The pairs are computed in parallel by the default pool of threads, the largest first (cf batch.c).
+ */
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdio.h>
+#include "Needleman-Wunsch-recmemo.h"
+
+/**
+ * \struct BatchOptions
+ * \brief what is computed for each pair (same meaning as the options of distanceEdition)
+ */
+struct BatchOptions
+{
+   enum NW_Engine engine; /*!< engine computing the distances */
+   long threshold;        /*!< if >= 0, only decides if the distances are <= threshold */
+   int with_cigar;        /*!< if not 0, computes an optimal alignment of each pair */
+};
+
+/**
+ * \fn void Batch_Run(FILE *jobs, const char *name, FILE *out, const struct BatchOptions *options);
+ * \brief computes the pairs of the job file jobs (called name in the error messages) and writes on out one line per pair,
+ * in the order of the job file: the distance (or >threshold), followed by a tab and the CIGAR string with_cigar.
+ * The whole job file is read before the computations start. Exits with a message on a malformed line.
+ */
+void Batch_Run(FILE *jobs, const char *name, FILE *out, const struct BatchOptions *options);
+
+#endif /* __BATCH_H__ */
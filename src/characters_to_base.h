@@ -12,6 +12,12 @@
 #ifndef __CHARACTERS_TO_BASE_h__
 #define __CHARACTERS_TO_BASE_h__
 
+#ifdef BASE_ERROR_TREATMENT
+#include <stdio.h>  /* for fprintf */
+#include <stdlib.h> /* for exit */
+#include <ctype.h>  /* for isspace */
+#endif
+
 /**********************************************/
 /* Matching between chars and bases 
 */
@@ -38,30 +44,27 @@ enum Base
 /** \var static enum Base  _base_match[256]
  * 
  * \brief _base_match maps directly a char to its corresponding base 
+ * The table is initialized at compile time: all chars are ignored but the ones below.
+ * (unused attribute: a file may include this header for enum Base only, without warning)
  */ 
-static enum Base  _base_match[256] = { SKIP_BASE }; /* initially all chars are ignored */
+static enum Base  _base_match[256] __attribute__((unused)) = { 
+   ['a'] = ADENINE, ['A'] = ADENINE,
+   ['c'] = CYTOSINE, ['C'] = CYTOSINE,
+   ['g'] = GUANINE, ['G'] = GUANINE,
+   ['t'] = THYMINE, ['T'] = THYMINE,
+   ['u'] = URACILE, ['U'] = URACILE,
+   ['n'] = UNKOWN_BASE, ['N'] = UNKOWN_BASE
+} ; /* SKIP_BASE (0) for the other chars */
 
 /**
- * \fn static void _init_base_match()
+ * \fn static inline void _init_base_match()
  * \brief definition of the  mapping from char to base
  *
- * Has to be called once before any computation for identification of a char as a base
+ * Nothing to do since _base_match is initialized at compile time; kept so that it can still be called 
+ * once before any computation, at no cost (it used to fill the table at each call).
  */
-static void  _init_base_match() /* initialisation of _base_match array for correspondence from char to base */
+static inline void  _init_base_match() 
 { 
-   for (int c = 0; c < 256; ++c) _base_match[c] = SKIP_BASE ;
-   _base_match['a'] = ADENINE ;
-   _base_match['A'] = ADENINE ;
-   _base_match['c'] = CYTOSINE ;
-   _base_match['C'] = CYTOSINE ;
-   _base_match['g'] = GUANINE ;
-   _base_match['G'] = GUANINE ;
-   _base_match['t'] = THYMINE ;
-   _base_match['T'] = THYMINE ;
-   _base_match['u'] = URACILE ;
-   _base_match['U'] = URACILE ;
-   _base_match['n'] = UNKOWN_BASE ;
-   _base_match['N'] = UNKOWN_BASE ;
 }
 
 
@@ -97,30 +100,30 @@ static void  _init_base_match() /* initialisation of _base_match array for corre
 enum BASE_ERROR_TREATMENT_MODE { IGNORED = 0, WARNING = 1, ERROR=2  } ;
 
 /** 
- * \fn void ManageBaseError(char c)
+ * \fn static inline void ManageBaseError(char c)
  * \brief according to BASE_ERROR_TREATMENT prints on stderr either nothing, or a warning or an error if the char passed as argument is not a base (known or unknown) nor a space char
  * \param c the character 
  *
  * If BASE_ERROR_TREATMENT is undefined: ManageBaseError(c) does nothing (just return)
  * else, switch ( BASE_ERROR_TREATMENT ) :
- *   BASE_WARNING : if c is neither a base nor a space, then prints a warning with c on stderr 
- *   BASE_ERROR   : if c is neither a base nor a space, then prints an error with c on stderr and exit
+ *   WARNING : if c is neither a base nor a space, then prints a warning with c on stderr 
+ *   ERROR   : if c is neither a base nor a space, then prints an error with c on stderr and exit
  *   default : does nothing (just return)
 */
-void ManageBaseError(char c)
+static inline void ManageBaseError(char c)
 { 
    #ifdef BASE_ERROR_TREATMENT
-   {  if (isBase(c)) return ; // no error
-      if (isspace(c)) return ; // \n or \t or ' ' etc are  ignored 
+   {  if (isBase((unsigned char)c)) return ; // no error
+      if (isspace((unsigned char)c)) return ; // \n or \t or ' ' etc are  ignored 
       switch ( BASE_ERROR_TREATMENT )
-      {  case BASE_WARNING : 
-            fprintf(stderr, "Warning: character %c=0x%xc not matching a base is skipped.\n", c, c ) ;
+      {  case WARNING : 
+            fprintf(stderr, "Warning: character %c=0x%x not matching a base is skipped.\n", c, (unsigned char)c ) ;
             break;
-         case BASE_ERROR :
+         case ERROR :
             fprintf(stderr, 
-               "Error: character %c=0x%xc  not matching a base is skipped.\n"
-               "   Expected bases:A=0x%xc, a=0x%xc, C=0x%xc, c=0x%xc, G=0x%xc, g=0x%xc, T=0x%xc, t=0x%xc, U0x%xc, u=0x%xc\n",
-               c, c, 'A', 'a', 'C', 'c', 'G', 'g', 'T', 't', 'U', 'u' 
+               "Error: character %c=0x%x not matching a base.\n"
+               "   Expected bases:A=0x%x, a=0x%x, C=0x%x, c=0x%x, G=0x%x, g=0x%x, T=0x%x, t=0x%x, U=0x%x, u=0x%x, N=0x%x, n=0x%x\n",
+               c, (unsigned char)c, 'A', 'a', 'C', 'c', 'G', 'g', 'T', 't', 'U', 'u', 'N', 'n' 
             ) ;
             exit(EXIT_FAILURE) ;
          default: break ;
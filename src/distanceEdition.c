@@ -4,12 +4,12 @@
  * \version 0.1
  * \date 30/09/2022
  * \author Jean-Louis Roch (Ensimag, Grenoble-INP, University Grenoble-Alpes) jean-louis.roch@grenoble-inp.fr
- * Usage : distanceEdition file1 b1 L1 file2 b2 L2
+ * Usage : distanceEdition [options] file1 b1 L1 file2 b2 L2
  * cf function usage_and_spec below.
 NAME
      distanceEdition - compute edit distance between two substrings, each from a file
 SYNOPSIS
-     distanceEdition file_1 b1 L_1 file_2 b_2 L_2
+     distanceEdition [options] file_1 b1 L_1 file_2 b_2 L_2
 DESCRIPTION
      distanceEdition computes the edit distance between two arrays of
      characters array_file_1[b_1, b_1+L_1( and array_file2[b_2,b_2+L_2( where:
@@ -45,16 +45,23 @@ EXAMPLE
  */
 
 #include "Needleman-Wunsch-recmemo.h" // Recursive implementation of NeedlemanWunsch with memoization
+#include "mapped_file.h"               // mapping of the files in virtual memory, or reading of streams
+#include "fasta_index.h"               // record:start-end addressing
+#include "packed_store.h"              // sequences packed in 2 bits per base
+#include "gzip_file.h"                 // gzip and BGZF compressed files
+#include "batch.h"                     // batch mode
+#include "all_vs_all.h"                // all-vs-all mode
+#include "one_vs_many.h"               // one-vs-many mode
+#include "window_profile.h"            // windowed mode
+#include "dot_plot.h"                  // dot-plot mode
+#include "thread_pool.h"               // for the number of threads
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <err.h>
 #include <string.h>   /* for strchr */
-#include <fcntl.h>    /* for open */
-#include <unistd.h>   /* for close */
-#include <sys/mman.h> /* for mmap and munmap */
-#include <sys/stat.h> /* for file length */
 #include <math.h>
+#include <getopt.h> /* for getopt_long */
 
 #ifdef __PERF_MESURE__
 #include "/matieres/4MMAOD6/2023-10-TP-AOD-ADN-Docs-fournis/tp-ADN-distance/srcperf/perfMesure.c"
@@ -72,7 +79,7 @@ void usage_and_spec(int argc, char *argv[]) // spécification du programme
 {
    fprintf(stderr,
            "%s : bad number of arguments: 6 are required (but this execution is with %d instead).\n"
-           "Usage:   %s  file_1 begin_1 length_1 file_2 begin_2 length_2 \n\n"
+           "Usage:   %s  [options] file_1 begin_1 length_1 file_2 begin_2 length_2 \n\n"
            "%s prints the edit distance between two genetic sequences seq[i] for i=1..2  where \n"
            "seq[i] denotes the sequence of <length_i> char in <file_i> from position <begin_i>.",
            argv[0], argc - 1, argv[0], argv[0]);
@@ -81,7 +88,14 @@ void usage_and_spec(int argc, char *argv[]) // spécification du programme
                    "\nNAME"
                    "\n     distanceEdition - compute edit distance between two substrings, each from a file"
                    "\nSYNOPSIS"
-                   "\n     distanceEdition file_1 b1 L_1 file_2 b_2 L_2"
+                   "\n     distanceEdition [options] file_1 b1 L_1 file_2 b_2 L_2"
+                   "\n     distanceEdition [options] file_1 record_1:start_1-end_1 file_2 record_2:start_2-end_2"
+                   "\n     distanceEdition [options] --batch=jobfile"
+                   "\n     distanceEdition --pack=store fasta_file ..."
+                   "\n     distanceEdition [options] --reference=fasta_file [fasta_file ...]"
+                   "\n     distanceEdition --extend=fasta_file [file]"
+                   "\n     distanceEdition [options] --all-vs-all [--output=file] [--tsv=file] [--phylip=file] fasta_file ..."
+                   "\n     distanceEdition [options] --dotplot=matrix [--tile=T] [--band=b] assembly_1 assembly_2"
                    "\nDESCRIPTION"
                    "\n     distanceEdition computes the edit distance between two arrays of"
                    "\n     characters array_file_1[b_1, b_1+L_1( and array_file2[b_2,b_2+L_2( where:"
@@ -89,6 +103,7 @@ void usage_and_spec(int argc, char *argv[]) // spécification du programme
                    "\n     The progam is designed for direct access to genetic subsequences stored in FASTA format file (.fna) ."
                    "\n     Execution performs the following actions:"
                    "\n     1. maps file_1 in an array array_file_1 in virtual memory using standard C libray function: mmap"
+                   "\n        (only the pages of array_file_1[b_1, b_1+L_1(, the comment line at b_1 included)"
                    "\n     2. prints on stderr if (L_1 <= 40)  the content of array_file_1[b_1 .. b_1+L_1-1]"
                    "\n        or else the first and last 20 characters of array_file_1"
                    "\n     3. if file_2 and file_1 are the same pathname, than array_file_2 = array_file_1;"
@@ -97,6 +112,83 @@ void usage_and_spec(int argc, char *argv[]) // spécification du programme
                    "\n           editDistance( array_file_1 + b_1, L_1, array_file_2, + b_2, L_2 )"
                    "\n        where the extern C function has prototype :"
                    "\n           editDistance( char* A, size_t lengthA, char* B, size_t lengthB);"
+                   "\n     A sequence may also be given as a region record:start-end of a FASTA file: the bases start..end (counted"
+                   "\n     from 1, end included, end of lines excluded) of the record named record; record:start is up to the end of"
+                   "\n     the record and record the whole record. The region is found in O(1) with the index file_i.fai (format of"
+                   "\n     samtools faidx), built at the first use of file_i."
+                   "\n     file_i may also be a packed store (cf --pack): begin_i and length_i are then in bases, in its first record,"
+                   "\n     and the regions are in bases of its records."
+                   "\n     file_i may also be - (the standard input) or a pipe (eg a FIFO written by a decompressor): it is then read"
+                   "\n     (the first b_i characters are skipped while reading) up to the end of the sequence only. Regions need a file."
+                   "\n     file_i may also be compressed by gzip (a file or a stream): b_i and L_i are positions in the decompressed file."
+                   "\n     If file_i is BGZF (bgzip), only its blocks containing the sequence are decompressed, in parallel, found with"
+                   "\n     the index file_i.gzi (format of bgzip -i), built at the first use of file_i."
+                   "\nOPTIONS"
+                   "\n     --engine=name"
+                   "\n        engine computing the distance, reported on stderr: auto (default: selected from the lengths, the"
+                   "\n        similarity of the sequences and the cpu features), auto-par (as auto, but a full matrix is computed by"
+                   "\n        all the threads), rec, iter, ca, co, co-par, simd, striped, wfa, banded."
+                   "\n     --threads=n"
+                   "\n        number of threads of the parallel engines and of the batch mode (default: number of processors)."
+                   "\n     --batch=jobfile"
+                   "\n        computes in one process the pairs listed in jobfile (- for stdin), one pair per line given by the"
+                   "\n        6 arguments file_1 b_1 L_1 file_2 b_2 L_2 or the 4 arguments file_1 region_1 file_2 region_2 (no"
+                   "\n        positional argument then); prints one result per line,"
+                   "\n        the CIGAR string being separated from the distance by a tab. Lines starting by # are ignored."
+                   "\n        The pairs are computed in parallel, the largest first; the large pairs with engine auto use auto-par."
+                   "\n     --all-vs-all"
+                   "\n        computes the distances between all the records of the given multi-FASTA files (the pairs in parallel);"
+                   "\n        writes the binary matrix (cf all_vs_all.h) in the file of --output=file, the matrix as TSV in the file"
+                   "\n        of --tsv=file and as PHYLIP in the file of --phylip=file (- for stdout); TSV on stdout by default."
+                   "\n        Not with --cigar or --threshold."
+                   "\n     --reference=fasta_file"
+                   "\n        computes the distance between the first record of fasta_file and every record of the given FASTA files"
+                   "\n        (- or none for stdin, eg a pipe), the reference being preprocessed once; prints one line name<tab>distance"
+                   "\n        per record, as soon as it is computed (the records in parallel). Not with --cigar or --threshold."
+                   "\n     --extend=fasta_file"
+                   "\n        follows the distance between the first record of fasta_file and a sequence that grows, read from file"
+                   "\n        (- or none for stdin, eg a pipe): after each read, the new bases are appended and only their columns of"
+                   "\n        the matrix are computed; prints one line bases<tab>distance per update (the comment lines are ignored)."
+                   "\n     --pack=store"
+                   "\n        converts the records of the given FASTA files into the packed store store: 2 bits per base, the runs of N"
+                   "\n        and U apart, the other characters removed (cf packed_store.h); store is then given as file_i, mapped"
+                   "\n        in memory and decoded directly, with 4 times less memory and no scan of the text. It may also be given"
+                   "\n        in a job file of --batch (positions in bases too) and as a FASTA file of the other modes, as a gzip file."
+                   "\n     --populate"
+                   "\n        reads the pages of the sequences when they are mapped (MAP_POPULATE) instead of at their first access."
+                   "\n        Only the pages of the two sequences are mapped, and they are read ahead (madvise) anyway."
+                   "\n     --window=w [--step=s]"
+                   "\n        prints the profile of the distances between seq_1 and seq_2 along windows of w bases every s bases"
+                   "\n        (default: w), the windows in parallel: one line start<tab>end<tab>distance per window, the positions"
+                   "\n        in bases from the beginning of the sequences (end excluded), after a comment line; eg for plotting."
+                   "\n        Not with --cigar or --threshold."
+                   "\n     --dotplot=matrix [--tile=T] [--band=b]"
+                   "\n        computes the distances between the tiles of T bases (default: 10000) of the records of two assemblies"
+                   "\n        (FASTA files or packed stores), for all the pairs or only in a band of b tiles on each side of the"
+                   "\n        diagonal; writes them in the binary file matrix (cf dot_plot.h) as soon as they are computed, the pairs"
+                   "\n        in parallel. A stopped job is resumed by running it again: the pairs already in matrix are skipped."
+                   "\n     --locate"
+                   "\n        places the whole seq_1 (eg a fragment) in the range of seq_2 where it fits best, the bases of seq_2"
+                   "\n        out of the range being free (semi-global alignment): prints the distance, then on a second line the"
+                   "\n        range start<tab>end in bases from the beginning of seq_2 (end excluded). Not with --cigar, --threshold,"
+                   "\n        --engine or --window."
+                   "\n     --local"
+                   "\n        finds the ranges of seq_1 and seq_2 whose alignment scores best (local alignment, Smith-Waterman: an"
+                   "\n        identity scores 1, a substitution and an insertion minus their costs): prints the score, then on a second"
+                   "\n        line start_1<tab>end_1<tab>start_2<tab>end_2 in bases from the beginning of the sequences (end excluded)."
+                   "\n        The matrix is computed in parallel by tiles if there are several threads. Not with --cigar, --threshold,"
+                   "\n        --engine, --window or --locate."
+                   "\n     --substitution=c --substitution-unknown=c --gap-open=c --gap-extend=c"
+                   "\n        costs of the distance (default: 1, 1, 0 and 2, the linear costs of the engines): a substitution of two"
+                   "\n        known bases, a substitution involving an unknown base, and a gap of k consecutive bases that costs"
+                   "\n        gap-open + k * gap-extend (affine gaps, Gotoh). With other costs than the defaults, the distance is"
+                   "\n        computed by the affine engine (vectorized) instead of the engine of --engine."
+                   "\n     --threshold=k (or -k k)"
+                   "\n        only decides if the distance is at most k: prints the distance if it is <= k, else prints >k"
+                   "\n        (the computation is abandoned as soon as the distance is known to exceed k)."
+                   "\n     --cigar"
+                   "\n        prints on a second line the CIGAR string of an optimal alignment of seq_1 with seq_2, computed in linear"
+                   "\n        memory: runs of '=' (same bases), 'X' (substitution), 'I' (base of seq_1 only), 'D' (base of seq_2 only)."
                    "\nEXIT STATUS"
                    "\n     The program exits 0 on success, and >0 if an error occurs."
                    "\nEXAMPLE"
@@ -119,84 +211,298 @@ void usage_and_spec(int argc, char *argv[]) // spécification du programme
  */
 int main(int argc, char *argv[])
 {
-   if (argc != 7)
+   long threshold = -1; // --threshold=k : only decides if the distance is <= k (-1: compute the distance)
+   int with_cigar = 0;  // --cigar : prints an optimal alignment
+   enum NW_Engine engine = NW_ENGINE_AUTO; // --engine=name : engine computing the distance
+   char *jobs = NULL;                       // --batch=jobfile : computes the pairs listed in jobfile
+   int all_vs_all = 0;                      // --all-vs-all : distance matrix of the records of FASTA files
+   struct AllVsAllOptions matrix = {NW_ENGINE_AUTO, NULL, NULL, NULL}; // output files of --all-vs-all
+   char *reference = NULL;                  // --reference=fasta_file : distances of the records of a stream to fasta_file
+   long window = 0, step = 0;               // --window=w --step=s : distances in windows of w bases every s bases
+   int locate = 0;                          // --locate : best range of seq_2 for seq_1 (semi-global alignment)
+   int local = 0;                           // --local : best ranges of seq_1 and seq_2 (local alignment)
+   struct NW_Costs costs = NW_COSTS_DEFAULT; // --substitution=c ... --gap-extend=c : costs of the affine engine
+   int custom_costs = 0;                    // if a cost is given
+   char *extend = NULL;                     // --extend=fasta_file : distance to fasta_file of a growing sequence
+   char *pack = NULL;                       // --pack=store : converts FASTA files into the packed store
+   char *dotplot = NULL;                    // --dotplot=matrix : distances between the tiles of two assemblies
+   long tile = 10000, band = -1;            // --tile=T --band=b : tiles of the dot plot, band of tiles (-1: all)
+   int advice = MAPPED_FILE_SEQUENTIAL | MAPPED_FILE_HUGE_PAGES; // how the sequences are mapped (--populate)
+   {
+      static struct option long_options[] = {
+          {"threshold", required_argument, NULL, 'k'},
+          {"cigar", no_argument, NULL, 'c'},
+          {"engine", required_argument, NULL, 'e'},
+          {"batch", required_argument, NULL, 'b'},
+          {"threads", required_argument, NULL, 't'},
+          {"all-vs-all", no_argument, NULL, 'a'},
+          {"output", required_argument, NULL, 'o'},
+          {"tsv", required_argument, NULL, 'T'},
+          {"phylip", required_argument, NULL, 'P'},
+          {"reference", required_argument, NULL, 'R'},
+          {"extend", required_argument, NULL, 'x'},
+          {"window", required_argument, NULL, 'w'},
+          {"step", required_argument, NULL, 's'},
+          {"pack", required_argument, NULL, 'p'},
+          {"populate", no_argument, NULL, 'M'},
+          {"locate", no_argument, NULL, 'L'},
+          {"local", no_argument, NULL, 'S'},
+          {"substitution", required_argument, NULL, 'u'},
+          {"substitution-unknown", required_argument, NULL, 'U'},
+          {"gap-open", required_argument, NULL, 'g'},
+          {"gap-extend", required_argument, NULL, 'G'},
+          {"dotplot", required_argument, NULL, 'd'},
+          {"tile", required_argument, NULL, 'l'},
+          {"band", required_argument, NULL, 'n'},
+          {NULL, 0, NULL, 0}};
+      int opt;
+      while ((opt = getopt_long(argc, argv, "k:", long_options, NULL)) != -1)
+      {
+         switch (opt)
+         {
+         case 'k':
+            if (sscanf(optarg, "%ld", &threshold) != 1 || threshold < 0)
+               errx(1, "--threshold: expected a non negative distance, got %s", optarg);
+            break;
+         case 'c':
+            with_cigar = 1;
+            break;
+         case 'e':
+            if (!NW_EngineFromName(optarg, &engine))
+               errx(1, "--engine: unknown engine %s", optarg);
+            break;
+         case 'b':
+            jobs = optarg;
+            break;
+         case 'a':
+            all_vs_all = 1;
+            break;
+         case 'o':
+            matrix.binary = optarg;
+            break;
+         case 'T':
+            matrix.tsv = optarg;
+            break;
+         case 'P':
+            matrix.phylip = optarg;
+            break;
+         case 'R':
+            reference = optarg;
+            break;
+         case 'x':
+            extend = optarg;
+            break;
+         case 'w':
+            if (sscanf(optarg, "%ld", &window) != 1 || window <= 0)
+               errx(1, "--window: expected a positive number of bases, got %s", optarg);
+            break;
+         case 's':
+            if (sscanf(optarg, "%ld", &step) != 1 || step <= 0)
+               errx(1, "--step: expected a positive number of bases, got %s", optarg);
+            break;
+         case 'p':
+            pack = optarg;
+            break;
+         case 'M':
+            advice |= MAPPED_FILE_POPULATE;
+            break;
+         case 'L':
+            locate = 1;
+            break;
+         case 'S':
+            local = 1;
+            break;
+         case 'u':
+         case 'U':
+         case 'g':
+         case 'G':
+         {
+            long *cost = (opt == 'u') ? &costs.substitution : (opt == 'U') ? &costs.substitution_unknown
+                                                         : (opt == 'g') ? &costs.gap_open : &costs.gap_extend;
+            if (sscanf(optarg, "%ld", cost) != 1 || *cost < 0)
+               errx(1, "--%s: expected a non negative cost, got %s",
+                    (opt == 'u') ? "substitution" : (opt == 'U') ? "substitution-unknown"
+                                                 : (opt == 'g') ? "gap-open" : "gap-extend", optarg);
+            custom_costs = 1;
+            break;
+         }
+         case 'd':
+            dotplot = optarg;
+            break;
+         case 'l':
+            if (sscanf(optarg, "%ld", &tile) != 1 || tile <= 0)
+               errx(1, "--tile: expected a positive number of bases, got %s", optarg);
+            break;
+         case 'n':
+            if (sscanf(optarg, "%ld", &band) != 1 || band < 0)
+               errx(1, "--band: expected a non negative number of tiles, got %s", optarg);
+            break;
+         case 't':
+         {
+            int nthreads;
+            if (sscanf(optarg, "%d", &nthreads) != 1 || nthreads <= 0)
+               errx(1, "--threads: expected a positive number of threads, got %s", optarg);
+            ThreadPool_SetDefaultSize(nthreads);
+            break;
+         }
+         default:
+            usage_and_spec(argc, argv);
+            exit(EXIT_FAILURE);
+         }
+      }
+      /* Remaining arguments are the 6 positional ones: argv[1..6] */
+      argv[optind - 1] = argv[0];
+      argc -= optind - 1;
+      argv += optind - 1;
+   }
+   if (custom_costs && (with_cigar || threshold >= 0 || window > 0 || locate || local || jobs != NULL || all_vs_all ||
+                        reference != NULL || extend != NULL || dotplot != NULL))
+      errx(1, "the costs only apply to the distance between two sequences");
+   if (window > 0 && (with_cigar || threshold >= 0 || jobs != NULL || all_vs_all || reference != NULL || extend != NULL ||
+                      dotplot != NULL))
+      errx(1, "--window only applies to the distance between two sequences, without --cigar or --threshold");
+   if (locate && (with_cigar || threshold >= 0 || engine != NW_ENGINE_AUTO || window > 0 || jobs != NULL || all_vs_all ||
+                  reference != NULL || extend != NULL || dotplot != NULL))
+      errx(1, "--locate only applies to the distance between two sequences, without --cigar, --threshold, --engine "
+              "or --window");
+   if (local && (with_cigar || threshold >= 0 || engine != NW_ENGINE_AUTO || window > 0 || locate || jobs != NULL ||
+                 all_vs_all || reference != NULL || extend != NULL || dotplot != NULL))
+      errx(1, "--local only applies to the distance between two sequences, without --cigar, --threshold, --engine, "
+              "--window or --locate");
+   if (all_vs_all && (with_cigar || threshold >= 0))
+      errx(1, "--all-vs-all only computes distances, without --cigar or --threshold");
+   if (!all_vs_all && (matrix.binary != NULL || matrix.tsv != NULL || matrix.phylip != NULL))
+      errx(1, "--output, --tsv and --phylip are the matrix files of --all-vs-all");
+   if (reference != NULL && (with_cigar || threshold >= 0))
+      errx(1, "--reference only computes distances, without --cigar or --threshold");
+   if (jobs != NULL && argc > 1)
+      errx(1, "--batch: the pairs are given by the job file, not by %d arguments", argc - 1);
+   if (extend != NULL && argc > 2)
+      errx(1, "--extend: expected at most one file for the growing sequence, got %d arguments", argc - 1);
+   if (all_vs_all && argc >= 2)
+   {
+      matrix.engine = engine;
+      AllVsAll_Run(argv + 1, argc - 1, &matrix);
+      return 0;
+   }
+   if (pack != NULL && argc >= 2)
+   {
+      PackedStore_Write(argv + 1, argc - 1, pack);
+      return 0;
+   }
+   if (dotplot != NULL && argc == 3)
+   {
+      DotPlot_Run(argv[1], argv[2], tile, band, engine, dotplot);
+      return 0;
+   }
+   if (reference != NULL)
+   {
+      OneVsMany_Run(reference, argv + 1, argc - 1, stdout, engine);
+      return 0;
+   }
+   if (extend != NULL)
+   {
+      OneVsMany_Extend(extend, (argc == 2) ? argv[1] : NULL, stdout);
+      return 0;
+   }
+   if (jobs != NULL)
+   {
+      struct BatchOptions options = {engine, threshold, with_cigar};
+      FILE *in = (strcmp(jobs, "-") == 0) ? stdin : fopen(jobs, "r");
+      if (in == NULL)
+         err(1, "open %s", jobs);
+      Batch_Run(in, jobs, stdout, &options);
+      if (in != stdin)
+         fclose(in);
+      return 0;
+   }
+   int by_region = (argc == 5 && FastaIndex_IsRegion(argv[2]) && FastaIndex_IsRegion(argv[4])); // file record:start-end
+   if (argc != 7 && !by_region)
    {
       usage_and_spec(argc, argv);
       exit(EXIT_FAILURE);
    }
 
-   int fd[2];           // The 2 fles descriptor correspoding for file1 and file2
-   char *mmap_fd[2];    // adress in virtual memory of file fd[i]
-   long mmap_length[2]; // length of the mapping in virtual memory of file fd[i]
-   char *seq[2];        // corresponding genetic sequence to file[i]*/
-   long length[2];      // the length of corresponding genetic sequence seq[i] */
+   struct MappedFile file[2]; // file_1 and file_2 mapped in virtual memory
+   char *seq[2];              // corresponding genetic sequence to file[i]*/
+   long length[2];            // the length of corresponding genetic sequence seq[i] */
+   struct EncodedSequence codes[2] = {ENCODED_SEQUENCE_EMPTY, ENCODED_SEQUENCE_EMPTY}; // bases of seq[i], decoded from a packed store
+   int packed[2] = {0, 0};    // if file[i] is a packed store (cf packed_store.h)
 
-   for (int i = 0; i < 2; ++i, argv += 3) // defines content and length of seq[i] for i=0..1
+   for (int i = 0; i < 2; ++i, argv += (by_region ? 2 : 3)) // defines content and length of seq[i] for i=0..1
    {
-      fd[i] = open(argv[1], O_RDONLY);
-      if (fd[i] == -1)
-         err(1, "open");
-      struct stat s;
-      if (fstat(fd[i], &s) == -1)
-         err(1, "fstat");
-      mmap_fd[i] = (char *)mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd[i], 0);
-      if (mmap_fd[i] == MAP_FAILED)
-         err(1, "mmap");
-      mmap_length[i] = (long)s.st_size;
-
-      { // Assign seq[i] to the begining of the sequence, excluding comment lines starting by '<'
-         long debut;
+      long debut = 0, longueur = 0;
+      if (!by_region)
+      {
          sscanf(argv[2], "%ld", &debut);
-         seq[i] = mmap_fd[i] + debut; // beginning of the sequence
-         long n_exceed = mmap_length[i] - debut;
-         if (n_exceed < 0)
-         {
-            fprintf(stderr, "Error: given sequence beginning %ld exceeds end of file of %ld bytes.\n",
-                    debut, n_exceed);
-            exit(1);
-         }
-         if (*seq[i] == '>') /* Skip and print the first line starting by '<' */
-         {
-            char *endofline = strchr(seq[i], '\n');
-            fprintf(stderr, "Sequence comment in preamble: ");
-            for (char *c = seq[i]; c <= endofline; ++c)
-               fprintf(stderr, "%c", *c);
-            if (*endofline == '\n')
-               seq[i] = endofline + 1; // first character of next line
-         }
+         sscanf(argv[3], "%ld", &longueur);
       }
-
-      { // assign length[i] to the given length for seq[i]
-         sscanf(argv[3], "%ld", &length[i]);
-         long n_exceed = mmap_fd[i] + mmap_length[i] - 1 - (seq[i] + length[i]);
-         if (n_exceed < 0)
-         {
-            fprintf(stderr, "Warning: given sequence length %ld exceeds end of file of %ld bytes; "
-                            "sequence length is truncated to %ld.\n",
-                    length[i], -n_exceed, length[i] + n_exceed);
-            length[i] = length[i] + n_exceed;
-         }
+      if (MappedFile_IsStream(argv[1]))
+      { /* read while skipping the first debut characters: no index, no packed store */
+         if (by_region)
+            errx(1, "%s: a region needs an indexed file, not a stream", argv[1]);
+         if (i == 1 && strcmp(argv[1], "-") == 0 && strcmp(file[0].path, "-") == 0)
+            errx(1, "the standard input can only be read once");
+         MappedFile_OpenStream(argv[1], debut, longueur, &file[i]);
+         MappedFile_Select(&file[i], debut, longueur, 1, &seq[i], &length[i]);
+         continue;
       }
-
-      { /* Print on stderr either the full sequence is length[i]<40 or the first twenty and last twenty characters of the sequence */
-         if (length[i] <= 40)
-         {
-            for (char *c = seq[i]; (c < seq[i] + length[i]); ++c)
-               fprintf(stderr, "%c", *c);
-         }
+      if (GzipFile_IsGzipFile(argv[1]))
+      { /* positions in the decompressed file; only the blocks of the sequence are decompressed if it is BGZF */
+         if (by_region)
+            errx(1, "%s: a region needs an uncompressed indexed file", argv[1]);
+         GzipFile_OpenSelection(argv[1], debut, longueur, &file[i]);
+         MappedFile_Select(&file[i], debut, longueur, 1, &seq[i], &length[i]);
+         continue;
+      }
+      if (PackedStore_IsPackedFile(argv[1]))
+      { /* positions in bases, of the first record if there is no region; the store is mapped whole */
+         struct PackedStore store;
+         const struct PackedStoreRecord *record = NULL;
+         MappedFile_Open(argv[1], &file[i]);
+         PackedStore_Attach(&file[i], &store);
+         if (by_region)
+            PackedStore_Resolve(&store, argv[2], &record, &debut, &longueur);
          else
+            PackedStore_Select(&store, debut, longueur, &record, &longueur);
+         PackedStore_Decode(&store, record, debut, longueur, &codes[i]);
+         packed[i] = 1;
+         seq[i] = NULL;
+         length[i] = longueur;
+         continue;
+      }
+      // only the pages of the sequence are mapped, read ahead at once
+      MappedFile_OpenSelection(argv[1], debut, longueur, advice, &file[i]);
+      if (by_region)
+      { /* the index gives the range, then mapped */
+         struct FastaIndex index;
+         FastaIndex_Load(&file[i], &index);
+         FastaIndex_Resolve(&index, argv[2], &debut, &longueur);
+         FastaIndex_Free(&index);
+         MappedFile_Close(&file[i]);
+         MappedFile_OpenSelection(argv[1], debut, longueur, advice, &file[i]);
+      }
+      MappedFile_Select(&file[i], debut, longueur, 1, &seq[i], &length[i]);
+   }
+   // a packed sequence is given to the engines as its codes when the engine is auto (as the other sequence, encoded),
+   // else as its characters
+   int encoded = (packed[0] || packed[1]) && !with_cigar && threshold < 0 && !custom_costs && !locate && !local &&
+                 (engine == NW_ENGINE_AUTO || engine == NW_ENGINE_AUTO_PAR);
+   if (window > 0) // the windows are cut in the codes of the bases, whatever the engine
+      encoded = 1;
+   for (int i = 0; i < 2; ++i)
+   {
+      if (encoded && !packed[i])
+         EncodeSequence(seq[i], length[i], &codes[i]);
+      else if (!encoded && packed[i])
+      {
+         seq[i] = (char *)malloc(length[i] + 1);
+         if (seq[i] == NULL)
          {
-            {
-               for (char *c = seq[i]; (c < seq[i] + 20); ++c)
-                  fprintf(stderr, "%c", *c);
-            }
-            fprintf(stderr, "...");
-            {
-               for (char *c = seq[i] + length[i] - 20; (c < seq[i] + length[i]); ++c)
-                  fprintf(stderr, "%c", *c);
-            }
+            perror("main: malloc of the sequence");
+            exit(EXIT_FAILURE);
          }
-         fprintf(stderr, "\n");
+         DecodeSequence(&codes[i], seq[i]);
       }
    }
 
@@ -204,25 +510,62 @@ int main(int argc, char *argv[])
    struct myperf p;
    perfstart(&p);
 #endif
-   // long res = EditDistance_NW_Rec(seq[0], length[0], seq[1], length[1]);
-   // long res = EditDistance_NW_Iter(seq[0], length[0], seq[1], length[1]);
-   // long res = EditDistance_NW_Iter_CA(seq[0], length[0], seq[1], length[1]);
-   long res = EditDistance_NW_Iter_CO(seq[0], length[0], seq[1], length[1]);
+   char *cigar = NULL;
+   long res = 0;
+   struct NW_Placement placement; // range of seq_2 of --locate
+   struct NW_LocalAlignment alignment; // ranges of --local
+   if (window > 0)
+      WindowProfile_Run(&codes[0], &codes[1], window, (step > 0) ? step : window, engine, stdout);
+   else if (locate)
+      res = EditDistance_NW_SemiGlobal(seq[0], length[0], seq[1], length[1], &placement);
+   else if (local)
+      res = EditDistance_NW_Local_Par(seq[0], length[0], seq[1], length[1], &alignment);
+   else if (custom_costs)
+      res = EditDistance_NW_Affine(seq[0], length[0], seq[1], length[1], &costs);
+   else if (with_cigar)
+      res = EditDistance_NW_Align(seq[0], length[0], seq[1], length[1], &cigar);
+   else if (threshold >= 0)
+      res = EditDistance_NW_Threshold(seq[0], length[0], seq[1], length[1], threshold);
+   else
+   {
+      enum NW_Engine used;
+      if (encoded)
+         res = EditDistance_NW_Encoded(NULL, &codes[0], &codes[1], NULL, engine, &used);
+      else
+         res = EditDistance_NW_Dispatch(NULL, seq[0], length[0], seq[1], length[1], engine, &used);
+      unsigned features = NW_CpuFeatures();
+      fprintf(stderr, "Engine: %s (cpu:%s%s%s)\n", NW_EngineName(used),
+              (features & NW_CPU_SSE41) ? " sse4.1" : "", (features & NW_CPU_AVX2) ? " avx2" : "",
+              (features & NW_CPU_AVX512) ? " avx512" : "");
+   }
 #ifdef __PERF_MESURE__
    perfstop_and_display(stderr, &p);
    // par exemple p.cumul_energy donne le nombre de kWh consommés sur le processeur entre l'appel à perf_start et celui à perfstop_and_display
 #endif
 
+   for (int i = 0; i < 2; ++i)
    {
-      for (int i = 0; i < 2; ++i)
-      {
-         if (munmap(mmap_fd[i], (off_t)mmap_length[i]) != 0)
-            err(1, "munmap");
-         if (close(fd[i]) != 0)
-            err(1, "close");
-      }
+      if (packed[i])
+         free(seq[i]);
+      EncodedSequence_Free(&codes[i]);
+      MappedFile_Close(&file[i]);
    }
 
-   printf("%ld\n", res); // print the distance on stdout
+   if (window > 0)
+      return 0; // the table is printed
+   if (res == NW_DISTANCE_ABOVE_THRESHOLD)
+      printf(">%ld\n", threshold); // the distance is greater than the threshold
+   else
+      printf("%ld\n", res); // print the distance on stdout
+   if (locate)
+      printf("%lu\t%lu\n", (unsigned long)placement.start, (unsigned long)placement.end);
+   if (local)
+      printf("%lu\t%lu\t%lu\t%lu\n", (unsigned long)alignment.startA, (unsigned long)alignment.endA,
+             (unsigned long)alignment.startB, (unsigned long)alignment.endB);
+   if (cigar != NULL)
+   {
+      printf("%s\n", cigar);
+      free(cigar);
+   }
    return 0;
 }
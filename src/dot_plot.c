@@ -0,0 +1,326 @@
+/**
+ * \file dot_plot.c
+ * \brief implementation of the dot-plot mode
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see dot_plot.h
+ */
+
+#include "dot_plot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <fcntl.h>    /* for open */
+#include <unistd.h>   /* for pread and pwrite */
+#include <sys/stat.h>
+#include "characters_to_base.h" /* for isBase */
+#include "mapped_file.h"
+#include "fasta.h"
+#include "packed_store.h"
+#include "thread_pool.h"
+
+/** \def DOT_PLOT_PENDING_PER_THREAD
+ * \brief number of pairs computed at a time, per thread: bounds the memory (the tiles of the pairs) and the work lost
+ * when the job is stopped
+ */
+#define DOT_PLOT_PENDING_PER_THREAD 4
+
+/** \struct DotPlotTile
+ * \brief a tile of an assembly: characters of a FASTA file, or bases of a record of a packed store
+ */
+struct DotPlotTile
+{
+   const char *chars;                       /*!< first character of the tile (FASTA file) */
+   long nchars;                             /*!< number of characters of the tile, '\n' included (FASTA file) */
+   const struct PackedStoreRecord *record;  /*!< record of the tile (packed store) */
+   long start;                              /*!< first base of the tile in its record (packed store) */
+   long length;                             /*!< number of bases of the tile */
+};
+
+/** \struct DotPlotAssembly
+ * \brief an assembly mapped in memory, and its tiles
+ */
+struct DotPlotAssembly
+{
+   struct MappedFile file;     /*!< the FASTA file or packed store */
+   int packed;                 /*!< if file is a packed store */
+   struct PackedStore store;   /*!< the packed store, if packed */
+   struct DotPlotTile *tiles;  /*!< tiles[0..count-1] */
+   long count;                 /*!< number of tiles */
+   long capacity;              /*!< allocated number of elements of tiles */
+   uint64_t length;            /*!< number of bases */
+};
+
+/** \struct DotPlotPair
+ * \brief task computing the distance of a pair of tiles (cell k of row i)
+ */
+struct DotPlotPair
+{
+   const struct DotPlotAssembly *A; /*!< the first assembly */
+   const struct DotPlotAssembly *B; /*!< the second assembly */
+   enum NW_Engine engine;           /*!< engine computing the distance */
+   long i;                          /*!< tile of A */
+   long j;                          /*!< tile of B */
+   long k;                          /*!< cell of the pair in row i */
+   int64_t distance;                /*!< the result */
+};
+
+int64_t DotPlot_FirstColumn(const struct DotPlotHeader *header, uint64_t i)
+{
+   if (header->band < 0)
+      return 0;
+   int64_t diagonal = (header->rows == 0) ? 0 : (int64_t)((i * header->columns + header->rows / 2) / header->rows);
+   return diagonal - header->band;
+}
+
+/*
+ * \brief appends a tile to a
+ */
+static void _DotPlot_AddTile(struct DotPlotAssembly *a, const struct DotPlotTile *tile)
+{
+   if (a->count == a->capacity)
+   {
+      a->capacity = (a->capacity == 0) ? 1024 : 2 * a->capacity;
+      a->tiles = (struct DotPlotTile *)realloc(a->tiles, a->capacity * sizeof(struct DotPlotTile));
+      if (a->tiles == NULL)
+      {
+         perror("_DotPlot_AddTile: realloc of tiles");
+         exit(EXIT_FAILURE);
+      }
+   }
+   a->tiles[a->count++] = *tile;
+   a->length += (uint64_t)tile->length;
+}
+
+/*
+ * \brief opens the assembly path in a (cf MappedFile_OpenInput) and cuts its records into tiles of tile bases
+ */
+static void _DotPlot_Load(const char *path, long tile, struct DotPlotAssembly *a)
+{
+   a->tiles = NULL;
+   a->count = 0;
+   a->capacity = 0;
+   a->length = 0;
+   MappedFile_OpenInput(path, &a->file);
+   a->packed = PackedStore_IsPacked(&a->file);
+   if (a->packed)
+   { /* the tiles are ranges of bases */
+      PackedStore_Attach(&a->file, &a->store);
+      for (uint64_t r = 0; r < a->store.header->nrecords; ++r)
+      {
+         const struct PackedStoreRecord *record = &a->store.records[r];
+         for (long start = 0; start < (long)record->length; start += tile)
+         {
+            long rest = (long)record->length - start;
+            struct DotPlotTile t = {NULL, 0, record, start, (rest < tile) ? rest : tile};
+            _DotPlot_AddTile(a, &t);
+         }
+      }
+      return;
+   }
+   /* the tiles are ranges of characters, cut after tile bases */
+   struct FastaRecords records = FASTA_RECORDS_INIT;
+   _init_base_match();
+   Fasta_Parse(&a->file, &records);
+   for (size_t r = 0; r < records.count; ++r)
+   {
+      const char *s = records.records[r].seq, *end = s + records.records[r].length;
+      struct DotPlotTile t = {s, 0, NULL, 0, 0};
+      for (; s < end; ++s)
+      {
+         if (!isBase((unsigned char)*s))
+            continue;
+         if (t.length == tile)
+         {
+            t.nchars = s - t.chars;
+            _DotPlot_AddTile(a, &t);
+            t.chars = s;
+            t.length = 0;
+         }
+         ++t.length;
+      }
+      if (t.length > 0)
+      {
+         t.nchars = end - t.chars;
+         _DotPlot_AddTile(a, &t);
+      }
+   }
+   FastaRecords_Free(&records);
+}
+
+static void _DotPlot_Free(struct DotPlotAssembly *a)
+{
+   free(a->tiles);
+   MappedFile_Close(&a->file);
+}
+
+/*
+ * \brief encodes tile of a in seq
+ */
+static void _DotPlot_Encode(const struct DotPlotAssembly *a, const struct DotPlotTile *tile, struct EncodedSequence *seq)
+{
+   if (a->packed)
+      PackedStore_Decode(&a->store, tile->record, tile->start, tile->length, seq);
+   else
+      ReencodeSequence(tile->chars, tile->nchars, seq);
+}
+
+static void _DotPlot_RunPair(void *arg)
+{
+   struct DotPlotPair *pair = (struct DotPlotPair *)arg;
+   struct EncodedSequence a = ENCODED_SEQUENCE_EMPTY, b = ENCODED_SEQUENCE_EMPTY;
+   _DotPlot_Encode(pair->A, &pair->A->tiles[pair->i], &a);
+   _DotPlot_Encode(pair->B, &pair->B->tiles[pair->j], &b);
+   if (pair->engine == NW_ENGINE_AUTO || pair->engine == NW_ENGINE_AUTO_PAR) /* the pairs are already in parallel */
+      pair->distance = EditDistance_NW_Encoded(NULL, &a, &b, NULL, NW_ENGINE_AUTO, NULL);
+   else
+   {
+      char *charsA = (char *)malloc(a.length + 1), *charsB = (char *)malloc(b.length + 1);
+      if (charsA == NULL || charsB == NULL)
+      {
+         perror("_DotPlot_RunPair: malloc of the tiles");
+         exit(EXIT_FAILURE);
+      }
+      DecodeSequence(&a, charsA);
+      DecodeSequence(&b, charsB);
+      pair->distance = EditDistance_NW_Dispatch(NULL, charsA, a.length, charsB, b.length, pair->engine, NULL);
+      free(charsA);
+      free(charsB);
+   }
+   EncodedSequence_Free(&a);
+   EncodedSequence_Free(&b);
+}
+
+/*
+ * \brief creates the matrix file path of header, all its cells pending (written in a temporary file renamed at the
+ * end, so that an interrupted creation leaves no partial matrix)
+ */
+static void _DotPlot_Create(const char *path, const struct DotPlotHeader *header)
+{
+   char *tmp_path = (char *)malloc(strlen(path) + 8);
+   int64_t *row = (int64_t *)malloc((header->width + 1) * sizeof(int64_t));
+   if (tmp_path == NULL || row == NULL)
+   {
+      perror("_DotPlot_Create: malloc");
+      exit(EXIT_FAILURE);
+   }
+   sprintf(tmp_path, "%s.XXXXXX", path);
+   int fd = mkstemp(tmp_path);
+   FILE *out = (fd != -1) ? fdopen(fd, "w") : NULL;
+   if (out == NULL)
+      err(1, "create %s", path);
+   int ok = fwrite(header, sizeof(*header), 1, out) == 1;
+   for (uint64_t i = 0; ok && i < header->rows; ++i)
+   {
+      int64_t first = DotPlot_FirstColumn(header, i);
+      for (uint64_t k = 0; k < header->width; ++k)
+         row[k] = (first + (int64_t)k < 0 || first + (int64_t)k >= (int64_t)header->columns) ? DOT_PLOT_OUTSIDE
+                                                                                           : DOT_PLOT_PENDING;
+      ok = fwrite(row, sizeof(int64_t), header->width, out) == header->width;
+   }
+   if (fclose(out) != 0)
+      ok = 0;
+   if (!ok || chmod(tmp_path, 0644) != 0 || rename(tmp_path, path) != 0)
+   {
+      remove(tmp_path);
+      err(1, "write %s", path);
+   }
+   free(row);
+   free(tmp_path);
+}
+
+/*
+ * \brief computes the pairs[0..n-1] in parallel and writes their distances in the matrix file fd
+ */
+static void _DotPlot_RunBatch(struct DotPlotPair *pairs, long n, const struct DotPlotHeader *header, int fd,
+                              const char *path)
+{
+   struct ThreadPool *pool = ThreadPool_Default();
+   struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+   for (long p = 0; p < n; ++p)
+      ThreadPool_Submit(pool, &group, _DotPlot_RunPair, &pairs[p]);
+   ThreadPool_Wait(pool, &group);
+   for (long p = 0; p < n; ++p)
+   {
+      off_t position = (off_t)sizeof(*header) + ((off_t)pairs[p].i * header->width + pairs[p].k) * sizeof(int64_t);
+      if (pwrite(fd, &pairs[p].distance, sizeof(int64_t), position) != sizeof(int64_t))
+         err(1, "write %s", path);
+   }
+}
+
+void DotPlot_Run(const char *pathA, const char *pathB, long tile, long band, enum NW_Engine engine, const char *matrix)
+{
+   struct DotPlotAssembly A, B;
+   _DotPlot_Load(pathA, tile, &A);
+   _DotPlot_Load(pathB, tile, &B);
+   struct DotPlotHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, DOT_PLOT_MAGIC, 4);
+   header.version = 1;
+   header.tile = (uint64_t)tile;
+   header.rows = (uint64_t)A.count;
+   header.columns = (uint64_t)B.count;
+   header.band = (band < 0) ? -1 : band;
+   header.width = (band < 0) ? header.columns : 2 * (uint64_t)band + 1;
+   header.lengthA = A.length;
+   header.lengthB = B.length;
+
+   struct stat s;
+   if (stat(matrix, &s) != 0)
+      _DotPlot_Create(matrix, &header);
+   int fd = open(matrix, O_RDWR);
+   if (fd == -1)
+      err(1, "open %s", matrix);
+   { /* a matrix file already there is resumed if it is the same job */
+      struct DotPlotHeader existing;
+      off_t expected = (off_t)sizeof(header) + (off_t)(header.rows * header.width * sizeof(int64_t));
+      if (pread(fd, &existing, sizeof(existing), 0) != sizeof(existing) || memcmp(&existing, &header, sizeof(header)) != 0 ||
+          fstat(fd, &s) != 0 || s.st_size != expected)
+         errx(1, "%s: matrix of other assemblies or parameters (remove it to start again)", matrix);
+   }
+
+   long max_pending = DOT_PLOT_PENDING_PER_THREAD * ThreadPool_Size(ThreadPool_Default());
+   struct DotPlotPair *pairs = (struct DotPlotPair *)malloc(max_pending * sizeof(struct DotPlotPair));
+   int64_t *row = (int64_t *)malloc((header.width + 1) * sizeof(int64_t));
+   if (pairs == NULL || row == NULL)
+   {
+      perror("DotPlot_Run: malloc of the pairs");
+      exit(EXIT_FAILURE);
+   }
+   long npairs = 0, computed = 0, done = 0;
+   for (uint64_t i = 0; i < header.rows; ++i)
+   {
+      off_t position = (off_t)sizeof(header) + (off_t)(i * header.width * sizeof(int64_t));
+      if (pread(fd, row, header.width * sizeof(int64_t), position) != (ssize_t)(header.width * sizeof(int64_t)))
+         err(1, "read %s", matrix);
+      int64_t first = DotPlot_FirstColumn(&header, i);
+      for (uint64_t k = 0; k < header.width; ++k)
+      {
+         if (row[k] != DOT_PLOT_PENDING)
+         {
+            done += (row[k] >= 0);
+            continue;
+         }
+         struct DotPlotPair pair = {&A, &B, engine, (long)i, (long)(first + (int64_t)k), (long)k, 0};
+         pairs[npairs++] = pair;
+         if (npairs == max_pending)
+         {
+            _DotPlot_RunBatch(pairs, npairs, &header, fd, matrix);
+            computed += npairs;
+            npairs = 0;
+         }
+      }
+   }
+   _DotPlot_RunBatch(pairs, npairs, &header, fd, matrix);
+   computed += npairs;
+   if (close(fd) != 0)
+      err(1, "close %s", matrix);
+   fprintf(stderr, "Dot plot: %lu x %lu tiles of %ld bases, %ld pairs computed, %ld already in %s\n",
+           (unsigned long)header.rows, (unsigned long)header.columns, tile, computed, done, matrix);
+   free(row);
+   free(pairs);
+   _DotPlot_Free(&A);
+   _DotPlot_Free(&B);
+}
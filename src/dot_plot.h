@@ -0,0 +1,75 @@
+/**
+ * \file dot_plot.h
+ * \brief dot-plot mode: matrix of the distances between the tiles of two whole assemblies
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Each record of an assembly (a FASTA file, possibly gzip compressed, or a packed store, cf packed_store.h) is cut into tiles of tile bases
+ * (the last tile of a record may be shorter); the tiles of the assembly are numbered in the order of its records.
+ * The distance between tile i of the first assembly and tile j of the second one is computed for every pair, or only
+ * in a band of tiles around the diagonal from (0, 0) to (rows, columns). The pairs are computed by the default pool
+ * of threads, a bounded number at a time (only their tiles are encoded), and written in the matrix file as soon as
+ * their batch is done: a job that is stopped is resumed by running it again, the pairs already in the file being
+ * skipped.
+ *
+ * Binary format of the matrix file (integers in the byte order of the machine):
+ *    struct DotPlotHeader;
+ *    rows rows of width distances (int64_t): cell k of row i is the distance between tile i of the first assembly and
+ *    tile j = DotPlot_FirstColumn(header, i) + k of the second one; DOT_PLOT_OUTSIDE if j is not a tile (out of
+ *    0..columns-1), DOT_PLOT_PENDING if it is not computed yet.
+ */
+
+#ifndef __DOT_PLOT_H__
+#define __DOT_PLOT_H__
+
+#include <stdint.h>
+#include "Needleman-Wunsch-recmemo.h"
+
+/** \def DOT_PLOT_MAGIC
+ * \brief first 4 bytes of a matrix file
+ */
+#define DOT_PLOT_MAGIC "NWDP"
+
+/** \def DOT_PLOT_OUTSIDE
+ * \brief value of a cell of the band that is out of the matrix
+ */
+#define DOT_PLOT_OUTSIDE -1
+
+/** \def DOT_PLOT_PENDING
+ * \brief value of a cell that is not computed yet
+ */
+#define DOT_PLOT_PENDING -2
+
+/**
+ * \struct DotPlotHeader
+ * \brief header of a matrix file
+ */
+struct DotPlotHeader
+{
+   char magic[4];    /*!< DOT_PLOT_MAGIC */
+   uint32_t version; /*!< 1 */
+   uint64_t tile;    /*!< number of bases of a tile */
+   uint64_t rows;    /*!< number of tiles of the first assembly */
+   uint64_t columns; /*!< number of tiles of the second assembly */
+   int64_t band;     /*!< half width of the band, in tiles (-1: all the pairs) */
+   uint64_t width;   /*!< number of cells of a row: 2*band+1, or columns */
+   uint64_t lengthA; /*!< number of bases of the first assembly */
+   uint64_t lengthB; /*!< number of bases of the second assembly */
+};
+
+/**
+ * \fn int64_t DotPlot_FirstColumn(const struct DotPlotHeader *header, uint64_t i);
+ * \brief returns the tile of the second assembly of the first cell of row i (possibly negative): the diagonal tile
+ * i * columns / rows minus the band, or 0 without a band
+ */
+int64_t DotPlot_FirstColumn(const struct DotPlotHeader *header, uint64_t i);
+
+/**
+ * \fn void DotPlot_Run(const char *pathA, const char *pathB, long tile, long band, enum NW_Engine engine, const char *matrix);
+ * \brief computes (or resumes) in the file matrix the distances with engine between the tiles of tile bases of the
+ * assemblies pathA and pathB, in the band of half width band (all the pairs if band < 0). Exits with a message on
+ * error, or if matrix exists with other parameters.
+ */
+void DotPlot_Run(const char *pathA, const char *pathB, long tile, long band, enum NW_Engine engine, const char *matrix);
+
+#endif /* __DOT_PLOT_H__ */
@@ -0,0 +1,163 @@
+/**
+ * \file fasta.c
+ * \brief implementation of the parsing of the records of a FASTA file
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see fasta.h
+ */
+
+#include "fasta.h"
+#include <stdio.h>
+#include <string.h> /* for memchr */
+#include <ctype.h>  /* for isspace */
+#include "packed_store.h"
+#include "thread_pool.h"
+
+void Fasta_Open(const char *path, struct MappedFile *f)
+{
+   MappedFile_OpenInput(path, f);
+   if (PackedStore_IsPacked(f))
+   {
+      struct PackedStore store;
+      struct MappedFile text;
+      PackedStore_Attach(f, &store);
+      PackedStore_DecodeFasta(&store, &text);
+      MappedFile_Close(f);
+      *f = text;
+   }
+}
+
+static void _Fasta_Append(struct FastaRecords *records, const char *name, int name_length, char *seq, long length)
+{
+   if (records->count == records->capacity)
+   {
+      records->capacity = (records->capacity == 0) ? 64 : 2 * records->capacity;
+      records->records = (struct FastaRecord *)realloc(records->records, records->capacity * sizeof(struct FastaRecord));
+      if (records->records == NULL)
+      {
+         perror("Fasta_Parse: realloc of records");
+         exit(EXIT_FAILURE);
+      }
+   }
+   struct FastaRecord *r = &records->records[records->count++];
+   r->name = name;
+   r->name_length = name_length;
+   r->seq = seq;
+   r->length = length;
+}
+
+/** \def FASTA_SCAN_CHUNK
+ * \brief number of bytes of the file scanned for headers by a task
+ */
+#define FASTA_SCAN_CHUNK (8L << 20)
+
+/** \struct FastaScan
+ * \brief task finding the headers ('>' starting a line) of a part of a mapped file
+ */
+struct FastaScan
+{
+   const struct MappedFile *f; /*!< the file */
+   long begin, end;            /*!< the part of the file, [begin, end( */
+   long *headers;              /*!< positions of the headers found, in increasing order (malloc allocated) */
+   size_t count;               /*!< number of headers found */
+   size_t capacity;            /*!< allocated number of elements of headers */
+};
+
+static void _Fasta_Scan(void *arg)
+{
+   struct FastaScan *scan = (struct FastaScan *)arg;
+   const char *data = scan->f->data, *c = data + scan->begin, *end = data + scan->end;
+   while (c < end && (c = (const char *)memchr(c, '>', end - c)) != NULL)
+   { /* '>' is rare in a FASTA file: memchr skips the sequences at the speed of the memory */
+      if (c == data || c[-1] == '\n')
+      {
+         if (scan->count == scan->capacity)
+         {
+            scan->capacity = (scan->capacity == 0) ? 64 : 2 * scan->capacity;
+            scan->headers = (long *)realloc(scan->headers, scan->capacity * sizeof(long));
+            if (scan->headers == NULL)
+            {
+               perror("Fasta_Parse: realloc of headers");
+               exit(EXIT_FAILURE);
+            }
+         }
+         scan->headers[scan->count++] = c - data;
+      }
+      ++c;
+   }
+}
+
+void Fasta_Parse(const struct MappedFile *f, struct FastaRecords *records)
+{
+   char *data = f->data, *end = f->data + f->length;
+   /* The headers, the parts of a large file being scanned in parallel */
+   size_t nscans = (size_t)((f->length + FASTA_SCAN_CHUNK - 1) / FASTA_SCAN_CHUNK);
+   struct FastaScan *scans = (struct FastaScan *)calloc(nscans + 1, sizeof(struct FastaScan));
+   if (scans == NULL)
+   {
+      perror("Fasta_Parse: malloc of scans");
+      exit(EXIT_FAILURE);
+   }
+   for (size_t k = 0; k < nscans; ++k)
+   {
+      scans[k].f = f;
+      scans[k].begin = (long)k * FASTA_SCAN_CHUNK;
+      scans[k].end = (k + 1 < nscans) ? scans[k].begin + FASTA_SCAN_CHUNK : f->length;
+   }
+   if (nscans > 1)
+   {
+      struct ThreadPool *pool = ThreadPool_Default();
+      struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+      for (size_t k = 0; k < nscans; ++k)
+         ThreadPool_Submit(pool, &group, _Fasta_Scan, &scans[k]);
+      ThreadPool_Wait(pool, &group);
+   }
+   else if (nscans == 1)
+      _Fasta_Scan(&scans[0]);
+
+   { /* Sequence without header at the beginning of the file */
+      char *header = end;
+      for (size_t k = 0; k < nscans && header == end; ++k)
+         if (scans[k].count > 0)
+            header = data + scans[k].headers[0];
+      for (char *k = data; k < header; ++k)
+      {
+         if (!isspace((unsigned char)*k))
+         {
+            _Fasta_Append(records, "", 0, data, header - data);
+            break;
+         }
+      }
+   }
+   char *c = NULL; /* the previous header */
+   for (size_t k = 0; k <= nscans; ++k)
+   {
+      for (size_t h = 0; h < ((k < nscans) ? scans[k].count : 1); ++h)
+      {
+         char *next = (k < nscans) ? data + scans[k].headers[h] : end;
+         if (c != NULL)
+         { /* the record of c, up to next */
+            char *name = c + 1;
+            char *eol = (char *)memchr(c, '\n', next - c);
+            char *seq = (eol != NULL) ? eol + 1 : next;
+            int name_length = 0;
+            while (name + name_length < seq && !isspace((unsigned char)name[name_length]))
+               ++name_length;
+            _Fasta_Append(records, name, name_length, seq, next - seq);
+         }
+         c = next;
+      }
+      if (k < nscans)
+         free(scans[k].headers);
+   }
+   free(scans);
+}
+
+void FastaRecords_Free(struct FastaRecords *records)
+{
+   free(records->records);
+   records->records = NULL;
+   records->count = 0;
+   records->capacity = 0;
+}
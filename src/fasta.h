@@ -0,0 +1,66 @@
+/**
+ * \file fasta.h
+ * \brief records of a multi-FASTA file mapped in virtual memory
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * A record is a header line starting by '>' followed by the lines of its sequence, up to the next header or the end
+ * of the file. The sequence is kept as the characters of the file (with its '\n', that are skipped by the engines).
+ * The headers of a large file are searched in parallel by the default pool of threads, a part of the file per task.
+ */
+
+#ifndef __FASTA_H__
+#define __FASTA_H__
+
+#include <stdlib.h> /* for size_t */
+#include "mapped_file.h"
+
+/**
+ * \struct FastaRecord
+ * \brief a record of a FASTA file, pointing in the mapped file
+ */
+struct FastaRecord
+{
+   const char *name;   /*!< first word of the header, after '>' (not null terminated) */
+   int name_length;    /*!< number of characters of name */
+   char *seq;          /*!< first character of the line following the header */
+   long length;        /*!< number of characters of the sequence, '\n' included */
+};
+
+/**
+ * \struct FastaRecords
+ * \brief array of records; has to be initialized by FASTA_RECORDS_INIT
+ */
+struct FastaRecords
+{
+   struct FastaRecord *records; /*!< records[0..count-1] */
+   size_t count;                /*!< number of records */
+   size_t capacity;             /*!< allocated number of elements of records */
+};
+
+/** \def FASTA_RECORDS_INIT
+ * \brief initial value of an empty struct FastaRecords
+ */
+#define FASTA_RECORDS_INIT {NULL, 0, 0}
+
+/**
+ * \fn void Fasta_Open(const char *path, struct MappedFile *f);
+ * \brief opens the multi-FASTA file path in f by MappedFile_OpenInput (a gzip file is decompressed); a packed store
+ * (cf packed_store.h) is decoded into the FASTA text of its records. Exits with a message on failure.
+ */
+void Fasta_Open(const char *path, struct MappedFile *f);
+
+/**
+ * \fn void Fasta_Parse(const struct MappedFile *f, struct FastaRecords *records);
+ * \brief appends to records the records of f; the characters before the first header form a record with an empty name
+ * if they are not only spaces
+ */
+void Fasta_Parse(const struct MappedFile *f, struct FastaRecords *records);
+
+/**
+ * \fn void FastaRecords_Free(struct FastaRecords *records);
+ * \brief frees the array of records, that becomes empty (the mapped files are not closed)
+ */
+void FastaRecords_Free(struct FastaRecords *records);
+
+#endif /* __FASTA_H__ */
@@ -0,0 +1,379 @@
+/**
+ * \file fasta_index.c
+ * \brief implementation of the index of the records of a FASTA file
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see fasta_index.h
+ */
+
+#include "fasta_index.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h> /* for isspace */
+#include <err.h>
+#include <unistd.h>   /* for close */
+#include <sys/stat.h> /* for the dates of the files */
+
+/*
+ * \brief length of the line line[0..] of the file ending at end, '\n' included, and its number of bases (in *bases)
+ */
+static long _FastaIndex_Line(const char *line, const char *end, long *bases)
+{
+   const char *eol = (const char *)memchr(line, '\n', end - line);
+   long bytes = (eol != NULL) ? eol + 1 - line : end - line;
+   long n = (eol != NULL) ? eol - line : end - line;
+   if (n > 0 && line[n - 1] == '\r')
+      --n;
+   *bases = n;
+   return bytes;
+}
+
+/*
+ * \brief writes on out the index of the FASTA file f; exits with a message if f is not indexable
+ */
+static void _FastaIndex_Build(const struct MappedFile *f, FILE *out)
+{
+   const char *c = f->data, *end = f->data + f->length;
+   while (c < end && *c != '>')
+   { /* sequence without header: not indexable, only addressed by positions */
+      const char *eol = (const char *)memchr(c, '\n', end - c);
+      c = (eol != NULL) ? eol + 1 : end;
+   }
+   while (c < end)
+   { /* c is a header line */
+      const char *name = c + 1;
+      long name_length = 0, header_bases;
+      const char *seq = c + _FastaIndex_Line(c, end, &header_bases);
+      while (name + name_length < seq && !isspace((unsigned char)name[name_length]))
+         ++name_length;
+      long length = 0, line_bases = 0, line_bytes = 0;
+      int last = 0; /* a shorter line was read: it has to be the last one of the record */
+      for (c = seq; c < end && *c != '>';)
+      {
+         long bases, bytes = _FastaIndex_Line(c, end, &bases);
+         if (bases > 0)
+         {
+            if (line_bases == 0)
+            {
+               line_bases = bases;
+               line_bytes = bytes;
+            }
+            else if (last || bases > line_bases || (bases == line_bases && bytes != line_bytes))
+               errx(1, "%s: record %.*s: lines of different lengths, cannot be indexed", f->path, (int)name_length, name);
+            if (bases < line_bases)
+               last = 1;
+            length += bases;
+         }
+         else if (line_bases > 0)
+            last = 1;
+         c += bytes;
+      }
+      fprintf(out, "%.*s\t%ld\t%ld\t%ld\t%ld\n", (int)name_length, name, length, (long)(seq - f->data), line_bases,
+              line_bytes);
+   }
+}
+
+/*
+ * \brief parses the number in [*c, end(, moving *c after it; returns -1 if there is none
+ */
+static long _FastaIndex_Number(const char **c, const char *end)
+{
+   long n = 0;
+   const char *s = *c;
+   while (s < end && *s >= '0' && *s <= '9')
+      n = 10 * n + (*s++ - '0');
+   if (s == *c)
+      return -1;
+   *c = s;
+   return n;
+}
+
+static uint64_t _FastaIndex_Hash(const char *name, size_t name_length)
+{ /* FNV-1a */
+   uint64_t h = 14695981039346656037ULL;
+   for (size_t k = 0; k < name_length; ++k)
+      h = (h ^ (unsigned char)name[k]) * 1099511628211ULL;
+   return h;
+}
+
+/*
+ * \brief fills the entries and the hash table of index from the text[0..length-1] of the index
+ */
+static void _FastaIndex_Parse(struct FastaIndex *index, long length)
+{
+   const char *c = index->text, *end = index->text + length;
+   size_t capacity = 0;
+   index->entries = NULL;
+   index->count = 0;
+   while (c < end)
+   {
+      const char *eol = (const char *)memchr(c, '\n', end - c);
+      if (eol == NULL)
+         eol = end;
+      if (index->count == capacity)
+      {
+         capacity = (capacity == 0) ? 64 : 2 * capacity;
+         index->entries = (struct FastaIndexEntry *)realloc(index->entries, capacity * sizeof(struct FastaIndexEntry));
+         if (index->entries == NULL)
+         {
+            perror("FastaIndex_Load: realloc of entries");
+            exit(EXIT_FAILURE);
+         }
+      }
+      struct FastaIndexEntry *e = &index->entries[index->count];
+      const char *tab = (const char *)memchr(c, '\t', eol - c);
+      if (tab == NULL)
+         errx(1, "%s.fai: line %zu: expected name length offset line_bases line_bytes", index->path, index->count + 1);
+      e->name = c;
+      e->name_length = (int)(tab - c);
+      c = tab;
+      long *fields[4] = {&e->length, &e->offset, &e->line_bases, &e->line_bytes};
+      for (int k = 0; k < 4; ++k)
+      {
+         if (*c != '\t')
+            errx(1, "%s.fai: line %zu: expected name length offset line_bases line_bytes", index->path, index->count + 1);
+         ++c;
+         if ((*fields[k] = _FastaIndex_Number(&c, eol)) < 0)
+            errx(1, "%s.fai: line %zu: expected name length offset line_bases line_bytes", index->path, index->count + 1);
+      }
+      index->count++;
+      c = eol + 1;
+   }
+
+   index->table_size = 16;
+   while (index->table_size < 2 * index->count)
+      index->table_size *= 2;
+   index->table = (size_t *)malloc(index->table_size * sizeof(size_t));
+   if (index->table == NULL)
+   {
+      perror("FastaIndex_Load: malloc of table");
+      exit(EXIT_FAILURE);
+   }
+   for (size_t s = 0; s < index->table_size; ++s)
+      index->table[s] = index->count + 1;
+   for (size_t k = 0; k < index->count; ++k)
+   { /* linear probing; the first record of a name hides the next ones */
+      const struct FastaIndexEntry *e = &index->entries[k];
+      if (FastaIndex_Find(index, e->name, e->name_length) != NULL)
+         continue;
+      size_t s = _FastaIndex_Hash(e->name, e->name_length) & (index->table_size - 1);
+      while (index->table[s] != index->count + 1)
+         s = (s + 1) & (index->table_size - 1);
+      index->table[s] = k;
+   }
+}
+
+void FastaIndex_Load(const struct MappedFile *f, struct FastaIndex *index)
+{
+   size_t path_length = strlen(f->path);
+   char *fai_path = (char *)malloc(path_length + 5);
+   if (fai_path == NULL)
+   {
+      perror("FastaIndex_Load: malloc of pathname");
+      exit(EXIT_FAILURE);
+   }
+   memcpy(fai_path, f->path, path_length);
+   strcpy(fai_path + path_length, ".fai");
+   index->path = strdup(f->path);
+   if (index->path == NULL)
+      err(1, "strdup");
+   index->fai.data = NULL;
+   index->text = NULL;
+
+   struct stat fasta, fai;
+   if (fstat(f->fd, &fasta) == -1)
+      err(1, "fstat");
+   int up_to_date = stat(fai_path, &fai) == 0 && fai.st_size > 0 && fai.st_mtime >= fasta.st_mtime;
+   if (!up_to_date)
+   { /* builds the index, writes it if possible, else keeps it in memory */
+      char *text = NULL;
+      size_t length = 0;
+      FILE *out = open_memstream(&text, &length);
+      if (out == NULL)
+         err(1, "open_memstream");
+      if (f->offset != 0 || f->length != f->size)
+      { /* only a range of f is mapped (cf MappedFile_OpenSelection): the whole file is read once */
+         struct MappedFile whole;
+         MappedFile_Open(f->path, &whole);
+         _FastaIndex_Build(&whole, out);
+         MappedFile_Close(&whole);
+      }
+      else
+         _FastaIndex_Build(f, out);
+      if (fclose(out) != 0)
+         err(1, "open_memstream");
+      if (length > 0)
+      { /* written in a temporary file renamed at the end, for the processes reading the index meanwhile */
+         char *tmp_path = (char *)malloc(path_length + 12);
+         if (tmp_path == NULL)
+         {
+            perror("FastaIndex_Load: malloc of pathname");
+            exit(EXIT_FAILURE);
+         }
+         sprintf(tmp_path, "%s.XXXXXX", fai_path);
+         int fd = mkstemp(tmp_path);
+         FILE *fai_file = (fd != -1) ? fdopen(fd, "w") : NULL;
+         if (fai_file != NULL)
+         {
+            up_to_date = fwrite(text, 1, length, fai_file) == length;
+            if (fclose(fai_file) != 0)
+               up_to_date = 0;
+            if (up_to_date && (chmod(tmp_path, 0644) != 0 || rename(tmp_path, fai_path) != 0))
+               up_to_date = 0;
+            if (!up_to_date)
+               remove(tmp_path);
+         }
+         else if (fd != -1)
+         {
+            close(fd);
+            remove(tmp_path);
+         }
+         free(tmp_path);
+      }
+      if (!up_to_date)
+      {
+         index->text = text;
+         _FastaIndex_Parse(index, (long)length);
+      }
+      else
+         free(text);
+   }
+   if (up_to_date)
+   {
+      MappedFile_Open(fai_path, &index->fai);
+      index->text = index->fai.data;
+      _FastaIndex_Parse(index, index->fai.length);
+   }
+   free(fai_path);
+}
+
+void FastaIndex_Free(struct FastaIndex *index)
+{
+   if (index->fai.data != NULL)
+      MappedFile_Close(&index->fai);
+   else
+      free(index->text);
+   free(index->entries);
+   free(index->table);
+   free(index->path);
+}
+
+const struct FastaIndexEntry *FastaIndex_Find(const struct FastaIndex *index, const char *name, size_t name_length)
+{
+   size_t s = _FastaIndex_Hash(name, name_length) & (index->table_size - 1);
+   while (index->table[s] != index->count + 1)
+   {
+      const struct FastaIndexEntry *e = &index->entries[index->table[s]];
+      if ((size_t)e->name_length == name_length && memcmp(e->name, name, name_length) == 0)
+         return e;
+      s = (s + 1) & (index->table_size - 1);
+   }
+   return NULL;
+}
+
+int FastaIndex_IsRegion(const char *arg)
+{
+   const char *c = arg;
+   if (*c == '-' || *c == '+')
+      ++c;
+   if (*c == '\0')
+      return 1;
+   while (*c >= '0' && *c <= '9')
+      ++c;
+   return *c != '\0';
+}
+
+int FastaIndex_ParseRange(const char *range, long *start, long *end)
+{
+   const char *c = range, *stop = range + strlen(range);
+   *start = _FastaIndex_Number(&c, stop);
+   *end = -1;
+   if (c < stop && *c == '-')
+   {
+      ++c;
+      if ((*end = _FastaIndex_Number(&c, stop)) < 0)
+         return 0;
+   }
+   return *start >= 0 && c == stop;
+}
+
+/*
+ * \brief position in the FASTA file of the base p (counted from 0) of the record e
+ */
+static long _FastaIndex_Position(const struct FastaIndexEntry *e, long p)
+{
+   return e->offset + (p / e->line_bases) * e->line_bytes + p % e->line_bases;
+}
+
+void FastaIndex_Resolve(const struct FastaIndex *index, const char *region, long *begin, long *length)
+{
+   size_t region_length = strlen(region);
+   const struct FastaIndexEntry *e = FastaIndex_Find(index, region, region_length);
+   long start = 1, end = -1;
+   if (e == NULL)
+   { /* name:start-end or name:start */
+      const char *colon = strrchr(region, ':');
+      if (colon == NULL || (e = FastaIndex_Find(index, region, colon - region)) == NULL)
+         errx(1, "%s: no record %.*s", index->path, (int)((colon != NULL) ? colon - region : (long)region_length), region);
+      if (!FastaIndex_ParseRange(colon + 1, &start, &end))
+         errx(1, "%s: expected name:start-end, name:start or name, got %s", index->path, region);
+   }
+   if (end < 0)
+      end = e->length;
+   if (start < 1 || start > end + 1 || end > e->length)
+      errx(1, "%s: region %s out of the %ld bases of record %.*s", index->path, region, e->length, e->name_length,
+           e->name);
+   if (start > end)
+   { /* empty region */
+      *begin = e->offset;
+      *length = 0;
+      return;
+   }
+   *begin = _FastaIndex_Position(e, start - 1);
+   *length = _FastaIndex_Position(e, end - 1) + 1 - *begin;
+}
+
+const struct FastaIndex *FastaIndexCache_Get(struct FastaIndexCache *cache, const struct MappedFile *f)
+{
+   for (size_t k = 0; k < cache->count; ++k)
+   {
+      if (strcmp(cache->indexes[k]->path, f->path) == 0)
+         return cache->indexes[k];
+   }
+   if (cache->count == cache->capacity)
+   {
+      size_t capacity = (cache->capacity == 0) ? 8 : 2 * cache->capacity;
+      struct FastaIndex **indexes = (struct FastaIndex **)realloc(cache->indexes, capacity * sizeof(struct FastaIndex *));
+      if (indexes == NULL)
+      {
+         perror("FastaIndexCache_Get: realloc of indexes");
+         exit(EXIT_FAILURE);
+      }
+      cache->indexes = indexes;
+      cache->capacity = capacity;
+   }
+   struct FastaIndex *index = (struct FastaIndex *)malloc(sizeof(struct FastaIndex));
+   if (index == NULL)
+   {
+      perror("FastaIndexCache_Get: malloc of index");
+      exit(EXIT_FAILURE);
+   }
+   FastaIndex_Load(f, index);
+   cache->indexes[cache->count++] = index;
+   return index;
+}
+
+void FastaIndexCache_Free(struct FastaIndexCache *cache)
+{
+   for (size_t k = 0; k < cache->count; ++k)
+   {
+      FastaIndex_Free(cache->indexes[k]);
+      free(cache->indexes[k]);
+   }
+   free(cache->indexes);
+   cache->indexes = NULL;
+   cache->count = 0;
+   cache->capacity = 0;
+}
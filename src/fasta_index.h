@@ -0,0 +1,121 @@
+/**
+ * \file fasta_index.h
+ * \brief index of the records of a FASTA file (.fai format of samtools), to address a sequence by record:start-end
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * The index of file.fna is the text file file.fna.fai, one line per record:
+ *    name<tab>length<tab>offset<tab>line_bases<tab>line_bytes
+ * where length is the number of bases of the record, offset the position in the file of its first base, line_bases
+ * the number of bases of each line (the last one excepted) and line_bytes the number of bytes of each line ('\n'
+ * included). It is built at the first use of the file (or when the file is more recent than its index), then mapped
+ * in virtual memory; the position of any base is then computed in O(1), without reading the FASTA file.
+ *
+ * A region is given as name:start-end, the bases start..end (counted from 1, end included) of the record name,
+ * as name:start (up to the end of the record), or as name (the whole record).
+ */
+
+#ifndef __FASTA_INDEX_H__
+#define __FASTA_INDEX_H__
+
+#include <stdlib.h> /* for size_t */
+#include "mapped_file.h"
+
+/**
+ * \struct FastaIndexEntry
+ * \brief a line of the index
+ */
+struct FastaIndexEntry
+{
+   const char *name; /*!< name of the record, in the text of the index (not null terminated) */
+   int name_length;  /*!< number of characters of name */
+   long length;      /*!< number of bases of the record */
+   long offset;      /*!< position in the FASTA file of the first base */
+   long line_bases;  /*!< number of bases of a full line */
+   long line_bytes;  /*!< number of bytes of a full line, end of line included */
+};
+
+/**
+ * \struct FastaIndex
+ * \brief the index of a FASTA file, with a hash table of the names of its records
+ */
+struct FastaIndex
+{
+   char *path;                      /*!< pathname of the FASTA file (malloc allocated) */
+   struct MappedFile fai;           /*!< the index file mapped in memory (fai.data is NULL if it could not be written) */
+   char *text;                      /*!< text of the index: fai.data, or a malloc allocated copy */
+   struct FastaIndexEntry *entries; /*!< entries[0..count-1], in the order of the file */
+   size_t count;                    /*!< number of records */
+   size_t *table;                   /*!< hash table of the entries by name, count+1 meaning empty */
+   size_t table_size;               /*!< number of slots of table, a power of 2 */
+};
+
+/**
+ * \fn void FastaIndex_Load(const struct MappedFile *f, struct FastaIndex *index);
+ * \brief loads in index the index of the FASTA file f, building (and writing) it if it is missing or out of date.
+ * f may be only partly mapped (cf MappedFile_OpenSelection): it is then read only to build the index.
+ * Exits with a message if f is not indexable (lines of different lengths inside a record).
+ */
+void FastaIndex_Load(const struct MappedFile *f, struct FastaIndex *index);
+
+/**
+ * \fn void FastaIndex_Free(struct FastaIndex *index);
+ * \brief frees index (the FASTA file is not closed)
+ */
+void FastaIndex_Free(struct FastaIndex *index);
+
+/**
+ * \fn const struct FastaIndexEntry *FastaIndex_Find(const struct FastaIndex *index, const char *name, size_t name_length);
+ * \brief returns the entry of the record name[0..name_length-1], or NULL if there is none
+ */
+const struct FastaIndexEntry *FastaIndex_Find(const struct FastaIndex *index, const char *name, size_t name_length);
+
+/**
+ * \fn int FastaIndex_IsRegion(const char *arg);
+ * \brief returns not 0 if arg is a region rather than a position in a file (ie is not a number)
+ */
+int FastaIndex_IsRegion(const char *arg);
+
+/**
+ * \fn int FastaIndex_ParseRange(const char *range, long *start, long *end);
+ * \brief parses the range start-end or start of a region (end is then -1); returns 0 if range is malformed
+ */
+int FastaIndex_ParseRange(const char *range, long *start, long *end);
+
+/**
+ * \fn void FastaIndex_Resolve(const struct FastaIndex *index, const char *region, long *begin, long *length);
+ * \brief converts region to the position begin of its first base in the FASTA file and its number length of bytes
+ * (end of lines included, that are skipped by the engines), as expected by MappedFile_Select.
+ * Exits with a message if the record does not exist or the coordinates are out of the record.
+ */
+void FastaIndex_Resolve(const struct FastaIndex *index, const char *region, long *begin, long *length);
+
+/**
+ * \struct FastaIndexCache
+ * \brief set of indexes, by pathname of their FASTA file; has to be initialized by FASTA_INDEX_CACHE_INIT
+ */
+struct FastaIndexCache
+{
+   struct FastaIndex **indexes; /*!< indexes[0..count-1] are the loaded indexes */
+   size_t count;                /*!< number of indexes */
+   size_t capacity;             /*!< allocated number of elements of indexes */
+};
+
+/** \def FASTA_INDEX_CACHE_INIT
+ * \brief initial value of an empty struct FastaIndexCache
+ */
+#define FASTA_INDEX_CACHE_INIT {NULL, 0, 0}
+
+/**
+ * \fn const struct FastaIndex *FastaIndexCache_Get(struct FastaIndexCache *cache, const struct MappedFile *f);
+ * \brief returns the index of f in cache, loading it at the first call
+ */
+const struct FastaIndex *FastaIndexCache_Get(struct FastaIndexCache *cache, const struct MappedFile *f);
+
+/**
+ * \fn void FastaIndexCache_Free(struct FastaIndexCache *cache);
+ * \brief frees all the indexes of cache, that becomes empty
+ */
+void FastaIndexCache_Free(struct FastaIndexCache *cache);
+
+#endif /* __FASTA_INDEX_H__ */
@@ -0,0 +1,496 @@
+/**
+ * \file gzip_file.c
+ * \brief implementation of the selection in gzip and BGZF files
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see gzip_file.h
+ */
+
+#include "gzip_file.h"
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>   /* for UINT_MAX */
+#include <err.h>
+#include <fcntl.h>    /* for open */
+#include <unistd.h>   /* for read and close */
+#include <sys/mman.h> /* for madvise */
+#include <sys/stat.h>
+#include <zlib.h>
+
+/** \def GZIP_FILE_BUFFER
+ * \brief size of the buffer of decompressed characters of a gzip file
+ */
+#define GZIP_FILE_BUFFER (256L << 10)
+
+/** \def GZIP_FILE_TASK_BLOCKS
+ * \brief number of BGZF blocks decompressed by a task
+ */
+#define GZIP_FILE_TASK_BLOCKS 16
+
+/** \def GZIP_FILE_SLACK
+ * \brief number of characters decompressed after a selection (cf MAPPED_FILE_SLACK)
+ */
+#define GZIP_FILE_SLACK 4096L
+
+int GzipFile_IsGzip(const char *data, long n)
+{
+   return n >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+int GzipFile_IsGzipFile(const char *path)
+{
+   char magic[2];
+   int fd = open(path, O_RDONLY);
+   if (fd == -1)
+      return 0;
+   int gzip = read(fd, magic, 2) == 2 && GzipFile_IsGzip(magic, 2);
+   close(fd);
+   return gzip;
+}
+
+/**
+ * \fn static void _GzipFile_Inflate(const char *input, long ninput, struct StreamReader *reader, struct MappedFileSelection *sel, const char *path);
+ * \brief decompresses the gzip members input[0..ninput-1], then the blocks of reader (if not NULL), into sel up to the
+ * end of the selection; the data after the last member, if not gzip, is ignored (as gzip does)
+ */
+static void _GzipFile_Inflate(const char *input, long ninput, struct StreamReader *reader,
+                              struct MappedFileSelection *sel, const char *path)
+{
+   z_stream z;
+   memset(&z, 0, sizeof(z));
+   if (inflateInit2(&z, 15 + 16) != Z_OK) /* gzip format */
+      errx(1, "%s: inflateInit2 failed", path);
+   char *out = (char *)malloc(GZIP_FILE_BUFFER);
+   if (out == NULL)
+   {
+      perror("_GzipFile_Inflate: malloc of buffer");
+      exit(EXIT_FAILURE);
+   }
+   int in_member = 0;   // if a member is started and not ended
+   int at_boundary = 1; // if nothing has been decompressed from the current member
+   for (;;)
+   {
+      if (z.avail_in == 0)
+      { /* next input: input by pieces that fit in an uInt, then the blocks of reader */
+         if (ninput == 0 && reader != NULL)
+            ninput = StreamReader_Next(reader, &input);
+         if (ninput == 0)
+         {
+            if (in_member)
+               errx(1, "%s: unexpected end of gzip data", path);
+            break;
+         }
+         z.next_in = (Bytef *)input;
+         z.avail_in = (ninput > (long)UINT_MAX) ? UINT_MAX : (uInt)ninput;
+         input += z.avail_in;
+         ninput -= z.avail_in;
+      }
+      z.next_out = (Bytef *)out;
+      z.avail_out = GZIP_FILE_BUFFER;
+      in_member = 1;
+      int ret = inflate(&z, Z_NO_FLUSH);
+      long produced = GZIP_FILE_BUFFER - (long)z.avail_out;
+      if (ret == Z_DATA_ERROR && at_boundary && produced == 0)
+      { /* not a gzip member after the last one: ignored */
+         in_member = 0;
+         break;
+      }
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+         errx(1, "%s: corrupted gzip data (%s)", path, (z.msg != NULL) ? z.msg : "inflate failed");
+      if (produced > 0)
+         at_boundary = 0;
+      if (MappedFile_SelectionAdd(sel, out, produced))
+      {
+         in_member = 0;
+         break;
+      }
+      if (ret == Z_STREAM_END)
+      { /* a gzip file may be made of several members (as BGZF) */
+         in_member = 0;
+         at_boundary = 1;
+         if (inflateReset(&z) != Z_OK)
+            errx(1, "%s: inflateReset failed", path);
+      }
+   }
+   inflateEnd(&z);
+   free(out);
+}
+
+void GzipFile_InflateStream(struct StreamReader *reader, const char *block, long n, struct MappedFileSelection *sel,
+                            const char *path)
+{
+   _GzipFile_Inflate(block, n, reader, sel, path);
+}
+
+/**
+ * \struct GzipBlock
+ * \brief a BGZF block: its position in the compressed file and the position of its first character once decompressed
+ */
+struct GzipBlock
+{
+   uint64_t coffset; /*!< position of the block in the compressed file */
+   uint64_t uoffset; /*!< position of its first character in the decompressed file */
+};
+
+/**
+ * \struct GzipIndex
+ * \brief the blocks of a BGZF file
+ */
+struct GzipIndex
+{
+   struct GzipBlock *blocks; /*!< blocks[0..count-1], then blocks[count] = {size of the file, decompressed size} */
+   long count;               /*!< number of blocks */
+   long capacity;            /*!< allocated number of elements of blocks */
+};
+
+/**
+ * \fn static uint32_t _GzipFile_Le32(const unsigned char *p);
+ * \brief returns the unsigned integer of 32 bits in little endian order at p
+ */
+static uint32_t _GzipFile_Le32(const unsigned char *p)
+{
+   return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * \fn static long _GzipFile_BlockSize(const unsigned char *p, long available, long *header);
+ * \brief returns the size of the BGZF block at p (of which available bytes are in the file) and its header size in
+ * header, or -1 if p is not a complete BGZF block
+ */
+static long _GzipFile_BlockSize(const unsigned char *p, long available, long *header)
+{
+   if (available < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4))
+      return -1;
+   long xlen = (long)p[10] | (long)p[11] << 8;
+   if (12 + xlen > available)
+      return -1;
+   for (const unsigned char *x = p + 12; x + 4 <= p + 12 + xlen; x += 4 + ((long)x[2] | (long)x[3] << 8))
+   { /* subfields of the extra field: BC gives the size of the block minus 1 */
+      if (x[0] == 'B' && x[1] == 'C' && x[2] == 2 && x[3] == 0 && x + 6 <= p + 12 + xlen)
+      {
+         long size = ((long)x[4] | (long)x[5] << 8) + 1;
+         if (size < 12 + xlen + 8 || size > available)
+            return -1;
+         *header = 12 + xlen;
+         return size;
+      }
+   }
+   return -1;
+}
+
+/**
+ * \fn static void _GzipFile_Append(struct GzipIndex *index, uint64_t coffset, uint64_t uoffset);
+ * \brief appends the block {coffset, uoffset} to index
+ */
+static void _GzipFile_Append(struct GzipIndex *index, uint64_t coffset, uint64_t uoffset)
+{
+   if (index->count + 1 >= index->capacity)
+   { /* one more element for the end */
+      long capacity = (index->capacity == 0) ? 1024 : 2 * index->capacity;
+      struct GzipBlock *blocks = (struct GzipBlock *)realloc(index->blocks, capacity * sizeof(struct GzipBlock));
+      if (blocks == NULL)
+      {
+         perror("_GzipFile_Append: realloc of blocks");
+         exit(EXIT_FAILURE);
+      }
+      index->blocks = blocks;
+      index->capacity = capacity;
+   }
+   index->blocks[index->count].coffset = coffset;
+   index->blocks[index->count].uoffset = uoffset;
+   ++index->count;
+}
+
+/**
+ * \fn static int _GzipFile_ReadGzi(const char *gzi_path, const struct MappedFile *gz, struct GzipIndex *index);
+ * \brief appends to index (that contains the first block) the blocks listed in the index file gzi_path, if it is
+ * consistent with gz; returns 0 if it is not (index is then unchanged)
+ */
+static int _GzipFile_ReadGzi(const char *gzi_path, const struct MappedFile *gz, struct GzipIndex *index)
+{
+   FILE *gzi = fopen(gzi_path, "r");
+   if (gzi == NULL)
+      return 0;
+   uint64_t n, entry[2];
+   int ok = fread(&n, sizeof(n), 1, gzi) == 1 && n < (uint64_t)gz->length / 18;
+   for (uint64_t k = 0; ok && k < n; ++k)
+   {
+      const struct GzipBlock *previous = &index->blocks[index->count - 1];
+      ok = fread(entry, sizeof(entry), 1, gzi) == 1 && entry[0] > previous->coffset &&
+           entry[0] < (uint64_t)gz->length && entry[1] >= previous->uoffset;
+      if (ok)
+         _GzipFile_Append(index, entry[0], entry[1]);
+   }
+   fclose(gzi);
+   if (!ok)
+      index->count = 1;
+   return ok;
+}
+
+/**
+ * \fn static void _GzipFile_WriteGzi(const char *gzi_path, const struct GzipIndex *index);
+ * \brief writes the blocks of index, the first one excepted, in the index file gzi_path (format of bgzip -i); the
+ * index is only an optimization: it is not written if it cannot be
+ */
+static void _GzipFile_WriteGzi(const char *gzi_path, const struct GzipIndex *index)
+{
+   char *tmp_path = (char *)malloc(strlen(gzi_path) + 8);
+   if (tmp_path == NULL)
+   {
+      perror("_GzipFile_WriteGzi: malloc of pathname");
+      exit(EXIT_FAILURE);
+   }
+   sprintf(tmp_path, "%s.XXXXXX", gzi_path);
+   int fd = mkstemp(tmp_path); /* written in a temporary file renamed at the end, as the .fai files */
+   FILE *gzi = (fd != -1) ? fdopen(fd, "w") : NULL;
+   if (gzi != NULL)
+   {
+      uint64_t n = (uint64_t)index->count - 1;
+      int ok = fwrite(&n, sizeof(n), 1, gzi) == 1;
+      for (long k = 1; ok && k < index->count; ++k)
+      {
+         uint64_t entry[2] = {index->blocks[k].coffset, index->blocks[k].uoffset};
+         ok = fwrite(entry, sizeof(entry), 1, gzi) == 1;
+      }
+      if (fclose(gzi) != 0)
+         ok = 0;
+      if (!ok || chmod(tmp_path, 0644) != 0 || rename(tmp_path, gzi_path) != 0)
+         remove(tmp_path);
+   }
+   else if (fd != -1)
+   {
+      close(fd);
+      remove(tmp_path);
+   }
+   free(tmp_path);
+}
+
+/**
+ * \fn static int _GzipFile_Index(const struct MappedFile *gz, struct GzipIndex *index);
+ * \brief lists in index the blocks of gz, from its index file if it is up to date (else the index file is written);
+ * returns 0 if gz is not a BGZF file
+ */
+static int _GzipFile_Index(const struct MappedFile *gz, struct GzipIndex *index)
+{
+   const unsigned char *data = (const unsigned char *)gz->data;
+   long header;
+   index->blocks = NULL;
+   index->count = 0;
+   index->capacity = 0;
+   if (_GzipFile_BlockSize(data, gz->length, &header) < 0)
+      return 0;
+   _GzipFile_Append(index, 0, 0);
+
+   char *gzi_path = (char *)malloc(strlen(gz->path) + 5);
+   if (gzi_path == NULL)
+   {
+      perror("_GzipFile_Index: malloc of pathname");
+      exit(EXIT_FAILURE);
+   }
+   sprintf(gzi_path, "%s.gzi", gz->path);
+   struct stat gz_stat, gzi_stat;
+   if (fstat(gz->fd, &gz_stat) == -1)
+      err(1, "fstat");
+   int up_to_date = stat(gzi_path, &gzi_stat) == 0 && gzi_stat.st_mtime >= gz_stat.st_mtime &&
+                    _GzipFile_ReadGzi(gzi_path, gz, index);
+
+   /* the blocks after the last one of the index file (all of them if there is none), by their headers */
+   long coffset = (long)index->blocks[index->count - 1].coffset;
+   uint64_t uoffset = index->blocks[index->count - 1].uoffset;
+   --index->count;
+   while (coffset < gz->length)
+   {
+      long size = _GzipFile_BlockSize(data + coffset, gz->length - coffset, &header);
+      if (size < 0)
+      {
+         if (index->count == 0)
+         {
+            free(gzi_path);
+            return 0;
+         }
+         errx(1, "%s: corrupted BGZF block at position %ld", gz->path, coffset);
+      }
+      _GzipFile_Append(index, (uint64_t)coffset, uoffset);
+      uoffset += _GzipFile_Le32(data + coffset + size - 4);
+      coffset += size;
+   }
+   index->blocks[index->count].coffset = (uint64_t)coffset;
+   index->blocks[index->count].uoffset = uoffset;
+   if (!up_to_date)
+      _GzipFile_WriteGzi(gzi_path, index);
+   free(gzi_path);
+   return 1;
+}
+
+/**
+ * \struct GzipTask
+ * \brief decompression of the blocks first..last-1 of a BGZF file
+ */
+struct GzipTask
+{
+   const struct MappedFile *gz;     /*!< the compressed file */
+   const struct GzipBlock *blocks;  /*!< its blocks */
+   long first;                      /*!< first block */
+   long last;                       /*!< block after the last one */
+   char *out;                       /*!< where the characters of blocks[0] are decompressed */
+};
+
+/**
+ * \fn static void _GzipFile_InflateBlocks(void *arg);
+ * \brief decompresses the blocks of the struct GzipTask arg, and checks their CRC
+ */
+static void _GzipFile_InflateBlocks(void *arg)
+{
+   struct GzipTask *task = (struct GzipTask *)arg;
+   z_stream z;
+   memset(&z, 0, sizeof(z));
+   if (inflateInit2(&z, -15) != Z_OK) /* raw deflate data of the blocks */
+      errx(1, "%s: inflateInit2 failed", task->gz->path);
+   for (long k = task->first; k < task->last; ++k)
+   {
+      const struct GzipBlock *block = &task->blocks[k];
+      const unsigned char *p = (const unsigned char *)task->gz->data + block->coffset;
+      long size = (long)(block[1].coffset - block->coffset), header;
+      uInt length = (uInt)(block[1].uoffset - block->uoffset);
+      if (_GzipFile_BlockSize(p, size, &header) != size || _GzipFile_Le32(p + size - 4) != length)
+         errx(1, "%s: corrupted BGZF block at position %lu", task->gz->path, (unsigned long)block->coffset);
+      if (length == 0)
+         continue;
+      Bytef *out = (Bytef *)task->out + block->uoffset;
+      inflateReset(&z);
+      z.next_in = (Bytef *)p + header;
+      z.avail_in = (uInt)(size - header - 8);
+      z.next_out = out;
+      z.avail_out = length;
+      if (inflate(&z, Z_FINISH) != Z_STREAM_END || z.avail_out != 0 ||
+          crc32(crc32(0L, Z_NULL, 0), out, length) != _GzipFile_Le32(p + size - 8))
+         errx(1, "%s: corrupted BGZF block at position %lu", task->gz->path, (unsigned long)block->coffset);
+   }
+   inflateEnd(&z);
+}
+
+/**
+ * \fn static char *_GzipFile_InflateRange(const struct MappedFile *gz, const struct GzipIndex *index, long first, long last);
+ * \brief returns the decompressed characters of the blocks first..last-1 of gz (malloc allocated), decompressed in
+ * parallel by tasks of GZIP_FILE_TASK_BLOCKS blocks
+ */
+static char *_GzipFile_InflateRange(const struct MappedFile *gz, const struct GzipIndex *index, long first, long last)
+{
+   const struct GzipBlock *blocks = index->blocks;
+   char *data = (char *)malloc(blocks[last].uoffset - blocks[first].uoffset + 1);
+   long ntasks = (last - first + GZIP_FILE_TASK_BLOCKS - 1) / GZIP_FILE_TASK_BLOCKS;
+   struct GzipTask *tasks = (struct GzipTask *)malloc((ntasks + 1) * sizeof(struct GzipTask));
+   if (data == NULL || tasks == NULL)
+   {
+      perror("_GzipFile_InflateRange: malloc of data");
+      exit(EXIT_FAILURE);
+   }
+   { /* the compressed blocks are read ahead at once */
+      long page = sysconf(_SC_PAGESIZE);
+      long from = (long)blocks[first].coffset / page * page;
+      madvise(gz->data + from, (size_t)((long)blocks[last].coffset - from), MADV_WILLNEED);
+   }
+   struct ThreadPool *pool = ThreadPool_Default();
+   struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+   for (long t = 0; t < ntasks; ++t)
+   {
+      tasks[t].gz = gz;
+      tasks[t].blocks = blocks;
+      tasks[t].first = first + t * GZIP_FILE_TASK_BLOCKS;
+      tasks[t].last = (tasks[t].first + GZIP_FILE_TASK_BLOCKS < last) ? tasks[t].first + GZIP_FILE_TASK_BLOCKS : last;
+      tasks[t].out = data - blocks[first].uoffset;
+      ThreadPool_Submit(pool, &group, _GzipFile_InflateBlocks, &tasks[t]);
+   }
+   ThreadPool_Wait(pool, &group);
+   free(tasks);
+   return data;
+}
+
+/**
+ * \fn static void _GzipFile_SelectBlocks(const struct MappedFile *gz, const struct GzipIndex *index, long begin, long length, struct MappedFile *f);
+ * \brief decompresses in f the blocks of gz that contain the characters needed by MappedFile_Select(f, begin, length),
+ * as MappedFile_OpenSelection maps the pages of a file
+ */
+static void _GzipFile_SelectBlocks(const struct MappedFile *gz, const struct GzipIndex *index, long begin, long length,
+                                   struct MappedFile *f)
+{
+   const struct GzipBlock *blocks = index->blocks;
+   long total = (long)blocks[index->count].uoffset;
+   f->fd = -1;
+   f->size = total;
+   if (begin >= total)
+   { /* nothing to decompress, for the messages of MappedFile_Select */
+      f->data = (char *)malloc(1);
+      if (f->data == NULL)
+      {
+         perror("_GzipFile_SelectBlocks: malloc of data");
+         exit(EXIT_FAILURE);
+      }
+      f->offset = begin;
+      f->length = 0;
+      return;
+   }
+   long first = 0;
+   { /* the last block starting at or before begin */
+      long high = index->count - 1;
+      while (first < high)
+      {
+         long middle = (first + high + 1) / 2;
+         if ((long)blocks[middle].uoffset <= begin)
+            first = middle;
+         else
+            high = middle - 1;
+      }
+   }
+   long slack = GZIP_FILE_SLACK;
+   for (;;)
+   {
+      long end = (length > total - begin - slack) ? total : begin + length + slack;
+      long last = first + 1;
+      while (last < index->count && (long)blocks[last].uoffset < end)
+         ++last;
+      f->data = _GzipFile_InflateRange(gz, index, first, last);
+      f->offset = (long)blocks[first].uoffset;
+      f->length = (long)blocks[last].uoffset - f->offset;
+      if (end == total || f->data[begin - f->offset] != '>')
+         break;
+      /* the comment line skipped by MappedFile_Select has to be decompressed, with length characters after it */
+      char *s = f->data + (begin - f->offset);
+      char *eol = (char *)memchr(s, '\n', f->data + f->length - s);
+      long needed = (eol != NULL) ? (eol - s) + 2 : 0;
+      if (eol != NULL && needed <= slack)
+         break;
+      free(f->data);
+      slack = (eol != NULL) ? needed : 16 * slack;
+   }
+}
+
+void GzipFile_OpenSelection(const char *path, long begin, long length, struct MappedFile *f)
+{
+   if (begin < 0 || length < 0)
+      errx(1, "%s: negative position or length", path);
+   struct MappedFile gz; // the compressed file: only the pages of the blocks needed are read
+   struct GzipIndex index;
+   MappedFile_Open(path, &gz);
+   if (_GzipFile_Index(&gz, &index))
+   {
+      _GzipFile_SelectBlocks(&gz, &index, begin, length, f);
+      f->path = strdup(path);
+      if (f->path == NULL)
+         err(1, "strdup");
+   }
+   else
+   { /* a gzip file is decompressed from its beginning */
+      struct MappedFileSelection sel;
+      madvise(gz.data, (size_t)gz.length, MADV_SEQUENTIAL);
+      MappedFile_SelectionInit(&sel, begin, length);
+      _GzipFile_Inflate(gz.data, gz.length, NULL, &sel, path);
+      MappedFile_SelectionEnd(&sel, path, f);
+   }
+   free(index.blocks);
+   MappedFile_Close(&gz);
+}
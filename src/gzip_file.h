@@ -0,0 +1,47 @@
+/**
+ * \file gzip_file.h
+ * \brief selection of a sequence in a gzip compressed file (.fna.gz), decompressed in memory
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * A gzip file is decompressed from its beginning up to the end of the selection (the characters before it are
+ * decompressed but not kept). A BGZF file (the gzip variant of samtools, made of independent blocks of at most
+ * 64 kB) is decompressed from the block of the selection only: its blocks are listed in the index file.gz.gzi
+ * (format of bgzip -i), built at the first use of the file, and the blocks of the selection are decompressed in
+ * parallel (cf thread_pool.h).
+ */
+
+#ifndef __GZIP_FILE_H__
+#define __GZIP_FILE_H__
+
+#include "mapped_file.h"
+#include "stream_reader.h"
+
+/**
+ * \fn int GzipFile_IsGzip(const char *data, long n);
+ * \brief returns not 0 if the n characters data[0..n-1] start by the magic number of gzip
+ */
+int GzipFile_IsGzip(const char *data, long n);
+
+/**
+ * \fn int GzipFile_IsGzipFile(const char *path);
+ * \brief returns not 0 if the file path starts by the magic number of gzip
+ */
+int GzipFile_IsGzipFile(const char *path);
+
+/**
+ * \fn void GzipFile_OpenSelection(const char *path, long begin, long length, struct MappedFile *f);
+ * \brief decompresses in f the characters of the gzip file path needed by MappedFile_Select(f, begin, length), in
+ * positions of the decompressed file (as MappedFile_OpenSelection); exits with a message on failure
+ */
+void GzipFile_OpenSelection(const char *path, long begin, long length, struct MappedFile *f);
+
+/**
+ * \fn void GzipFile_InflateStream(struct StreamReader *reader, const char *block, long n, struct MappedFileSelection *sel, const char *path);
+ * \brief decompresses the gzip stream read by reader, of which block[0..n-1] is the first block already read,
+ * into sel, up to the end of the selection; exits with a message if the stream is corrupted
+ */
+void GzipFile_InflateStream(struct StreamReader *reader, const char *block, long n, struct MappedFileSelection *sel,
+                            const char *path);
+
+#endif /* __GZIP_FILE_H__ */
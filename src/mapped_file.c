@@ -0,0 +1,331 @@
+/**
+ * \file mapped_file.c
+ * \brief implementation of the files mapped in virtual memory
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see mapped_file.h
+ */
+
+#include "mapped_file.h"
+#include "stream_reader.h"
+#include "gzip_file.h"
+#include <stdio.h>
+#include <limits.h>   /* for LONG_MAX */
+#include <string.h>   /* for memchr */
+#include <err.h>
+#include <fcntl.h>    /* for open */
+#include <unistd.h>   /* for close */
+#include <sys/mman.h> /* for mmap and munmap */
+#include <sys/stat.h> /* for file length */
+
+void MappedFile_Open(const char *path, struct MappedFile *f)
+{
+   f->fd = open(path, O_RDONLY);
+   if (f->fd == -1)
+      err(1, "open %s", path);
+   struct stat s;
+   if (fstat(f->fd, &s) == -1)
+      err(1, "fstat");
+   f->data = (char *)mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+   if (f->data == MAP_FAILED)
+      err(1, "mmap");
+   f->length = (long)s.st_size;
+   f->offset = 0;
+   f->size = (long)s.st_size;
+   f->path = strdup(path);
+   if (f->path == NULL)
+      err(1, "strdup");
+}
+
+void MappedFile_OpenInput(const char *path, struct MappedFile *f)
+{
+   if (GzipFile_IsGzipFile(path))
+      GzipFile_OpenSelection(path, 0, LONG_MAX, f); /* from position 0 up to the end of the decompressed file */
+   else
+      MappedFile_Open(path, f);
+}
+
+/** \def MAPPED_FILE_SLACK
+ * \brief number of bytes mapped after a selection: the comment line to skip, and one byte for MappedFile_Select
+ */
+#define MAPPED_FILE_SLACK 4096L
+
+/** \def MAPPED_FILE_HUGE_PAGE
+ * \brief size of a huge page, the smallest range for MAPPED_FILE_HUGE_PAGES
+ */
+#define MAPPED_FILE_HUGE_PAGE (2L << 20)
+
+void MappedFile_OpenSelection(const char *path, long begin, long length, int advice, struct MappedFile *f)
+{
+   f->fd = open(path, O_RDONLY);
+   if (f->fd == -1)
+      err(1, "open %s", path);
+   struct stat s;
+   if (fstat(f->fd, &s) == -1)
+      err(1, "fstat");
+   f->size = (long)s.st_size;
+   if (begin < 0 || begin >= f->size || length < 0)
+   { /* nothing to map: the whole file, for the messages of MappedFile_Select */
+      close(f->fd);
+      MappedFile_Open(path, f);
+      return;
+   }
+   long page = sysconf(_SC_PAGESIZE);
+   f->offset = begin / page * page;
+   long slack = MAPPED_FILE_SLACK;
+   for (;;)
+   {
+      long end = (length > f->size - begin - slack) ? f->size : begin + length + slack;
+      f->length = end - f->offset;
+      f->data = (char *)mmap(NULL, f->length, PROT_READ,
+                             MAP_PRIVATE | ((advice & MAPPED_FILE_POPULATE) ? MAP_POPULATE : 0), f->fd, f->offset);
+      if (f->data == MAP_FAILED)
+         err(1, "mmap");
+      if (end == f->size || f->data[begin - f->offset] != '>')
+         break;
+      /* the comment line skipped by MappedFile_Select has to be mapped, with length characters after it */
+      char *s = f->data + (begin - f->offset);
+      char *eol = (char *)memchr(s, '\n', f->data + f->length - s);
+      long needed = (eol != NULL) ? (eol - s) + 2 : 0;
+      if (eol != NULL && needed <= slack)
+         break;
+      if (munmap(f->data, f->length) != 0)
+         err(1, "munmap");
+      slack = (eol != NULL) ? needed : 16 * slack;
+   }
+   if (advice & MAPPED_FILE_SEQUENTIAL)
+   { /* hints only: their failure does not matter */
+      madvise(f->data, f->length, MADV_SEQUENTIAL);
+      madvise(f->data, f->length, MADV_WILLNEED);
+   }
+#ifdef MADV_HUGEPAGE
+   if ((advice & MAPPED_FILE_HUGE_PAGES) && f->length >= MAPPED_FILE_HUGE_PAGE)
+      madvise(f->data, f->length, MADV_HUGEPAGE);
+#endif
+   f->path = strdup(path);
+   if (f->path == NULL)
+      err(1, "strdup");
+}
+
+int MappedFile_IsStream(const char *path)
+{
+   struct stat s;
+   if (strcmp(path, "-") == 0)
+      return 1;
+   return stat(path, &s) == 0 && (S_ISFIFO(s.st_mode) || S_ISCHR(s.st_mode) || S_ISSOCK(s.st_mode));
+}
+
+void MappedFile_SelectionInit(struct MappedFileSelection *sel, long begin, long length)
+{
+   sel->begin = begin;
+   sel->length = length;
+   sel->skip = begin;
+   sel->total = 0;
+   sel->needed = -1;
+   sel->scanned = 0;
+   sel->kept = 0;
+   sel->capacity = 4096;
+   sel->data = (char *)malloc(sel->capacity);
+   if (sel->data == NULL)
+   {
+      perror("MappedFile_SelectionInit: malloc of data");
+      exit(EXIT_FAILURE);
+   }
+}
+
+int MappedFile_SelectionAdd(struct MappedFileSelection *sel, const char *block, long n)
+{
+   if (sel->needed >= 0 && sel->kept >= sel->needed)
+      return 1;
+   sel->total += n;
+   if (sel->skip >= n)
+   {
+      sel->skip -= n;
+      return 0;
+   }
+   block += sel->skip;
+   n -= sel->skip;
+   sel->skip = 0;
+   if (sel->needed >= 0 && n > sel->needed - sel->kept)
+      n = sel->needed - sel->kept;
+   if (sel->kept + n > sel->capacity)
+   {
+      while (sel->kept + n > sel->capacity)
+         sel->capacity *= 2;
+      char *data = (char *)realloc(sel->data, sel->capacity);
+      if (data == NULL)
+      {
+         perror("MappedFile_SelectionAdd: realloc of data");
+         exit(EXIT_FAILURE);
+      }
+      sel->data = data;
+   }
+   memcpy(sel->data + sel->kept, block, n);
+   sel->kept += n;
+   if (sel->needed < 0)
+   { /* as MappedFile_Select: the comment line at begin, the sequence, and one more character */
+      long header = 0;
+      if (sel->data[0] == '>')
+      {
+         char *eol = (char *)memchr(sel->data + sel->scanned, '\n', sel->kept - sel->scanned);
+         sel->scanned = sel->kept;
+         header = (eol != NULL) ? eol - sel->data + 1 : -1;
+      }
+      if (header >= 0)
+         sel->needed = (sel->length > LONG_MAX - header - 1) ? LONG_MAX : header + sel->length + 1;
+      if (sel->needed >= 0 && sel->kept > sel->needed)
+         sel->kept = sel->needed;
+   }
+   return sel->needed >= 0 && sel->kept >= sel->needed;
+}
+
+void MappedFile_SelectionEnd(struct MappedFileSelection *sel, const char *path, struct MappedFile *f)
+{
+   int at_end = (sel->needed < 0 || sel->kept < sel->needed); /* all the characters have been given */
+   f->fd = -1;
+   f->data = sel->data;
+   f->length = sel->kept;
+   f->offset = sel->begin;
+   f->size = at_end ? sel->total : sel->begin + sel->kept;
+   f->path = strdup(path);
+   if (f->path == NULL)
+      err(1, "strdup");
+   sel->data = NULL;
+}
+
+void MappedFile_OpenStream(const char *path, long begin, long length, struct MappedFile *f)
+{
+   if (begin < 0 || length < 0)
+      errx(1, "%s: negative position or length", path);
+   int fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+   if (fd == -1)
+      err(1, "open %s", path);
+   struct StreamReader *reader = StreamReader_Open(fd, path);
+   struct MappedFileSelection sel;
+   MappedFile_SelectionInit(&sel, begin, length);
+   const char *block;
+   long n = StreamReader_Next(reader, &block);
+   if (GzipFile_IsGzip(block, n))
+      GzipFile_InflateStream(reader, block, n, &sel, path);
+   else
+   {
+      while (n > 0 && !MappedFile_SelectionAdd(&sel, block, n))
+         n = StreamReader_Next(reader, &block);
+   }
+   StreamReader_Close(reader); /* the rest of the stream is not read */
+   if (fd != STDIN_FILENO && close(fd) != 0)
+      err(1, "close");
+   MappedFile_SelectionEnd(&sel, path, f);
+}
+
+void MappedFile_Close(struct MappedFile *f)
+{
+   if (f->fd == -1)
+      free(f->data);
+   else
+   {
+      if (munmap(f->data, (size_t)f->length) != 0)
+         err(1, "munmap");
+      if (close(f->fd) != 0)
+         err(1, "close");
+   }
+   free(f->path);
+}
+
+void MappedFile_Select(const struct MappedFile *f, long begin, long length, int verbose, char **seq, long *seq_length)
+{
+   char *s;
+   { // Assign s to the begining of the sequence, excluding comment lines starting by '<'
+      long n_exceed = f->size - begin;
+      if (n_exceed < 0)
+      {
+         fprintf(stderr, "Error: given sequence beginning %ld exceeds end of file of %ld bytes.\n",
+                 begin, n_exceed);
+         exit(1);
+      }
+      s = f->data + (begin - f->offset); // beginning of the sequence
+      if (n_exceed > 0 && *s == '>') /* Skip and print the first line starting by '<' */
+      {
+         char *endofline = (char *)memchr(s, '\n', f->data + f->length - s);
+         if (endofline == NULL)
+            endofline = f->data + f->length - 1;
+         if (verbose)
+         {
+            fprintf(stderr, "Sequence comment in preamble: ");
+            for (char *c = s; c <= endofline; ++c)
+               fprintf(stderr, "%c", *c);
+         }
+         if (*endofline == '\n')
+            s = endofline + 1; // first character of next line
+      }
+   }
+
+   { // truncate length to the end of the file
+      long n_exceed = f->data + f->length - 1 - (s + length);
+      if (n_exceed < 0)
+      {
+         fprintf(stderr, "Warning: given sequence length %ld exceeds end of file of %ld bytes; "
+                         "sequence length is truncated to %ld.\n",
+                 length, -n_exceed, length + n_exceed);
+         length = length + n_exceed;
+      }
+   }
+
+   if (verbose)
+   { /* Print on stderr either the full sequence is length<40 or the first twenty and last twenty characters of the sequence */
+      if (length <= 40)
+      {
+         for (char *c = s; (c < s + length); ++c)
+            fprintf(stderr, "%c", *c);
+      }
+      else
+      {
+         {
+            for (char *c = s; (c < s + 20); ++c)
+               fprintf(stderr, "%c", *c);
+         }
+         fprintf(stderr, "...");
+         {
+            for (char *c = s + length - 20; (c < s + length); ++c)
+               fprintf(stderr, "%c", *c);
+         }
+      }
+      fprintf(stderr, "\n");
+   }
+   *seq = s;
+   *seq_length = length;
+}
+
+const struct MappedFile *MappedFileCache_Get(struct MappedFileCache *cache, const char *path)
+{
+   for (size_t k = 0; k < cache->count; ++k)
+   {
+      if (strcmp(cache->files[k].path, path) == 0)
+         return &cache->files[k];
+   }
+   if (cache->count == cache->capacity)
+   {
+      size_t capacity = (cache->capacity == 0) ? 8 : 2 * cache->capacity;
+      struct MappedFile *files = (struct MappedFile *)realloc(cache->files, capacity * sizeof(struct MappedFile));
+      if (files == NULL)
+      {
+         perror("MappedFileCache_Get: realloc of files");
+         exit(EXIT_FAILURE);
+      }
+      cache->files = files;
+      cache->capacity = capacity;
+   }
+   MappedFile_OpenInput(path, &cache->files[cache->count]);
+   return &cache->files[cache->count++];
+}
+
+void MappedFileCache_Close(struct MappedFileCache *cache)
+{
+   for (size_t k = 0; k < cache->count; ++k)
+      MappedFile_Close(&cache->files[k]);
+   free(cache->files);
+   cache->files = NULL;
+   cache->count = 0;
+   cache->capacity = 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * \file mapped_file.h
+ * \brief files of characters mapped in virtual memory (mmap), and selection of a subsequence in a mapped file
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * A MappedFileCache keeps the files open and mapped, so that a process computing many distances
+ * (cf batch.h) maps each file once.
+ *
+ * A process computing one distance only needs the selected sequence: MappedFile_OpenSelection maps the pages of
+ * that range only (eg 10 kB at 77 MB of a 200 MB genome), and tells the kernel how they are read (madvise), so that
+ * they are read ahead at once, instead of page faults on a cold cache or a network file system.
+ *
+ * A stream (standard input "-", pipe, FIFO) cannot be mapped: MappedFile_OpenStream reads the selected range of it
+ * into memory instead (cf stream_reader.h), so that MappedFile_Select works the same on it.
+ */
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <stdlib.h> /* for size_t */
+
+/**
+ * \struct MappedFile
+ * \brief a file mapped read-only in virtual memory
+ */
+struct MappedFile
+{
+   char *path;        /*!< pathname of the file (malloc allocated) */
+   int fd;            /*!< file descriptor, -1 if the content has been read from a stream */
+   char *data;        /*!< data[0..length-1] is the content of the file from the position offset (malloc allocated
+                           if read from a stream) */
+   long length;       /*!< length of the mapped content, in bytes */
+   long offset;       /*!< position of data[0] in the file: 0, unless mapped by MappedFile_OpenSelection */
+   long size;         /*!< length of the whole file, in bytes (length + offset if the whole file is mapped) */
+};
+
+/** \def MAPPED_FILE_SEQUENTIAL
+ * \brief advice of MappedFile_OpenSelection: the range is read once from its beginning, and read ahead at once
+ */
+#define MAPPED_FILE_SEQUENTIAL 1
+
+/** \def MAPPED_FILE_POPULATE
+ * \brief advice of MappedFile_OpenSelection: the pages are read before the mapping returns (MAP_POPULATE)
+ */
+#define MAPPED_FILE_POPULATE 2
+
+/** \def MAPPED_FILE_HUGE_PAGES
+ * \brief advice of MappedFile_OpenSelection: a large range (at least 2 MB) is asked for huge pages, if the kernel
+ * supports them for the page cache (fewer TLB misses); no effect otherwise
+ */
+#define MAPPED_FILE_HUGE_PAGES 4
+
+/**
+ * \fn void MappedFile_Open(const char *path, struct MappedFile *f);
+ * \brief opens and maps the file path in f; exits with a message on failure
+ */
+void MappedFile_Open(const char *path, struct MappedFile *f);
+
+/**
+ * \fn void MappedFile_OpenInput(const char *path, struct MappedFile *f);
+ * \brief opens the whole file path in f as MappedFile_Open, but a gzip file is decompressed in memory (cf gzip_file.h):
+ * the modes that read whole files (batch, all-vs-all, one-vs-many, dot plot) open them by this function, so that they
+ * read the same characters as the distance between two sequences. Exits with a message on failure.
+ */
+void MappedFile_OpenInput(const char *path, struct MappedFile *f);
+
+/**
+ * \fn void MappedFile_OpenSelection(const char *path, long begin, long length, int advice, struct MappedFile *f);
+ * \brief opens the file path and maps in f only the pages needed by MappedFile_Select(f, begin, length), the
+ * comment line starting at begin (if any) included; exits with a message on failure
+ * \param advice : MAPPED_FILE_SEQUENTIAL, MAPPED_FILE_POPULATE, MAPPED_FILE_HUGE_PAGES or a combination (|), or 0
+ */
+void MappedFile_OpenSelection(const char *path, long begin, long length, int advice, struct MappedFile *f);
+
+/**
+ * \fn int MappedFile_IsStream(const char *path);
+ * \brief returns not 0 if path is "-" (the standard input) or a file that cannot be mapped (pipe, FIFO, terminal...)
+ */
+int MappedFile_IsStream(const char *path);
+
+/**
+ * \fn void MappedFile_OpenStream(const char *path, long begin, long length, struct MappedFile *f);
+ * \brief reads in f the characters of the stream path ("-" for the standard input) needed by
+ * MappedFile_Select(f, begin, length): the first begin characters are skipped while they are read, and the stream is
+ * not read after the selection. A gzip stream is decompressed while it is read. Exits with a message on failure.
+ */
+void MappedFile_OpenStream(const char *path, long begin, long length, struct MappedFile *f);
+
+/**
+ * \struct MappedFileSelection
+ * \brief the characters needed by MappedFile_Select(f, begin, length), collected from the blocks of a stream
+ * (cf MappedFile_OpenStream) or of a decompressed file (cf gzip_file.h)
+ */
+struct MappedFileSelection
+{
+   long begin;    /*!< position of the selection */
+   long length;   /*!< length of the selection */
+   long skip;     /*!< characters still to skip before begin */
+   long total;    /*!< characters given */
+   long needed;   /*!< characters needed from begin, -1 until the comment line at begin is complete */
+   long scanned;  /*!< characters of data searched for the end of the comment line */
+   char *data;    /*!< data[0..kept-1] are the characters kept from begin (malloc allocated) */
+   long kept;     /*!< characters kept */
+   long capacity; /*!< allocated length of data */
+};
+
+/**
+ * \fn void MappedFile_SelectionInit(struct MappedFileSelection *sel, long begin, long length);
+ * \brief initializes sel to collect the characters needed by MappedFile_Select(f, begin, length)
+ */
+void MappedFile_SelectionInit(struct MappedFileSelection *sel, long begin, long length);
+
+/**
+ * \fn int MappedFile_SelectionAdd(struct MappedFileSelection *sel, const char *block, long n);
+ * \brief gives to sel the next n characters block[0..n-1]; returns not 0 when sel needs no more characters
+ */
+int MappedFile_SelectionAdd(struct MappedFileSelection *sel, const char *block, long n);
+
+/**
+ * \fn void MappedFile_SelectionEnd(struct MappedFileSelection *sel, const char *path, struct MappedFile *f);
+ * \brief makes f (of pathname path, to be closed by MappedFile_Close) from the characters collected by sel
+ */
+void MappedFile_SelectionEnd(struct MappedFileSelection *sel, const char *path, struct MappedFile *f);
+
+/**
+ * \fn void MappedFile_Close(struct MappedFile *f);
+ * \brief unmaps and closes f (frees it if it has been read from a stream)
+ */
+void MappedFile_Close(struct MappedFile *f);
+
+/**
+ * \fn void MappedFile_Select(const struct MappedFile *f, long begin, long length, int verbose, char **seq, long *seq_length);
+ * \brief selects the sequence of length characters from position begin in f, as distanceEdition does
+ * \param f : the mapped file (by MappedFile_Open, or by MappedFile_OpenSelection or MappedFile_OpenStream with the
+ * same begin and length)
+ * \param begin : position of the first character; exits with a message if it exceeds the end of the file
+ * \param length : number of characters, truncated (with a warning on stderr) to the end of the file
+ * \param verbose : if not 0, prints on stderr the comment line skipped and the first and last characters of the sequence
+ * \param seq : receives the address of the first character of the sequence in f->data
+ * \param seq_length : receives the (possibly truncated) length of the sequence
+ *
+ * If the sequence starts by a comment line ('>'), the sequence starts after that line.
+ */
+void MappedFile_Select(const struct MappedFile *f, long begin, long length, int verbose, char **seq, long *seq_length);
+
+/**
+ * \struct MappedFileCache
+ * \brief set of mapped files, indexed by their pathname; has to be initialized by MAPPED_FILE_CACHE_INIT
+ */
+struct MappedFileCache
+{
+   struct MappedFile *files; /*!< files[0..count-1] are the mapped files */
+   size_t count;             /*!< number of mapped files */
+   size_t capacity;          /*!< allocated number of elements of files */
+};
+
+/** \def MAPPED_FILE_CACHE_INIT
+ * \brief initial value of an empty struct MappedFileCache
+ */
+#define MAPPED_FILE_CACHE_INIT {NULL, 0, 0}
+
+/**
+ * \fn const struct MappedFile *MappedFileCache_Get(struct MappedFileCache *cache, const char *path);
+ * \brief returns the file path mapped in cache, opening it by MappedFile_OpenInput at the first call
+ * The returned pointer is valid until the next call of MappedFileCache_Get or MappedFileCache_Close.
+ */
+const struct MappedFile *MappedFileCache_Get(struct MappedFileCache *cache, const char *path);
+
+/**
+ * \fn void MappedFileCache_Close(struct MappedFileCache *cache);
+ * \brief closes all the files of cache, that becomes empty
+ */
+void MappedFileCache_Close(struct MappedFileCache *cache);
+
+#endif /* __MAPPED_FILE_H__ */
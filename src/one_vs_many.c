@@ -0,0 +1,358 @@
+/**
+ * \file one_vs_many.c
+ * \brief implementation of the one-vs-many mode
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see one_vs_many.h
+ */
+
+#include "one_vs_many.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h> /* for isspace */
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>  /* for open */
+#include <unistd.h> /* for read */
+#include <pthread.h>
+#include "mapped_file.h"
+#include "gzip_file.h"
+#include "fasta.h"
+#include "packed_store.h" /* for PACKED_STORE_MAGIC */
+#include "thread_pool.h"
+
+/** \def ONE_VS_MANY_PENDING_PER_THREAD
+ * \brief maximal number of records read but not computed, per thread: bounds the memory used for a long stream (the
+ * reader then waits for one of them to be done, not for all of them)
+ */
+#define ONE_VS_MANY_PENDING_PER_THREAD 4
+
+/** \def ONE_VS_MANY_EXTEND_BUFFER
+ * \brief maximal number of characters read at once by OneVsMany_Extend
+ */
+#define ONE_VS_MANY_EXTEND_BUFFER (64 << 10)
+
+/** \struct OneVsManyContext
+ * \brief the reference and the output, shared by the queries
+ */
+struct OneVsManyContext
+{
+   enum NW_Engine engine;                /*!< engine computing the distances */
+   char *reference;                      /*!< characters of the reference, in its mapped file */
+   long reference_length;                /*!< number of characters of the reference */
+   struct EncodedSequence encoded;       /*!< encoding of the reference */
+   struct NW_QueryProfile *profile;      /*!< profile of the reference (NULL without AVX2) */
+   FILE *out;                            /*!< where the results are written */
+   long pending;                         /*!< number of queries submitted and not done */
+   pthread_mutex_t lock;                 /*!< protects out and pending */
+   pthread_cond_t done;                  /*!< signaled when a query is done */
+};
+
+/** \struct OneVsManyQuery
+ * \brief task computing the distance between a record and the reference
+ */
+struct OneVsManyQuery
+{
+   struct OneVsManyContext *ctx; /*!< the reference */
+   char *name;                   /*!< name of the record (malloc allocated) */
+   char *seq;                    /*!< characters of the record, '\n' excluded (malloc allocated) */
+   long length;                  /*!< number of characters of seq */
+};
+
+static void _OneVsMany_RunQuery(void *arg)
+{
+   struct OneVsManyQuery *q = (struct OneVsManyQuery *)arg;
+   struct OneVsManyContext *ctx = q->ctx;
+   long res;
+   if (ctx->engine == NW_ENGINE_AUTO || ctx->engine == NW_ENGINE_AUTO_PAR)
+   {
+      struct EncodedSequence encoded;
+      EncodeSequence(q->seq, q->length, &encoded);
+      res = EditDistance_NW_Encoded(NULL, &encoded, &ctx->encoded, ctx->profile, ctx->engine, NULL);
+      EncodedSequence_Free(&encoded);
+   }
+   else
+      res = EditDistance_NW_Dispatch(NULL, q->seq, q->length, ctx->reference, ctx->reference_length, ctx->engine, NULL);
+   pthread_mutex_lock(&ctx->lock);
+   fprintf(ctx->out, "%s\t%ld\n", q->name, res);
+   fflush(ctx->out);
+   --ctx->pending;
+   pthread_cond_signal(&ctx->done);
+   pthread_mutex_unlock(&ctx->lock);
+   free(q->name);
+   free(q->seq);
+   free(q);
+}
+
+/** \struct OneVsManyReader
+ * \brief record being read from a stream
+ */
+struct OneVsManyReader
+{
+   struct OneVsManyContext *ctx;   /*!< the reference */
+   struct ThreadPool *pool;        /*!< pool computing the queries */
+   struct ThreadPool_Group group;  /*!< the queries submitted */
+   long max_pending;               /*!< maximal number of queries submitted and not done */
+   size_t nrecords;                /*!< number of records read */
+   struct OneVsManyQuery *current; /*!< record being read, NULL before the first one */
+   size_t capacity;                /*!< allocated number of characters of current->seq */
+};
+
+/*
+ * \brief submits the record being read (if it is one), and starts a new record called name (if not NULL)
+ */
+static void _OneVsMany_NextRecord(struct OneVsManyReader *r, const char *name, size_t name_length)
+{
+   struct OneVsManyQuery *q = r->current;
+   if (q != NULL)
+   { /* the queue is full until a query is done; the other ones go on meanwhile */
+      struct OneVsManyContext *ctx = r->ctx;
+      pthread_mutex_lock(&ctx->lock);
+      while (ctx->pending >= r->max_pending)
+      {
+         if (ThreadPool_Size(r->pool) == 1)
+         { /* no thread of the pool but the reader: it computes the queries */
+            pthread_mutex_unlock(&ctx->lock);
+            ThreadPool_Wait(r->pool, &r->group);
+            pthread_mutex_lock(&ctx->lock);
+         }
+         else
+            pthread_cond_wait(&ctx->done, &ctx->lock);
+      }
+      ++ctx->pending;
+      pthread_mutex_unlock(&ctx->lock);
+      ThreadPool_Submit(r->pool, &r->group, _OneVsMany_RunQuery, q);
+      r->current = NULL;
+   }
+   if (name == NULL)
+      return;
+   q = (struct OneVsManyQuery *)malloc(sizeof(struct OneVsManyQuery));
+   if (q == NULL)
+   {
+      perror("OneVsMany_Run: malloc of query");
+      exit(EXIT_FAILURE);
+   }
+   q->ctx = r->ctx;
+   q->name = (char *)malloc(name_length + 32);
+   r->capacity = 4096;
+   q->seq = (char *)malloc(r->capacity);
+   if (q->name == NULL || q->seq == NULL)
+   {
+      perror("OneVsMany_Run: malloc of query");
+      exit(EXIT_FAILURE);
+   }
+   if (name_length > 0)
+   {
+      memcpy(q->name, name, name_length);
+      q->name[name_length] = '\0';
+   }
+   else
+      sprintf(q->name, "record%zu", r->nrecords);
+   q->length = 0;
+   r->nrecords++;
+   r->current = q;
+}
+
+/*
+ * \brief appends the n characters chars to the record being read
+ */
+static void _OneVsMany_Append(struct OneVsManyReader *r, const char *chars, long n)
+{
+   struct OneVsManyQuery *q = r->current;
+   if (q->length + n > (long)r->capacity)
+   {
+      while (q->length + n > (long)r->capacity)
+         r->capacity *= 2;
+      q->seq = (char *)realloc(q->seq, r->capacity);
+      if (q->seq == NULL)
+      {
+         perror("OneVsMany_Run: realloc of query");
+         exit(EXIT_FAILURE);
+      }
+   }
+   memcpy(q->seq + q->length, chars, n);
+   q->length += n;
+}
+
+/*
+ * \brief reads the records of the stream in (named name), each one being submitted once read
+ */
+static void _OneVsMany_Read(struct OneVsManyReader *r, FILE *in, const char *name)
+{
+   char *line = NULL;
+   size_t line_capacity = 0;
+   ssize_t n;
+   int first = 1;
+   while ((n = getline(&line, &line_capacity, in)) != -1)
+   {
+      if (first && GzipFile_IsGzip(line, n)) /* a regular file is decompressed, cf _OneVsMany_ReadFile */
+         errx(1, "%s: gzip stream, the records of a stream have to be uncompressed (eg by gunzip -c)", name);
+      if (first && n >= 4 && memcmp(line, PACKED_STORE_MAGIC, 4) == 0)
+         errx(1, "%s: packed store in a stream, give its pathname instead", name);
+      first = 0;
+      while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+         --n;
+      if (n > 0 && line[0] == '>')
+      {
+         size_t name_length = 0;
+         while (1 + name_length < (size_t)n && !isspace((unsigned char)line[1 + name_length]))
+            ++name_length;
+         _OneVsMany_NextRecord(r, line + 1, name_length);
+         continue;
+      }
+      if (r->current == NULL)
+      { /* sequence without header */
+         ssize_t k = 0;
+         while (k < n && isspace((unsigned char)line[k]))
+            ++k;
+         if (k == n)
+            continue;
+         _OneVsMany_NextRecord(r, "", 0);
+      }
+      _OneVsMany_Append(r, line, n);
+   }
+   free(line);
+   _OneVsMany_NextRecord(r, NULL, 0);
+}
+
+/*
+ * \brief reads the records of the file path (cf Fasta_Open), each one being submitted once read
+ */
+static void _OneVsMany_ReadFile(struct OneVsManyReader *r, const char *path)
+{
+   struct MappedFile f;
+   struct FastaRecords records = FASTA_RECORDS_INIT;
+   Fasta_Open(path, &f);
+   Fasta_Parse(&f, &records);
+   for (size_t k = 0; k < records.count; ++k)
+   {
+      _OneVsMany_NextRecord(r, records.records[k].name, records.records[k].name_length);
+      _OneVsMany_Append(r, records.records[k].seq, records.records[k].length);
+   }
+   _OneVsMany_NextRecord(r, NULL, 0);
+   FastaRecords_Free(&records);
+   MappedFile_Close(&f);
+}
+
+/**
+ * \fn static void _OneVsMany_LoadReference(const char *reference, struct MappedFile *ref, char **seq, long *length);
+ * \brief opens the FASTA file reference in ref (cf Fasta_Open), and returns in seq and length its first
+ * record (in ref)
+ */
+static void _OneVsMany_LoadReference(const char *reference, struct MappedFile *ref, char **seq, long *length)
+{
+   struct FastaRecords records = FASTA_RECORDS_INIT;
+   Fasta_Open(reference, ref);
+   Fasta_Parse(ref, &records);
+   if (records.count == 0)
+      errx(1, "no sequence in the reference %s", reference);
+   *seq = records.records[0].seq;
+   *length = records.records[0].length;
+   FastaRecords_Free(&records);
+}
+
+void OneVsMany_Run(const char *reference, char **paths, int npaths, FILE *out, enum NW_Engine engine)
+{
+   struct OneVsManyContext ctx;
+   struct MappedFile ref;
+   _OneVsMany_LoadReference(reference, &ref, &ctx.reference, &ctx.reference_length);
+   /* Preprocessing of the reference, once */
+   ctx.engine = engine;
+   EncodeSequence(ctx.reference, ctx.reference_length, &ctx.encoded);
+   ctx.profile = (NW_CpuFeatures() & NW_CPU_AVX2) ? NW_QueryProfile_BuildEncoded(&ctx.encoded) : NULL;
+   ctx.out = out;
+   ctx.pending = 0;
+   pthread_mutex_init(&ctx.lock, NULL);
+   pthread_cond_init(&ctx.done, NULL);
+
+   struct OneVsManyReader r;
+   r.ctx = &ctx;
+   r.pool = ThreadPool_Default();
+   atomic_init(&r.group.pending, 0);
+   r.max_pending = ONE_VS_MANY_PENDING_PER_THREAD * ThreadPool_Size(r.pool);
+   r.nrecords = 0;
+   r.current = NULL;
+   r.capacity = 0;
+   if (npaths == 0)
+      _OneVsMany_Read(&r, stdin, "-");
+   for (int k = 0; k < npaths; ++k)
+   {
+      if (!MappedFile_IsStream(paths[k]))
+      {
+         _OneVsMany_ReadFile(&r, paths[k]);
+         continue;
+      }
+      FILE *in = (strcmp(paths[k], "-") == 0) ? stdin : fopen(paths[k], "r");
+      if (in == NULL)
+         err(1, "open %s", paths[k]);
+      _OneVsMany_Read(&r, in, paths[k]);
+      if (in != stdin)
+         fclose(in);
+   }
+   ThreadPool_Wait(r.pool, &r.group);
+
+   pthread_cond_destroy(&ctx.done);
+   pthread_mutex_destroy(&ctx.lock);
+   if (ctx.profile != NULL)
+      NW_QueryProfile_Free(ctx.profile);
+   EncodedSequence_Free(&ctx.encoded);
+   MappedFile_Close(&ref);
+}
+
+void OneVsMany_Extend(const char *reference, const char *path, FILE *out)
+{
+   struct MappedFile ref;
+   char *seq;
+   long length;
+   _OneVsMany_LoadReference(reference, &ref, &seq, &length);
+   struct NW_Extension *ext = NW_Extension_Create(seq, length);
+   int fd = (path == NULL || strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+   if (fd == -1)
+      err(1, "open %s", path);
+   char *buffer = (char *)malloc(ONE_VS_MANY_EXTEND_BUFFER);
+   if (buffer == NULL)
+   {
+      perror("OneVsMany_Extend: malloc of buffer");
+      exit(EXIT_FAILURE);
+   }
+   int line_start = 1, comment = 0; // state of the comment lines, from a read to the next one
+   int first = 1;
+   for (;;)
+   { /* each read gives what the writer has written so far */
+      ssize_t n = read(fd, buffer, ONE_VS_MANY_EXTEND_BUFFER);
+      if (n < 0 && errno == EINTR)
+         continue;
+      if (n < 0)
+         err(1, "read %s", (path == NULL) ? "-" : path);
+      if (n == 0)
+         break;
+      if (first && (GzipFile_IsGzip(buffer, n) || (n >= 4 && memcmp(buffer, PACKED_STORE_MAGIC, 4) == 0)))
+         errx(1, "%s: gzip file or packed store, the growing sequence has to be FASTA text", (path == NULL) ? "-" : path);
+      first = 0;
+      size_t kept = 0; // the comment lines are removed in place
+      for (ssize_t k = 0; k < n; ++k)
+      {
+         char c = buffer[k];
+         if (line_start && c == '>')
+            comment = 1;
+         if (!comment)
+            buffer[kept++] = c;
+         line_start = (c == '\n');
+         if (line_start)
+            comment = 0;
+      }
+      size_t before = NW_Extension_Length(ext);
+      long distance = NW_Extension_Append(ext, buffer, kept);
+      if (NW_Extension_Length(ext) != before)
+      {
+         fprintf(out, "%zu\t%ld\n", NW_Extension_Length(ext), distance);
+         fflush(out);
+      }
+   }
+   if (fd != STDIN_FILENO)
+      close(fd);
+   free(buffer);
+   NW_Extension_Free(ext);
+   MappedFile_Close(&ref);
+}
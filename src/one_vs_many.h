@@ -0,0 +1,40 @@
+/**
+ * \file one_vs_many.h
+ * \brief one-vs-many mode: distances between a reference sequence and every record of a stream of FASTA records
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * The reference is encoded and profiled once (cf EditDistance_NW_Encoded); the records are read one after the other
+ * (eg from a pipe) and computed in parallel by the default pool of threads, each result being written as soon as it
+ * is known: the order of the output lines is the order of completion, each line giving the name of its record.
+ *
+ * The extension mode follows a single sequence that grows (eg a read being sequenced): each piece read from the
+ * stream is appended to the sequence and only its columns of the matrix are computed (cf NW_Extension_Append).
+ */
+
+#ifndef __ONE_VS_MANY_H__
+#define __ONE_VS_MANY_H__
+
+#include <stdio.h>
+#include "Needleman-Wunsch-recmemo.h"
+
+/**
+ * \fn void OneVsMany_Run(const char *reference, char **paths, int npaths, FILE *out, enum NW_Engine engine);
+ * \brief computes the distance between the first record of the FASTA file reference and every record of the FASTA files
+ * paths[0..npaths-1] ("-" or no file for stdin), with engine; writes on out one line "name<tab>distance" per record.
+ * The files are opened by Fasta_Open (gzip files and packed stores too), the streams have to be FASTA text.
+ * Exits with a message on error.
+ */
+void OneVsMany_Run(const char *reference, char **paths, int npaths, FILE *out, enum NW_Engine engine);
+
+/**
+ * \fn void OneVsMany_Extend(const char *reference, const char *path, FILE *out);
+ * \brief computes the distance between the first record of the FASTA file reference and the sequence read from the
+ * file path (NULL or "-" for stdin), updated after each read: writes on out one line "bases<tab>distance" each time
+ * bases are appended (the comment lines are ignored). The reference is opened by Fasta_Open; the file path has to be
+ * FASTA text.
+ * Exits with a message on error.
+ */
+void OneVsMany_Extend(const char *reference, const char *path, FILE *out);
+
+#endif /* __ONE_VS_MANY_H__ */
@@ -0,0 +1,566 @@
+/**
+ * \file packed_store.c
+ * \brief implementation of the packed store
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see packed_store.h
+ */
+
+#include "packed_store.h"
+#include <stdio.h>
+#include <string.h>
+#include <err.h>
+#include <pthread.h>
+#include <fcntl.h>  /* for open */
+#include <unistd.h> /* for pread */
+#include <sys/stat.h>
+#include "characters_to_base.h" /* for the codes */
+#include "fasta.h"
+#include "fasta_index.h" /* for FastaIndex_ParseRange */
+#include "thread_pool.h"
+
+/** \var static uint32_t _unpack[256]
+ * \brief _unpack[b] is the 4 codes (ADENINE..THYMINE, in the order of the memory) of the bases packed in the byte b
+ */
+static uint32_t _unpack[256];
+static pthread_once_t _unpack_once = PTHREAD_ONCE_INIT;
+
+static void _init_unpack(void)
+{
+   for (int b = 0; b < 256; ++b)
+   {
+      unsigned char codes[4];
+      for (int k = 0; k < 4; ++k)
+         codes[k] = (unsigned char)(ADENINE + ((b >> (2 * k)) & 3));
+      memcpy(&_unpack[b], codes, 4);
+   }
+}
+
+int PackedStore_IsPacked(const struct MappedFile *f)
+{
+   if (f->offset == 0)
+      return f->length >= (long)sizeof(struct PackedStoreHeader) && memcmp(f->data, PACKED_STORE_MAGIC, 4) == 0;
+   char magic[4]; /* the beginning of f is not mapped */
+   return f->size >= (long)sizeof(struct PackedStoreHeader) && pread(f->fd, magic, 4, 0) == 4 &&
+          memcmp(magic, PACKED_STORE_MAGIC, 4) == 0;
+}
+
+int PackedStore_IsPackedFile(const char *path)
+{
+   char magic[4];
+   int fd = open(path, O_RDONLY);
+   if (fd == -1)
+      return 0;
+   struct stat s;
+   int packed = fstat(fd, &s) == 0 && s.st_size >= (off_t)sizeof(struct PackedStoreHeader) &&
+                pread(fd, magic, 4, 0) == 4 && memcmp(magic, PACKED_STORE_MAGIC, 4) == 0;
+   close(fd);
+   return packed;
+}
+
+void PackedStore_Attach(const struct MappedFile *f, struct PackedStore *store)
+{
+   if (!PackedStore_IsPacked(f) || f->offset != 0 || f->length != f->size)
+      errx(1, "%s: not a packed store mapped from its beginning", f->path);
+   const struct PackedStoreHeader *h = (const struct PackedStoreHeader *)f->data;
+   uint64_t length = (uint64_t)f->length;
+   if (h->version != 1)
+      errx(1, "%s: version %u of packed store not supported", f->path, h->version);
+   if (h->length != length || h->nrecords > length / sizeof(struct PackedStoreRecord) ||
+       h->names_offset != sizeof(struct PackedStoreHeader) + h->nrecords * sizeof(struct PackedStoreRecord) ||
+       h->bases_offset < h->names_offset || h->bases_offset % 64 != 0 ||
+       h->exceptions_offset < h->bases_offset || h->exceptions_offset % 8 != 0 || h->exceptions_offset > length ||
+       h->nexceptions > (length - h->exceptions_offset) / sizeof(struct PackedStoreException))
+      errx(1, "%s: malformed packed store", f->path);
+   store->path = f->path;
+   store->header = h;
+   store->records = (const struct PackedStoreRecord *)(f->data + sizeof(struct PackedStoreHeader));
+   store->names = f->data + h->names_offset;
+   store->bases = (const unsigned char *)f->data + h->bases_offset;
+   store->exceptions = (const struct PackedStoreException *)(f->data + h->exceptions_offset);
+   for (uint64_t k = 0; k < h->nrecords; ++k)
+   {
+      const struct PackedStoreRecord *r = &store->records[k];
+      if (r->name_offset > h->bases_offset - h->names_offset ||
+          r->name_length > h->bases_offset - h->names_offset - r->name_offset ||
+          r->bases > h->exceptions_offset - h->bases_offset ||
+          (r->length + 3) / 4 > h->exceptions_offset - h->bases_offset - r->bases ||
+          r->first_exception > h->nexceptions || r->nexceptions > h->nexceptions - r->first_exception)
+         errx(1, "%s: malformed record %lu of packed store", f->path, (unsigned long)k);
+   }
+   for (uint64_t k = 0; k < h->nexceptions; ++k)
+   { /* the codes are indexes in the tables of the engines */
+      if (store->exceptions[k].code != URACILE && store->exceptions[k].code != UNKOWN_BASE)
+         errx(1, "%s: malformed exception %lu of packed store", f->path, (unsigned long)k);
+   }
+}
+
+const struct PackedStoreRecord *PackedStore_Find(const struct PackedStore *store, const char *name, size_t name_length)
+{
+   for (uint64_t k = 0; k < store->header->nrecords; ++k)
+   {
+      const struct PackedStoreRecord *r = &store->records[k];
+      if (r->name_length == name_length && memcmp(store->names + r->name_offset, name, name_length) == 0)
+         return r;
+   }
+   return NULL;
+}
+
+void PackedStore_Resolve(const struct PackedStore *store, const char *region, const struct PackedStoreRecord **record,
+                         long *start, long *length)
+{
+   size_t region_length = strlen(region);
+   const struct PackedStoreRecord *r = PackedStore_Find(store, region, region_length);
+   long first = 1, last = -1;
+   if (r == NULL)
+   { /* name:start-end or name:start */
+      const char *colon = strrchr(region, ':');
+      if (colon == NULL || (r = PackedStore_Find(store, region, colon - region)) == NULL)
+         errx(1, "%s: no record %.*s", store->path, (int)((colon != NULL) ? colon - region : (long)region_length), region);
+      if (!FastaIndex_ParseRange(colon + 1, &first, &last))
+         errx(1, "%s: expected name:start-end, name:start or name, got %s", store->path, region);
+   }
+   if (last < 0)
+      last = (long)r->length;
+   if (first < 1 || first > last + 1 || last > (long)r->length)
+      errx(1, "%s: region %s out of the %lu bases of record %.*s", store->path, region, (unsigned long)r->length,
+           (int)r->name_length, store->names + r->name_offset);
+   *record = r;
+   *start = first - 1;
+   *length = last - first + 1;
+}
+
+void PackedStore_Select(const struct PackedStore *store, long begin, long length, const struct PackedStoreRecord **record,
+                        long *seq_length)
+{
+   if (store->header->nrecords == 0 || begin < 0 || begin > (long)store->records[0].length)
+      errx(1, "%s: position %ld out of the first record", store->path, begin);
+   *record = &store->records[0];
+   long rest = (long)(*record)->length - begin;
+   if (length > rest)
+   {
+      fprintf(stderr, "Warning: given sequence length %ld exceeds end of record of %ld bases; "
+                      "sequence length is truncated to %ld.\n",
+              length, (long)(*record)->length, rest);
+      length = rest;
+   }
+   *seq_length = length;
+}
+
+void PackedStore_Decode(const struct PackedStore *store, const struct PackedStoreRecord *record, long start, long length,
+                        struct EncodedSequence *seq)
+{
+   pthread_once(&_unpack_once, _init_unpack);
+   EncodedSequence_Reserve(seq, length);
+   const unsigned char *bases = store->bases + record->bases;
+   unsigned char *out = seq->codes;
+   long i = start, end = start + length;
+   for (; i < end && (i & 3) != 0; ++i)
+      *out++ = (unsigned char)(ADENINE + ((bases[i >> 2] >> (2 * (i & 3))) & 3));
+   for (; i + 4 <= end; i += 4, out += 4)
+      memcpy(out, &_unpack[bases[i >> 2]], 4);
+   for (; i < end; ++i)
+      *out++ = (unsigned char)(ADENINE + ((bases[i >> 2] >> (2 * (i & 3))) & 3));
+
+   { /* The exceptions overlapping the range: the first one by binary search */
+      const struct PackedStoreException *e = store->exceptions + record->first_exception;
+      size_t lo = 0, hi = record->nexceptions;
+      while (lo < hi)
+      {
+         size_t mid = (lo + hi) / 2;
+         if ((long)(e[mid].start + e[mid].length) <= start)
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      for (; lo < record->nexceptions && (long)e[lo].start < end; ++lo)
+      {
+         long from = (long)e[lo].start > start ? (long)e[lo].start : start;
+         long to = (long)(e[lo].start + e[lo].length) < end ? (long)(e[lo].start + e[lo].length) : end;
+         if (to > from)
+            memset(seq->codes + (from - start), (int)e[lo].code, to - from);
+      }
+   }
+   seq->length = length;
+   seq->skipped = 0;
+   memset(seq->codes + length, SKIP_BASE, ENCODED_SEQUENCE_PADDING);
+}
+
+void PackedStore_DecodeFasta(const struct PackedStore *store, struct MappedFile *f)
+{
+   long length = 0;
+   for (uint64_t k = 0; k < store->header->nrecords; ++k) /* ">name\n", the bases and '\n' */
+      length += 3 + (long)store->records[k].name_length + (long)store->records[k].length;
+   f->data = (char *)malloc(length + 1);
+   f->path = strdup(store->path);
+   if (f->data == NULL || f->path == NULL)
+   {
+      perror("PackedStore_DecodeFasta: malloc of the text");
+      exit(EXIT_FAILURE);
+   }
+   struct EncodedSequence codes = ENCODED_SEQUENCE_EMPTY;
+   char *out = f->data;
+   for (uint64_t k = 0; k < store->header->nrecords; ++k)
+   {
+      const struct PackedStoreRecord *r = &store->records[k];
+      *out++ = '>';
+      memcpy(out, store->names + r->name_offset, r->name_length);
+      out += r->name_length;
+      *out++ = '\n';
+      PackedStore_Decode(store, r, 0, (long)r->length, &codes);
+      DecodeSequence(&codes, out);
+      out += r->length;
+      *out++ = '\n';
+   }
+   EncodedSequence_Free(&codes);
+   f->fd = -1;
+   f->length = length;
+   f->offset = 0;
+   f->size = length;
+}
+
+/** \struct PackedStoreExceptions
+ * \brief growing array of exceptions, while the store is written
+ */
+struct PackedStoreExceptions
+{
+   struct PackedStoreException *runs; /*!< runs[0..count-1] */
+   size_t count;                      /*!< number of runs */
+   size_t capacity;                   /*!< allocated number of elements of runs */
+};
+
+static void _PackedStore_AddException(struct PackedStoreExceptions *exceptions, uint64_t start, uint32_t length,
+                                      unsigned char code)
+{
+   if (exceptions->count == exceptions->capacity)
+   {
+      exceptions->capacity = (exceptions->capacity == 0) ? 64 : 2 * exceptions->capacity;
+      exceptions->runs = (struct PackedStoreException *)realloc(exceptions->runs,
+                                                                exceptions->capacity * sizeof(struct PackedStoreException));
+      if (exceptions->runs == NULL)
+      {
+         perror("PackedStore_Write: realloc of exceptions");
+         exit(EXIT_FAILURE);
+      }
+   }
+   struct PackedStoreException *e = &exceptions->runs[exceptions->count++];
+   e->start = start;
+   e->length = length;
+   e->code = code;
+}
+
+/** \def PACKED_STORE_CHUNK
+ * \brief number of characters of FASTA text encoded and packed by a task of the converter
+ */
+#define PACKED_STORE_CHUNK (1L << 20)
+
+/** \def PACKED_STORE_CHUNKS_PER_THREAD
+ * \brief number of chunks converted in a wave, per thread: bounds the memory of the converter
+ */
+#define PACKED_STORE_CHUNKS_PER_THREAD 4
+
+/** \struct PackedStoreChunk
+ * \brief task of the converter: a part of the sequence of a record, encoded, then packed
+ */
+struct PackedStoreChunk
+{
+   const char *text;                        /*!< the characters of the part, in the mapped FASTA file */
+   long text_length;                        /*!< number of characters */
+   struct EncodedSequence seq;              /*!< codes of the part (the buffer is reused from a wave to the next) */
+   uint64_t start;                          /*!< position of the first base of the part in its record */
+   unsigned char *packed;                   /*!< bytes of the bases start..start+seq.length-1 of the record */
+   size_t packed_capacity;                  /*!< allocated number of bytes of packed */
+   struct PackedStoreExceptions exceptions; /*!< runs of U and N of the part, positions in the record */
+};
+
+static void _PackedStore_EncodeChunk(void *arg)
+{ /* each character that is not a base is checked by ManageBaseError, cf BASE_ERROR_TREATMENT */
+   struct PackedStoreChunk *chunk = (struct PackedStoreChunk *)arg;
+   ReencodeSequence(chunk->text, chunk->text_length, &chunk->seq);
+}
+
+/*
+ * \brief packs the codes of chunk from the bit of its position start in its byte, and lists its runs of U and N
+ * The bits of the byte before start (resp. after the last base) are 0 in packed[0] (resp. in the last byte).
+ */
+static void _PackedStore_PackChunk(void *arg)
+{
+   struct PackedStoreChunk *chunk = (struct PackedStoreChunk *)arg;
+   const unsigned char *codes = chunk->seq.codes;
+   size_t n = chunk->seq.length, shift = chunk->start & 3;
+   size_t bytes = (shift + n + 3) / 4;
+   if (bytes > chunk->packed_capacity)
+   {
+      free(chunk->packed);
+      chunk->packed_capacity = bytes;
+      chunk->packed = (unsigned char *)malloc(bytes);
+      if (chunk->packed == NULL)
+      {
+         perror("PackedStore_Write: malloc of packed bases");
+         exit(EXIT_FAILURE);
+      }
+   }
+   unsigned char *out = chunk->packed;
+   size_t i = 0;
+   if (shift != 0)
+   { /* first byte, shared with the previous chunk */
+      unsigned char b = 0;
+      for (size_t k = shift; k < 4 && i < n; ++k, ++i)
+         b |= (unsigned char)(((codes[i] - ADENINE) & 3) << (2 * k));
+      *out++ = b;
+   }
+   for (; i + 4 <= n; i += 4)
+   { /* (code - ADENINE) & 3: the exceptions are overwritten by the decoding, their bits do not matter */
+      *out++ = (unsigned char)(((codes[i] - ADENINE) & 3) | (((codes[i + 1] - ADENINE) & 3) << 2) |
+                               (((codes[i + 2] - ADENINE) & 3) << 4) | (((codes[i + 3] - ADENINE) & 3) << 6));
+   }
+   if (i < n)
+   { /* last byte, shared with the next chunk */
+      unsigned char b = 0;
+      for (size_t k = 0; i < n; ++k, ++i)
+         b |= (unsigned char)(((codes[i] - ADENINE) & 3) << (2 * k));
+      *out++ = b;
+   }
+
+   chunk->exceptions.count = 0;
+   for (i = 0; i < n;)
+   {
+      if (i + 8 <= n)
+      { /* 8 codes at a time: the codes are <= UNKOWN_BASE, adding 0x7B sets the bit 7 of URACILE and UNKOWN_BASE only */
+         uint64_t word;
+         memcpy(&word, codes + i, 8);
+         if (((word + 0x7B7B7B7B7B7B7B7BULL) & 0x8080808080808080ULL) == 0)
+         {
+            i += 8;
+            continue;
+         }
+      }
+      if (codes[i] < URACILE)
+      {
+         ++i;
+         continue;
+      }
+      size_t j = i + 1;
+      while (j < n && codes[j] == codes[i] && j - i < UINT32_MAX)
+         ++j;
+      _PackedStore_AddException(&chunk->exceptions, chunk->start + i, (uint32_t)(j - i), codes[i]);
+      i = j;
+   }
+}
+
+/*
+ * \brief writes n bytes 0 on out
+ */
+static void _PackedStore_Pad(FILE *out, long n)
+{
+   static const char zeros[64];
+   if (n > 0)
+      fwrite(zeros, 1, n, out);
+}
+
+/** \struct PackedStoreWriter
+ * \brief the bases written in the store, a byte being pending while the next chunk can complete it
+ */
+struct PackedStoreWriter
+{
+   FILE *out;                               /*!< the store */
+   uint64_t offset;                         /*!< number of bytes of bases written */
+   int pending;                             /*!< if not 0, the byte last is not written yet */
+   unsigned char last;                      /*!< the last byte of the previous chunk */
+   struct PackedStoreExceptions exceptions; /*!< all the exceptions */
+};
+
+/*
+ * \brief appends to the store the chunk, the first one of its record if first, the last one if last
+ */
+static void _PackedStore_WriteChunk(struct PackedStoreWriter *w, const struct PackedStoreChunk *chunk, int first, int last)
+{
+   size_t n = chunk->seq.length, shift = chunk->start & 3;
+   size_t bytes = (shift + n + 3) / 4;
+   const unsigned char *packed = chunk->packed;
+   if (first)
+      w->pending = 0;
+   if (bytes > 0 && w->pending && shift != 0)
+   { /* the pending byte is completed by the first bases of the chunk */
+      unsigned char b = (unsigned char)(w->last | packed[0]);
+      w->pending = 0;
+      if (bytes == 1 && (shift + n) % 4 != 0)
+      { /* still incomplete */
+         w->last = b;
+         w->pending = 1;
+      }
+      else
+      {
+         fputc(b, w->out);
+         w->offset++;
+      }
+      packed++;
+      bytes--;
+   }
+   if (bytes > 0)
+   {
+      int incomplete = (shift + n) % 4 != 0; /* last byte completed by the next chunk */
+      fwrite(packed, 1, bytes - incomplete, w->out);
+      w->offset += bytes - incomplete;
+      if (incomplete)
+      {
+         w->last = packed[bytes - 1];
+         w->pending = 1;
+      }
+   }
+   if (last && w->pending)
+   {
+      fputc(w->last, w->out);
+      w->offset++;
+      w->pending = 0;
+   }
+   for (size_t k = 0; k < chunk->exceptions.count; ++k)
+   { /* a run continued from the previous chunk is merged */
+      const struct PackedStoreException *e = &chunk->exceptions.runs[k];
+      struct PackedStoreException *prev = (w->exceptions.count > 0) ? &w->exceptions.runs[w->exceptions.count - 1] : NULL;
+      if (!first && k == 0 && prev != NULL && prev->code == e->code && prev->start + prev->length == e->start &&
+          (uint64_t)prev->length + e->length <= UINT32_MAX)
+         prev->length += e->length;
+      else
+         _PackedStore_AddException(&w->exceptions, e->start, e->length, (unsigned char)e->code);
+   }
+}
+
+void PackedStore_Write(char **paths, int npaths, const char *store_path)
+{
+   struct MappedFileCache files = MAPPED_FILE_CACHE_INIT;
+   struct FastaRecords fasta = FASTA_RECORDS_INIT;
+   for (int k = 0; k < npaths; ++k)
+      Fasta_Parse(MappedFileCache_Get(&files, paths[k]), &fasta);
+   size_t n = fasta.count;
+
+   struct PackedStoreHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, PACKED_STORE_MAGIC, 4);
+   header.version = 1;
+   header.nrecords = n;
+   header.names_offset = sizeof(struct PackedStoreHeader) + n * sizeof(struct PackedStoreRecord);
+   struct PackedStoreRecord *records = (struct PackedStoreRecord *)calloc(n + 1, sizeof(struct PackedStoreRecord));
+   if (records == NULL)
+   {
+      perror("PackedStore_Write: malloc of records");
+      exit(EXIT_FAILURE);
+   }
+   FILE *out = fopen(store_path, "w");
+   if (out == NULL)
+      err(1, "open %s", store_path);
+
+   { /* The names, after the header and the records written at the end */
+      if (fseek(out, (long)header.names_offset, SEEK_SET) != 0)
+         err(1, "write %s", store_path);
+      uint64_t offset = 0;
+      for (size_t k = 0; k < n; ++k)
+      {
+         char name[32];
+         const char *s = fasta.records[k].name;
+         size_t length = fasta.records[k].name_length;
+         if (length == 0)
+         {
+            length = sprintf(name, "record%zu", k);
+            s = name;
+         }
+         fwrite(s, 1, length, out);
+         records[k].name_offset = offset;
+         records[k].name_length = length;
+         offset += length;
+      }
+      header.bases_offset = (header.names_offset + offset + 63) / 64 * 64;
+      _PackedStore_Pad(out, (long)(header.bases_offset - header.names_offset - offset));
+   }
+
+   struct PackedStoreWriter w = {out, 0, 0, 0, {NULL, 0, 0}};
+   { /* The bases, by waves of chunks encoded then packed in parallel, written in order */
+      struct ThreadPool *pool = ThreadPool_Default();
+      size_t nchunks = PACKED_STORE_CHUNKS_PER_THREAD * (size_t)ThreadPool_Size(pool);
+      struct PackedStoreChunk *chunks = (struct PackedStoreChunk *)calloc(nchunks, sizeof(struct PackedStoreChunk));
+      int *first = (int *)malloc(nchunks * sizeof(int));
+      if (chunks == NULL || first == NULL)
+      {
+         perror("PackedStore_Write: malloc of chunks");
+         exit(EXIT_FAILURE);
+      }
+      size_t record = 0; /* next part to convert: fasta.records[record].seq + position */
+      long position = 0;
+      uint64_t bases = 0; /* number of bases of the record before position */
+      while (record < n)
+      {
+         size_t count = 0;
+         struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+         size_t wave_record = record; /* records ending in the wave: record..wave_last-1 */
+         while (count < nchunks && record < n)
+         {
+            const struct FastaRecord *r = &fasta.records[record];
+            struct PackedStoreChunk *chunk = &chunks[count];
+            first[count] = position == 0;
+            chunk->text = r->seq + position;
+            chunk->text_length = (r->length - position < PACKED_STORE_CHUNK) ? r->length - position : PACKED_STORE_CHUNK;
+            ThreadPool_Submit(pool, &group, _PackedStore_EncodeChunk, chunk);
+            ++count;
+            position += chunk->text_length;
+            if (position == r->length)
+            {
+               ++record;
+               position = 0;
+            }
+         }
+         ThreadPool_Wait(pool, &group);
+         for (size_t k = 0; k < count; ++k)
+         { /* positions of the chunks in their records */
+            if (first[k])
+               bases = 0;
+            chunks[k].start = bases;
+            bases += chunks[k].seq.length;
+         }
+         for (size_t k = 0; k < count; ++k)
+            ThreadPool_Submit(pool, &group, _PackedStore_PackChunk, &chunks[k]);
+         ThreadPool_Wait(pool, &group);
+         for (size_t k = 0; k < count; ++k)
+         {
+            int last = (k + 1 < count) ? first[k + 1] : (position == 0);
+            if (first[k])
+            {
+               records[wave_record].bases = w.offset;
+               records[wave_record].first_exception = w.exceptions.count;
+            }
+            _PackedStore_WriteChunk(&w, &chunks[k], first[k], last);
+            if (last)
+            {
+               records[wave_record].length = chunks[k].start + chunks[k].seq.length;
+               records[wave_record].nexceptions = w.exceptions.count - records[wave_record].first_exception;
+               ++wave_record;
+            }
+         }
+      }
+      for (size_t k = 0; k < nchunks; ++k)
+      {
+         EncodedSequence_Free(&chunks[k].seq);
+         free(chunks[k].packed);
+         free(chunks[k].exceptions.runs);
+      }
+      free(chunks);
+      free(first);
+      header.exceptions_offset = (header.bases_offset + w.offset + 7) / 8 * 8;
+      _PackedStore_Pad(out, (long)(header.exceptions_offset - header.bases_offset - w.offset));
+   }
+   fwrite(w.exceptions.runs, sizeof(struct PackedStoreException), w.exceptions.count, out);
+   header.nexceptions = w.exceptions.count;
+   header.length = header.exceptions_offset + w.exceptions.count * sizeof(struct PackedStoreException);
+
+   if (fseek(out, 0, SEEK_SET) != 0)
+      err(1, "write %s", store_path);
+   fwrite(&header, sizeof(header), 1, out);
+   fwrite(records, sizeof(struct PackedStoreRecord), n, out);
+   if (ferror(out) || fclose(out) != 0)
+      err(1, "write %s", store_path);
+
+   free(w.exceptions.runs);
+   free(records);
+   FastaRecords_Free(&fasta);
+   MappedFileCache_Close(&files);
+}
@@ -0,0 +1,154 @@
+/**
+ * \file packed_store.h
+ * \brief packed store: the records of FASTA files converted once into 2 bits per base, mapped in virtual memory
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * A text FASTA file costs one byte per base, plus the ends of lines and the headers, and has to be scanned to find a
+ * base. A packed store keeps only the bases (the characters that are not bases are removed, as the engines do), 4 per
+ * byte: A, C, G, T are coded 0..3; the runs of U and N are listed apart as exceptions (their bits are not significant).
+ * A range of bases is then decoded in O(length) directly into the codes of the engines (cf sequence_encoding.h),
+ * without any scan.
+ *
+ * Format (integers in the byte order of the machine; the store is not portable between byte orders):
+ *    struct PackedStoreHeader, at position 0;
+ *    nrecords struct PackedStoreRecord;
+ *    the names of the records (not null terminated);
+ *    the bases of the records, each record starting on a byte, base i in the bits 2(i%4)..2(i%4)+1 of byte i/4,
+ *    at position bases_offset (multiple of 64);
+ *    nexceptions struct PackedStoreException sorted by record then position, at position exceptions_offset.
+ */
+
+#ifndef __PACKED_STORE_H__
+#define __PACKED_STORE_H__
+
+#include <stdint.h>
+#include "mapped_file.h"
+#include "sequence_encoding.h"
+
+/** \def PACKED_STORE_MAGIC
+ * \brief first 4 bytes of a packed store
+ */
+#define PACKED_STORE_MAGIC "NWPK"
+
+/**
+ * \struct PackedStoreHeader
+ * \brief header of a packed store
+ */
+struct PackedStoreHeader
+{
+   char magic[4];              /*!< PACKED_STORE_MAGIC */
+   uint32_t version;           /*!< 1 */
+   uint64_t nrecords;          /*!< number of records */
+   uint64_t names_offset;      /*!< position of the names */
+   uint64_t bases_offset;      /*!< position of the bases */
+   uint64_t exceptions_offset; /*!< position of the exceptions */
+   uint64_t nexceptions;       /*!< number of exceptions */
+   uint64_t length;            /*!< length of the store, in bytes */
+};
+
+/**
+ * \struct PackedStoreRecord
+ * \brief a record of a packed store
+ */
+struct PackedStoreRecord
+{
+   uint64_t name_offset;     /*!< position of the name from names_offset */
+   uint64_t name_length;     /*!< number of characters of the name */
+   uint64_t length;          /*!< number of bases */
+   uint64_t bases;           /*!< position of the first base from bases_offset, in bytes */
+   uint64_t first_exception; /*!< index of the first exception of the record */
+   uint64_t nexceptions;     /*!< number of exceptions of the record */
+};
+
+/**
+ * \struct PackedStoreException
+ * \brief a run of bases of a record that are not A, C, G or T
+ */
+struct PackedStoreException
+{
+   uint64_t start;  /*!< first base of the run, in the record */
+   uint32_t length; /*!< number of bases of the run (a longer run is split) */
+   uint32_t code;   /*!< URACILE or UNKOWN_BASE */
+};
+
+/**
+ * \struct PackedStore
+ * \brief a packed store mapped in virtual memory: pointers in the mapped file
+ */
+struct PackedStore
+{
+   const char *path;                              /*!< pathname of the store */
+   const struct PackedStoreHeader *header;        /*!< the header */
+   const struct PackedStoreRecord *records;       /*!< records[0..header->nrecords-1] */
+   const char *names;                             /*!< the names */
+   const unsigned char *bases;                    /*!< the bases */
+   const struct PackedStoreException *exceptions; /*!< exceptions[0..header->nexceptions-1] */
+};
+
+/**
+ * \fn int PackedStore_IsPacked(const struct MappedFile *f);
+ * \brief returns not 0 if f is a packed store (starts by PACKED_STORE_MAGIC), even if only a range of f is mapped
+ */
+int PackedStore_IsPacked(const struct MappedFile *f);
+
+/**
+ * \fn int PackedStore_IsPackedFile(const char *path);
+ * \brief returns not 0 if the file path is a packed store, read before it is mapped (cf GzipFile_IsGzipFile)
+ */
+int PackedStore_IsPackedFile(const char *path);
+
+/**
+ * \fn void PackedStore_Attach(const struct MappedFile *f, struct PackedStore *store);
+ * \brief makes store point in the packed store f (valid while f is mapped), that has to be mapped whole (by
+ * MappedFile_Open); exits with a message if f is malformed
+ */
+void PackedStore_Attach(const struct MappedFile *f, struct PackedStore *store);
+
+/**
+ * \fn const struct PackedStoreRecord *PackedStore_Find(const struct PackedStore *store, const char *name, size_t name_length);
+ * \brief returns the record name[0..name_length-1] of store (the first one if several have that name), or NULL
+ */
+const struct PackedStoreRecord *PackedStore_Find(const struct PackedStore *store, const char *name, size_t name_length);
+
+/**
+ * \fn void PackedStore_Resolve(const struct PackedStore *store, const char *region, const struct PackedStoreRecord **record, long *start, long *length);
+ * \brief converts region (record:start-end, record:start or record, cf fasta_index.h) to its record, the position start
+ * of its first base (counted from 0) and its number length of bases. Exits with a message if region is not in store.
+ */
+void PackedStore_Resolve(const struct PackedStore *store, const char *region, const struct PackedStoreRecord **record,
+                         long *start, long *length);
+
+/**
+ * \fn void PackedStore_Select(const struct PackedStore *store, long begin, long length, const struct PackedStoreRecord **record, long *seq_length);
+ * \brief selects the length bases from the base begin of the first record of store, as MappedFile_Select in a FASTA
+ * file: exits with a message if begin exceeds the record, truncates length (with a warning on stderr) to its end
+ * \param record : receives the first record
+ * \param seq_length : receives the (possibly truncated) number of bases
+ */
+void PackedStore_Select(const struct PackedStore *store, long begin, long length, const struct PackedStoreRecord **record,
+                        long *seq_length);
+
+/**
+ * \fn void PackedStore_Decode(const struct PackedStore *store, const struct PackedStoreRecord *record, long start, long length, struct EncodedSequence *seq);
+ * \brief decodes the bases start..start+length-1 of record in seq (as ReencodeSequence: the codes of seq are reused
+ * if they are large enough)
+ */
+void PackedStore_Decode(const struct PackedStore *store, const struct PackedStoreRecord *record, long start, long length,
+                        struct EncodedSequence *seq);
+
+/**
+ * \fn void PackedStore_DecodeFasta(const struct PackedStore *store, struct MappedFile *f);
+ * \brief makes f (in memory, to be closed by MappedFile_Close) the FASTA text of the records of store, a header line
+ * then a line of bases (uppercase) per record, for the modes that read records as text (cf Fasta_Open)
+ */
+void PackedStore_DecodeFasta(const struct PackedStore *store, struct MappedFile *f);
+
+/**
+ * \fn void PackedStore_Write(char **paths, int npaths, const char *store_path);
+ * \brief converts the records of the FASTA files paths[0..npaths-1] into the packed store store_path (the records
+ * without a name are called record0, record1... by their rank). Exits with a message on error.
+ */
+void PackedStore_Write(char **paths, int npaths, const char *store_path);
+
+#endif /* __PACKED_STORE_H__ */
@@ -0,0 +1,159 @@
+/**
+ * \file sequence_encoding.c
+ * \brief implementation of the encoding of sequences into base codes
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see sequence_encoding.h
+ */
+
+#include "sequence_encoding.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h> /* for isspace in ManageBaseError */
+#include <pthread.h>
+#include "characters_to_base.h" /* mapping from char to base */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENCODING_SIMD_X86 /* the SSE4.1 kernel is compiled, and selected at runtime from the cpu features */
+#endif
+
+/** \var static unsigned char _pack_shuffle[256][8]
+ * \brief _pack_shuffle[mask] gives the indices of the bits set in mask (then 0x80): shuffling 8 bytes with it
+ * packs the bytes selected by mask at the beginning
+ */
+static unsigned char _pack_shuffle[256][8];
+
+static pthread_once_t _encoding_once = PTHREAD_ONCE_INIT;
+
+static void _init_encoding(void)
+{
+   _init_base_match();
+   for (int mask = 0; mask < 256; ++mask)
+   {
+      int n = 0;
+      for (int bit = 0; bit < 8; ++bit)
+         if (mask & (1 << bit))
+            _pack_shuffle[mask][n++] = (unsigned char)bit;
+      while (n < 8)
+         _pack_shuffle[mask][n++] = 0x80;
+   }
+}
+
+/*
+ * \brief encodes S[0..length-1] in codes one character at a time; returns the number of bases written
+ */
+static size_t _EncodeScalar(const char *S, size_t length, unsigned char *codes)
+{
+   size_t n = 0;
+   for (size_t k = 0; k < length; ++k)
+   {
+      enum Base b = CharToBase((unsigned char)S[k]);
+      if (b == SKIP_BASE)
+         ManageBaseError(S[k]);
+      else
+         codes[n++] = (unsigned char)b;
+   }
+   return n;
+}
+
+#ifdef ENCODING_SIMD_X86
+/*
+ * \brief encodes S[0..length-1] in codes 16 characters at a time; returns the number of bases written
+ * codes must have 16 bytes of slack after the last base.
+ *
+ * The low nibbles of 'a', 'c', 'g', 't', 'u', 'n' (1, 3, 7, 4, 5, 14) are distinct: a character c is a base iff
+ * (c | 0x20), the lower case of c, is the base letter expected for its low nibble; the code is then looked up
+ * by the same nibble. The codes of the bases of each group of 8 characters are packed by a shuffle.
+ */
+__attribute__((target("sse4.1,popcnt"))) static size_t _EncodeSse41(const char *S, size_t length, unsigned char *codes)
+{
+   const __m128i letters = _mm_setr_epi8(0, 'a', 0, 'c', 't', 'u', 0, 'g', 0, 0, 0, 0, 0, 0, 'n', 0);
+   const __m128i bases = _mm_setr_epi8(SKIP_BASE, ADENINE, SKIP_BASE, CYTOSINE, THYMINE, URACILE, SKIP_BASE, GUANINE,
+                                       SKIP_BASE, SKIP_BASE, SKIP_BASE, SKIP_BASE, SKIP_BASE, SKIP_BASE, UNKOWN_BASE, SKIP_BASE);
+   unsigned char *out = codes;
+   size_t k = 0;
+   for (; k + 16 <= length; k += 16)
+   {
+      __m128i c = _mm_loadu_si128((const __m128i *)(S + k));
+      __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+      __m128i nibble = _mm_and_si128(lower, _mm_set1_epi8(0x0F));
+      __m128i valid = _mm_cmpeq_epi8(lower, _mm_shuffle_epi8(letters, nibble));
+      __m128i code = _mm_and_si128(_mm_shuffle_epi8(bases, nibble), valid);
+      unsigned mask = (unsigned)_mm_movemask_epi8(valid);
+      if (mask == 0xFFFF)
+      { /* 16 bases: the usual case inside a FASTA line */
+         _mm_storeu_si128((__m128i *)out, code);
+         out += 16;
+         continue;
+      }
+      unsigned lo = mask & 0xFF, hi = mask >> 8;
+      __m128i shuffle_lo = _mm_loadl_epi64((const __m128i *)_pack_shuffle[lo]);
+      __m128i shuffle_hi = _mm_add_epi8(_mm_loadl_epi64((const __m128i *)_pack_shuffle[hi]), _mm_set1_epi8(8));
+      _mm_storel_epi64((__m128i *)out, _mm_shuffle_epi8(code, shuffle_lo));
+      out += __builtin_popcount(lo);
+      _mm_storel_epi64((__m128i *)out, _mm_shuffle_epi8(code, shuffle_hi));
+      out += __builtin_popcount(hi);
+#ifdef BASE_ERROR_TREATMENT
+      for (int bit = 0; bit < 16; ++bit)
+         if (!(mask & (1u << bit)))
+            ManageBaseError(S[k + bit]);
+#endif
+   }
+   out += _EncodeScalar(S + k, length - k, out);
+   return (size_t)(out - codes);
+}
+#endif /* ENCODING_SIMD_X86 */
+
+void EncodeSequence(const char *S, size_t length, struct EncodedSequence *seq)
+{
+   seq->codes = NULL;
+   seq->capacity = 0;
+   ReencodeSequence(S, length, seq);
+}
+
+void EncodedSequence_Reserve(struct EncodedSequence *seq, size_t length)
+{
+   if (seq->codes == NULL || seq->capacity < length)
+   { /* 16 bytes of slack for the 8 bytes stores of the packed codes, included in the padding */
+      free(seq->codes);
+      seq->codes = (unsigned char *)malloc(length + ENCODED_SEQUENCE_PADDING);
+      if (seq->codes == NULL)
+      {
+         perror("EncodeSequence: malloc of codes");
+         exit(EXIT_FAILURE);
+      }
+      seq->capacity = length;
+   }
+}
+
+void ReencodeSequence(const char *S, size_t length, struct EncodedSequence *seq)
+{
+   pthread_once(&_encoding_once, _init_encoding);
+   EncodedSequence_Reserve(seq, length);
+#ifdef ENCODING_SIMD_X86
+   if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt"))
+      seq->length = _EncodeSse41(S, length, seq->codes);
+   else
+#endif
+      seq->length = _EncodeScalar(S, length, seq->codes);
+   seq->skipped = length - seq->length;
+   memset(seq->codes + seq->length, SKIP_BASE, ENCODED_SEQUENCE_PADDING);
+}
+
+void DecodeSequence(const struct EncodedSequence *seq, char *S)
+{
+   static const char bases[] = {[SKIP_BASE] = ' ', [ADENINE] = 'A', [CYTOSINE] = 'C', [GUANINE] = 'G',
+                                [THYMINE] = 'T', [URACILE] = 'U', [UNKOWN_BASE] = 'N'};
+   for (size_t i = 0; i < seq->length; ++i)
+      S[i] = bases[seq->codes[i]];
+}
+
+void EncodedSequence_Free(struct EncodedSequence *seq)
+{
+   free(seq->codes);
+   seq->codes = NULL;
+   seq->length = 0;
+   seq->capacity = 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * \file sequence_encoding.h
+ * \brief encoding of a genetic sequence (array of char, eg a range of a FASTA file) into a dense array of base codes
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * The characters that do not match a base (SKIP_BASE, eg '\n') cost 0 in the edit distance, so they can be removed
+ * once before the O(M*N) computation: the engines then work on arrays of enum Base codes (ADENINE .. UNKOWN_BASE,
+ * 3 bits stored in one byte) with branch-free inner loops.
+ */
+
+#ifndef __SEQUENCE_ENCODING_H__
+#define __SEQUENCE_ENCODING_H__
+
+#include <stdlib.h> /* for size_t */
+
+/** \def ENCODED_SEQUENCE_PADDING
+ * \brief number of bytes equal to SKIP_BASE after the codes of an encoded sequence, so that vector loads may overrun its end
+ */
+#define ENCODED_SEQUENCE_PADDING 64
+
+/**
+ * \struct EncodedSequence
+ * \brief the bases of a sequence as codes of enum Base, the skipped characters being removed
+ */
+struct EncodedSequence
+{
+   unsigned char *codes; /*!< codes[0..length-1] in ADENINE..UNKOWN_BASE, followed by ENCODED_SEQUENCE_PADDING bytes SKIP_BASE */
+   size_t length;        /*!< number of bases (known or unknown) */
+   size_t skipped;       /*!< number of characters removed because they are not bases */
+   size_t capacity;      /*!< number of bases that fit in codes (padding excluded) */
+};
+
+/** \def ENCODED_SEQUENCE_EMPTY
+ * \brief initial value of a struct EncodedSequence that owns no codes, to be passed to ReencodeSequence
+ */
+#define ENCODED_SEQUENCE_EMPTY {NULL, 0, 0, 0}
+
+/**
+ * \fn void EncodeSequence(const char *S, size_t length, struct EncodedSequence *seq);
+ * \brief encodes S[0..length-1] in seq, whose codes are allocated and have to be freed by EncodedSequence_Free
+ *
+ * The characters are classified 16 at a time (SSE4.1) when available; each non base character is passed
+ * to ManageBaseError (cf characters_to_base.h).
+ */
+void EncodeSequence(const char *S, size_t length, struct EncodedSequence *seq);
+
+/**
+ * \fn void ReencodeSequence(const char *S, size_t length, struct EncodedSequence *seq);
+ * \brief as EncodeSequence, but reuses the codes of seq (from EncodeSequence, ReencodeSequence or ENCODED_SEQUENCE_EMPTY)
+ * when they are large enough: encoding many sequences in the same seq allocates only when the length grows
+ */
+void ReencodeSequence(const char *S, size_t length, struct EncodedSequence *seq);
+
+/**
+ * \fn void EncodedSequence_Reserve(struct EncodedSequence *seq, size_t length);
+ * \brief makes the codes of seq (from EncodeSequence, ReencodeSequence or ENCODED_SEQUENCE_EMPTY) large enough for
+ * length bases and their padding, reusing them if they are; for the producers of codes other than the encoding
+ */
+void EncodedSequence_Reserve(struct EncodedSequence *seq, size_t length);
+
+/**
+ * \fn void DecodeSequence(const struct EncodedSequence *seq, char *S);
+ * \brief writes in S[0..seq->length-1] the characters (uppercase) of the bases of seq: EncodeSequence(S) gives seq back
+ */
+void DecodeSequence(const struct EncodedSequence *seq, char *S);
+
+/**
+ * \fn void EncodedSequence_Free(struct EncodedSequence *seq);
+ * \brief frees the codes of seq
+ */
+void EncodedSequence_Free(struct EncodedSequence *seq);
+
+#endif /* __SEQUENCE_ENCODING_H__ */
@@ -0,0 +1,162 @@
+/**
+ * \file stream_reader.c
+ * \brief implementation of the double-buffered reader of a stream
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see stream_reader.h
+ */
+
+#include "stream_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <pthread.h>
+#include <unistd.h> /* for read */
+
+/**
+ * \struct StreamReader
+ * \brief the two buffers, filled in turn by the thread and emptied in the same order by the caller
+ */
+struct StreamReader
+{
+   int fd;                /*!< the stream */
+   char *name;            /*!< its name, for the messages (malloc allocated) */
+   pthread_t thread;      /*!< the thread that reads the stream */
+   pthread_mutex_t lock;  /*!< protects the fields below */
+   pthread_cond_t cond;   /*!< signaled when a buffer is filled or emptied */
+   char *buffers[2];      /*!< the buffers of STREAM_READER_BLOCK bytes */
+   long lengths[2];       /*!< number of bytes read in buffers[k] */
+   int full[2];           /*!< if buffers[k] is filled, and not yet released by the caller */
+   int last[2];           /*!< if buffers[k] is the last block of the stream */
+   int error;             /*!< errno of the failed read (0 if none), at the last block */
+   unsigned long next;    /*!< number of blocks given to the caller */
+   int ended;             /*!< if the last block has been given to the caller */
+};
+
+/**
+ * \fn static void _StreamReader_Unlock(void *lock);
+ * \brief releases lock when the thread is cancelled while waiting (cf StreamReader_Close)
+ */
+static void _StreamReader_Unlock(void *lock)
+{
+   pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+/**
+ * \fn static void *_StreamReader_Thread(void *arg);
+ * \brief fills the buffers in turn up to the end of the stream; a buffer is filled when it is full or at the end
+ */
+static void *_StreamReader_Thread(void *arg)
+{
+   struct StreamReader *reader = (struct StreamReader *)arg;
+   for (unsigned long k = 0;; ++k)
+   {
+      int b = (int)(k & 1);
+      pthread_mutex_lock(&reader->lock);
+      pthread_cleanup_push(_StreamReader_Unlock, &reader->lock);
+      while (reader->full[b])
+         pthread_cond_wait(&reader->cond, &reader->lock);
+      pthread_cleanup_pop(1);
+
+      long n = 0;
+      int error = 0, end = 0;
+      while (n < STREAM_READER_BLOCK && !end) /* read is a cancellation point */
+      {
+         ssize_t r = read(reader->fd, reader->buffers[b] + n, (size_t)(STREAM_READER_BLOCK - n));
+         if (r > 0)
+            n += (long)r;
+         else if (r == 0)
+            end = 1;
+         else if (errno != EINTR)
+         {
+            error = errno;
+            end = 1;
+         }
+      }
+
+      pthread_mutex_lock(&reader->lock);
+      reader->lengths[b] = n;
+      reader->last[b] = end;
+      reader->error = error;
+      reader->full[b] = 1;
+      pthread_cond_broadcast(&reader->cond);
+      pthread_mutex_unlock(&reader->lock);
+      if (end)
+         return NULL;
+   }
+}
+
+struct StreamReader *StreamReader_Open(int fd, const char *name)
+{
+   struct StreamReader *reader = (struct StreamReader *)calloc(1, sizeof(struct StreamReader));
+   if (reader == NULL)
+   {
+      perror("StreamReader_Open: calloc of reader");
+      exit(EXIT_FAILURE);
+   }
+   reader->fd = fd;
+   reader->name = strdup(name);
+   reader->buffers[0] = (char *)malloc(STREAM_READER_BLOCK);
+   reader->buffers[1] = (char *)malloc(STREAM_READER_BLOCK);
+   if (reader->name == NULL || reader->buffers[0] == NULL || reader->buffers[1] == NULL)
+   {
+      perror("StreamReader_Open: malloc of buffers");
+      exit(EXIT_FAILURE);
+   }
+   pthread_mutex_init(&reader->lock, NULL);
+   pthread_cond_init(&reader->cond, NULL);
+   if (pthread_create(&reader->thread, NULL, _StreamReader_Thread, reader) != 0)
+   {
+      perror("StreamReader_Open: pthread_create");
+      exit(EXIT_FAILURE);
+   }
+   return reader;
+}
+
+long StreamReader_Next(struct StreamReader *reader, const char **block)
+{
+   pthread_mutex_lock(&reader->lock);
+   if (reader->next > 0 && !reader->ended)
+   { /* the previous block can be filled again */
+      reader->full[(reader->next - 1) & 1] = 0;
+      pthread_cond_broadcast(&reader->cond);
+   }
+   if (reader->ended)
+   {
+      pthread_mutex_unlock(&reader->lock);
+      *block = NULL;
+      return 0;
+   }
+   int b = (int)(reader->next & 1);
+   while (!reader->full[b])
+      pthread_cond_wait(&reader->cond, &reader->lock);
+   long n = reader->lengths[b];
+   if (reader->last[b])
+   {
+      reader->ended = 1;
+      if (reader->error != 0)
+      {
+         errno = reader->error;
+         err(1, "read %s", reader->name);
+      }
+   }
+   ++reader->next;
+   pthread_mutex_unlock(&reader->lock);
+   *block = reader->buffers[b];
+   return n;
+}
+
+void StreamReader_Close(struct StreamReader *reader)
+{
+   pthread_cancel(reader->thread); /* it may be blocked in read, waiting for a writer */
+   pthread_join(reader->thread, NULL);
+   pthread_mutex_destroy(&reader->lock);
+   pthread_cond_destroy(&reader->cond);
+   free(reader->buffers[0]);
+   free(reader->buffers[1]);
+   free(reader->name);
+   free(reader);
+}
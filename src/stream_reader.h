@@ -0,0 +1,48 @@
+/**
+ * \file stream_reader.h
+ * \brief double-buffered reader of a stream (pipe, FIFO, terminal) by a background thread
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * A stream cannot be mapped in virtual memory (mmap needs a regular file). A StreamReader reads it by blocks of
+ * STREAM_READER_BLOCK bytes in a thread of its own, into two buffers: while the caller processes a block, the thread
+ * fills the other one, so the reads overlap the processing (and the process writing the stream is not blocked on a
+ * full pipe meanwhile).
+ */
+
+#ifndef __STREAM_READER_H__
+#define __STREAM_READER_H__
+
+/** \def STREAM_READER_BLOCK
+ * \brief size of a buffer of a StreamReader, in bytes
+ */
+#define STREAM_READER_BLOCK (1L << 20)
+
+/**
+ * \struct StreamReader
+ * \brief opaque reader of a stream (cf stream_reader.c)
+ */
+struct StreamReader;
+
+/**
+ * \fn struct StreamReader *StreamReader_Open(int fd, const char *name);
+ * \brief starts reading the file descriptor fd (named name in the messages); exits with a message on failure
+ */
+struct StreamReader *StreamReader_Open(int fd, const char *name);
+
+/**
+ * \fn long StreamReader_Next(struct StreamReader *reader, const char **block);
+ * \brief waits for the next block of the stream, and returns its length (0 at the end of the stream)
+ * \param block : receives the address of the block, valid until the next call of StreamReader_Next or StreamReader_Close
+ *
+ * Exits with a message if the stream cannot be read.
+ */
+long StreamReader_Next(struct StreamReader *reader, const char **block);
+
+/**
+ * \fn void StreamReader_Close(struct StreamReader *reader);
+ * \brief stops reading (the rest of the stream is not read) and frees reader; fd is not closed
+ */
+void StreamReader_Close(struct StreamReader *reader);
+
+#endif /* __STREAM_READER_H__ */
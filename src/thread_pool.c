@@ -0,0 +1,309 @@
+/**
+ * \file thread_pool.c
+ * \brief implementation of the pool of threads with work stealing
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see thread_pool.h
+ */
+
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h> /* for sysconf */
+
+/** \struct ThreadPool_Task
+ * \brief a task: the function to call, its argument and the group it belongs to
+ */
+struct ThreadPool_Task
+{
+   void (*run)(void *);            /*!< function executed by the task */
+   void *arg;                      /*!< argument of run */
+   struct ThreadPool_Group *group; /*!< group of the task */
+};
+
+/** \struct ThreadPool_Deque
+ * \brief circular array of tasks, protected by a lock: the owner uses the bottom, thieves the top
+ */
+struct ThreadPool_Deque
+{
+   pthread_mutex_t lock;          /*!< protects all the fields */
+   struct ThreadPool_Task *tasks; /*!< circular array of capacity elements */
+   size_t capacity;               /*!< allocated number of tasks */
+   size_t top;                    /*!< index of the oldest task */
+   size_t count;                  /*!< number of tasks in the deque */
+};
+
+struct ThreadPool
+{
+   int nthreads;                    /*!< number of threads executing tasks, including the waiting one */
+   pthread_t *threads;              /*!< the nthreads-1 created threads */
+   struct ThreadPool_Deque *deques; /*!< deques[0..nthreads-2] for the created threads, deques[nthreads-1] shared by the others */
+   atomic_long queued;              /*!< number of tasks in all the deques */
+   pthread_mutex_t idle_lock;       /*!< lock for the condition below */
+   pthread_cond_t idle_cond;        /*!< signaled when a task is queued or a group is done */
+   int stop;                        /*!< set by ThreadPool_Destroy */
+};
+
+/** \var static __thread int _worker_index
+ * \brief index of the deque of the calling thread in the pool it belongs to (-1 if it is not a thread of a pool)
+ */
+static __thread int _worker_index = -1;
+
+/** \var static __thread struct ThreadPool *_worker_pool
+ * \brief pool the calling thread belongs to (NULL if none)
+ */
+static __thread struct ThreadPool *_worker_pool = NULL;
+
+static void _ThreadPool_DequeInit(struct ThreadPool_Deque *dq)
+{
+   pthread_mutex_init(&dq->lock, NULL);
+   dq->capacity = 64;
+   dq->tasks = (struct ThreadPool_Task *)malloc(dq->capacity * sizeof(struct ThreadPool_Task));
+   if (dq->tasks == NULL)
+   {
+      perror("ThreadPool: malloc of deque");
+      exit(EXIT_FAILURE);
+   }
+   dq->top = 0;
+   dq->count = 0;
+}
+
+static void _ThreadPool_DequePushBottom(struct ThreadPool_Deque *dq, struct ThreadPool_Task task)
+{
+   pthread_mutex_lock(&dq->lock);
+   if (dq->count == dq->capacity)
+   { /* double the capacity, moving the tasks to 0..count-1 */
+      struct ThreadPool_Task *tasks = (struct ThreadPool_Task *)malloc(2 * dq->capacity * sizeof(struct ThreadPool_Task));
+      if (tasks == NULL)
+      {
+         perror("ThreadPool: malloc of deque");
+         exit(EXIT_FAILURE);
+      }
+      for (size_t k = 0; k < dq->count; ++k)
+         tasks[k] = dq->tasks[(dq->top + k) % dq->capacity];
+      free(dq->tasks);
+      dq->tasks = tasks;
+      dq->capacity *= 2;
+      dq->top = 0;
+   }
+   dq->tasks[(dq->top + dq->count) % dq->capacity] = task;
+   dq->count++;
+   pthread_mutex_unlock(&dq->lock);
+}
+
+/*
+ * \brief removes a task from the bottom (newest, if bottom) or the top (oldest) of the deque; returns 0 if it is empty
+ */
+static int _ThreadPool_DequeTake(struct ThreadPool_Deque *dq, int bottom, struct ThreadPool_Task *task)
+{
+   int found = 0;
+   pthread_mutex_lock(&dq->lock);
+   if (dq->count > 0)
+   {
+      if (bottom)
+         *task = dq->tasks[(dq->top + dq->count - 1) % dq->capacity];
+      else
+      {
+         *task = dq->tasks[dq->top];
+         dq->top = (dq->top + 1) % dq->capacity;
+      }
+      dq->count--;
+      found = 1;
+   }
+   pthread_mutex_unlock(&dq->lock);
+   return found;
+}
+
+/*
+ * \brief takes a task for the thread owning deque self: from its own deque first, else steals one from the others
+ */
+static int _ThreadPool_Take(struct ThreadPool *pool, int self, struct ThreadPool_Task *task)
+{
+   if (atomic_load(&pool->queued) == 0)
+      return 0;
+   if (_ThreadPool_DequeTake(&pool->deques[self], 1, task))
+      goto found;
+   for (int k = 1; k < pool->nthreads; ++k)
+   {
+      if (_ThreadPool_DequeTake(&pool->deques[(self + k) % pool->nthreads], 0, task))
+         goto found;
+   }
+   return 0;
+found:
+   atomic_fetch_sub(&pool->queued, 1);
+   return 1;
+}
+
+static void _ThreadPool_Run(struct ThreadPool *pool, struct ThreadPool_Task task)
+{
+   task.run(task.arg);
+   if (atomic_fetch_sub(&task.group->pending, 1) == 1)
+   { /* last task of the group: wake up the threads waiting for it */
+      pthread_mutex_lock(&pool->idle_lock);
+      pthread_cond_broadcast(&pool->idle_cond);
+      pthread_mutex_unlock(&pool->idle_lock);
+   }
+}
+
+/*
+ * \brief index of the deque used by the calling thread for pool
+ */
+static int _ThreadPool_Self(struct ThreadPool *pool)
+{
+   return (_worker_pool == pool) ? _worker_index : pool->nthreads - 1;
+}
+
+struct ThreadPool_WorkerArg
+{
+   struct ThreadPool *pool;
+   int index;
+};
+
+static void *_ThreadPool_Worker(void *varg)
+{
+   struct ThreadPool_WorkerArg *arg = (struct ThreadPool_WorkerArg *)varg;
+   struct ThreadPool *pool = arg->pool;
+   _worker_pool = pool;
+   _worker_index = arg->index;
+   free(arg);
+   for (;;)
+   {
+      struct ThreadPool_Task task;
+      if (_ThreadPool_Take(pool, _worker_index, &task))
+      {
+         _ThreadPool_Run(pool, task);
+         continue;
+      }
+      pthread_mutex_lock(&pool->idle_lock);
+      while (!pool->stop && atomic_load(&pool->queued) == 0)
+         pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+      int stop = pool->stop;
+      pthread_mutex_unlock(&pool->idle_lock);
+      if (stop)
+         return NULL;
+   }
+}
+
+struct ThreadPool *ThreadPool_Create(int nthreads)
+{
+   if (nthreads <= 0)
+      nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if (nthreads <= 0)
+      nthreads = 1;
+   struct ThreadPool *pool = (struct ThreadPool *)malloc(sizeof(struct ThreadPool));
+   if (pool == NULL)
+   {
+      perror("ThreadPool_Create: malloc of pool");
+      exit(EXIT_FAILURE);
+   }
+   pool->nthreads = nthreads;
+   pool->deques = (struct ThreadPool_Deque *)malloc(nthreads * sizeof(struct ThreadPool_Deque));
+   pool->threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+   if (pool->deques == NULL || pool->threads == NULL)
+   {
+      perror("ThreadPool_Create: malloc of deques");
+      exit(EXIT_FAILURE);
+   }
+   for (int k = 0; k < nthreads; ++k)
+      _ThreadPool_DequeInit(&pool->deques[k]);
+   atomic_init(&pool->queued, 0);
+   pthread_mutex_init(&pool->idle_lock, NULL);
+   pthread_cond_init(&pool->idle_cond, NULL);
+   pool->stop = 0;
+   for (int k = 0; k < nthreads - 1; ++k)
+   {
+      struct ThreadPool_WorkerArg *arg = (struct ThreadPool_WorkerArg *)malloc(sizeof(struct ThreadPool_WorkerArg));
+      if (arg == NULL)
+      {
+         perror("ThreadPool_Create: malloc of worker argument");
+         exit(EXIT_FAILURE);
+      }
+      arg->pool = pool;
+      arg->index = k;
+      if (pthread_create(&pool->threads[k], NULL, _ThreadPool_Worker, arg) != 0)
+      {
+         perror("ThreadPool_Create: pthread_create");
+         exit(EXIT_FAILURE);
+      }
+   }
+   return pool;
+}
+
+void ThreadPool_Destroy(struct ThreadPool *pool)
+{
+   pthread_mutex_lock(&pool->idle_lock);
+   pool->stop = 1;
+   pthread_cond_broadcast(&pool->idle_cond);
+   pthread_mutex_unlock(&pool->idle_lock);
+   for (int k = 0; k < pool->nthreads - 1; ++k)
+      pthread_join(pool->threads[k], NULL);
+   for (int k = 0; k < pool->nthreads; ++k)
+   {
+      pthread_mutex_destroy(&pool->deques[k].lock);
+      free(pool->deques[k].tasks);
+   }
+   pthread_mutex_destroy(&pool->idle_lock);
+   pthread_cond_destroy(&pool->idle_cond);
+   free(pool->deques);
+   free(pool->threads);
+   free(pool);
+}
+
+int ThreadPool_Size(const struct ThreadPool *pool)
+{
+   return pool->nthreads;
+}
+
+void ThreadPool_Submit(struct ThreadPool *pool, struct ThreadPool_Group *group, void (*run)(void *), void *arg)
+{
+   struct ThreadPool_Task task = {run, arg, group};
+   atomic_fetch_add(&group->pending, 1);
+   _ThreadPool_DequePushBottom(&pool->deques[_ThreadPool_Self(pool)], task);
+   atomic_fetch_add(&pool->queued, 1);
+   pthread_mutex_lock(&pool->idle_lock);
+   pthread_cond_signal(&pool->idle_cond);
+   pthread_mutex_unlock(&pool->idle_lock);
+}
+
+void ThreadPool_Wait(struct ThreadPool *pool, struct ThreadPool_Group *group)
+{
+   int self = _ThreadPool_Self(pool);
+   while (atomic_load(&group->pending) > 0)
+   {
+      struct ThreadPool_Task task;
+      if (_ThreadPool_Take(pool, self, &task))
+      {
+         _ThreadPool_Run(pool, task);
+         continue;
+      }
+      pthread_mutex_lock(&pool->idle_lock);
+      if (atomic_load(&group->pending) > 0 && atomic_load(&pool->queued) == 0)
+         pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+      pthread_mutex_unlock(&pool->idle_lock);
+   }
+}
+
+/*****************************************************************************/
+/* Default pool shared by the engines */
+
+static int _default_size = 0;
+static struct ThreadPool *_default_pool = NULL;
+static pthread_once_t _default_once = PTHREAD_ONCE_INIT;
+
+static void _ThreadPool_CreateDefault(void)
+{
+   _default_pool = ThreadPool_Create(_default_size);
+}
+
+struct ThreadPool *ThreadPool_Default(void)
+{
+   pthread_once(&_default_once, _ThreadPool_CreateDefault);
+   return _default_pool;
+}
+
+void ThreadPool_SetDefaultSize(int nthreads)
+{
+   _default_size = nthreads;
+}
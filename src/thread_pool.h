@@ -0,0 +1,86 @@
+/**
+ * \file thread_pool.h
+ * \brief pool of threads with work stealing, to execute tasks (eg blocks of the dynamic programming matrix) in parallel
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Each thread of the pool owns a deque of tasks: it pushes and pops the tasks it creates at the bottom of its deque
+ * (last in first out, which keeps data in its cache), and when its deque is empty it steals the oldest task at the
+ * top of the deque of another thread. The tasks submitted by a thread that is not in the pool go to a shared deque.
+ *
+ * Tasks are gathered in groups: ThreadPool_Wait(pool, group) returns when all the tasks of the group
+ * (including the tasks submitted by tasks of the group) are done. The waiting thread executes tasks while waiting,
+ * so a task may itself submit tasks and wait for them (fork-join) without blocking a thread of the pool.
+ */
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <stdatomic.h>
+
+/**
+ * \struct ThreadPool
+ * \brief opaque pool of threads (cf thread_pool.c)
+ */
+struct ThreadPool;
+
+/**
+ * \struct ThreadPool_Group
+ * \brief group of tasks that can be waited for; has to be initialized by THREADPOOL_GROUP_INIT
+ */
+struct ThreadPool_Group
+{
+   atomic_long pending; /*!< number of tasks of the group that are submitted but not done */
+};
+
+/** \def THREADPOOL_GROUP_INIT
+ * \brief initial value of a struct ThreadPool_Group
+ */
+#define THREADPOOL_GROUP_INIT {0}
+
+/**
+ * \fn struct ThreadPool *ThreadPool_Create(int nthreads);
+ * \brief creates a pool of nthreads threads (the number of online processors if nthreads <= 0)
+ *
+ * The thread that calls ThreadPool_Wait is one of the nthreads: only nthreads-1 threads are created.
+ */
+struct ThreadPool *ThreadPool_Create(int nthreads);
+
+/**
+ * \fn void ThreadPool_Destroy(struct ThreadPool *pool);
+ * \brief stops and frees the pool; all the groups have to be waited for before
+ */
+void ThreadPool_Destroy(struct ThreadPool *pool);
+
+/**
+ * \fn int ThreadPool_Size(const struct ThreadPool *pool);
+ * \brief returns the number of threads that execute the tasks of the pool
+ */
+int ThreadPool_Size(const struct ThreadPool *pool);
+
+/**
+ * \fn void ThreadPool_Submit(struct ThreadPool *pool, struct ThreadPool_Group *group, void (*task)(void *), void *arg);
+ * \brief submits the execution of task(arg) as part of group
+ */
+void ThreadPool_Submit(struct ThreadPool *pool, struct ThreadPool_Group *group, void (*task)(void *), void *arg);
+
+/**
+ * \fn void ThreadPool_Wait(struct ThreadPool *pool, struct ThreadPool_Group *group);
+ * \brief returns when all the tasks of group are done; the calling thread executes tasks meanwhile
+ */
+void ThreadPool_Wait(struct ThreadPool *pool, struct ThreadPool_Group *group);
+
+/**
+ * \fn struct ThreadPool *ThreadPool_Default(void);
+ * \brief returns the pool shared by the engines of the program, created at the first call
+ * with the number of threads given by ThreadPool_SetDefaultSize (default: number of online processors)
+ */
+struct ThreadPool *ThreadPool_Default(void);
+
+/**
+ * \fn void ThreadPool_SetDefaultSize(int nthreads);
+ * \brief sets the number of threads of the pool returned by ThreadPool_Default; must be called before its first call
+ */
+void ThreadPool_SetDefaultSize(int nthreads);
+
+#endif /* __THREAD_POOL_H__ */
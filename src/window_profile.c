@@ -0,0 +1,132 @@
+/**
+ * \file window_profile.c
+ * \brief implementation of the windowed mode
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Documentation: see window_profile.h
+ *
+ * The distance of a window is a global distance: its first row and column start from the beginning of the window,
+ * so the columns of a window cannot be reused for the next one (they start from a different boundary). The work
+ * shared by the windows is the encoding, done once; the windows, independent, are computed in parallel.
+ */
+
+#include "window_profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include "characters_to_base.h" /* for the codes */
+#include "thread_pool.h"
+
+/** \def WINDOW_PROFILE_TASKS_PER_THREAD
+ * \brief number of tasks per thread of the pool (the windows of a task are consecutive)
+ */
+#define WINDOW_PROFILE_TASKS_PER_THREAD 8
+
+/** \struct WindowProfileTask
+ * \brief the windows first..last-1, computed by a task
+ */
+struct WindowProfileTask
+{
+   const struct EncodedSequence *A; /*!< the first sequence */
+   const struct EncodedSequence *B; /*!< the second sequence */
+   long window;                     /*!< number of bases of a window */
+   long step;                       /*!< number of bases between two windows */
+   enum NW_Engine engine;           /*!< engine computing the distances */
+   long first;                      /*!< first window */
+   long last;                       /*!< window after the last one */
+   long *distances;                 /*!< distances[k] receives the distance of window k */
+};
+
+/*
+ * \brief copies the bases [start, start+window( of seq (clipped to its end) in part, with the padding of the codes
+ */
+static void _WindowProfile_Cut(const struct EncodedSequence *seq, long start, long window, struct EncodedSequence *part)
+{
+   size_t from = ((size_t)start < seq->length) ? (size_t)start : seq->length;
+   size_t to = (from + (size_t)window < seq->length) ? from + (size_t)window : seq->length;
+   EncodedSequence_Reserve(part, to - from);
+   memcpy(part->codes, seq->codes + from, to - from);
+   memset(part->codes + (to - from), SKIP_BASE, ENCODED_SEQUENCE_PADDING);
+   part->length = to - from;
+   part->skipped = 0;
+}
+
+static void _WindowProfile_RunTask(void *arg)
+{
+   struct WindowProfileTask *task = (struct WindowProfileTask *)arg;
+   struct NW_Workspace *ws = NW_Workspace_Create();
+   struct EncodedSequence partA = ENCODED_SEQUENCE_EMPTY, partB = ENCODED_SEQUENCE_EMPTY;
+   char *charsA = NULL, *charsB = NULL; // the windows as characters, for the engines that are not auto
+   int auto_engine = (task->engine == NW_ENGINE_AUTO || task->engine == NW_ENGINE_AUTO_PAR);
+   if (!auto_engine)
+   {
+      charsA = (char *)malloc(task->window + 1);
+      charsB = (char *)malloc(task->window + 1);
+      if (charsA == NULL || charsB == NULL)
+      {
+         perror("_WindowProfile_RunTask: malloc of the windows");
+         exit(EXIT_FAILURE);
+      }
+   }
+   for (long k = task->first; k < task->last; ++k)
+   {
+      _WindowProfile_Cut(task->A, k * task->step, task->window, &partA);
+      _WindowProfile_Cut(task->B, k * task->step, task->window, &partB);
+      if (auto_engine) /* the windows are already computed in parallel */
+         task->distances[k] = EditDistance_NW_Encoded(ws, &partA, &partB, NULL, NW_ENGINE_AUTO, NULL);
+      else
+      {
+         DecodeSequence(&partA, charsA);
+         DecodeSequence(&partB, charsB);
+         task->distances[k] = EditDistance_NW_Dispatch(ws, charsA, partA.length, charsB, partB.length, task->engine, NULL);
+      }
+   }
+   free(charsA);
+   free(charsB);
+   EncodedSequence_Free(&partA);
+   EncodedSequence_Free(&partB);
+   NW_Workspace_Free(ws);
+}
+
+void WindowProfile_Run(const struct EncodedSequence *A, const struct EncodedSequence *B, long window, long step,
+                       enum NW_Engine engine, FILE *out)
+{
+   long length = (long)((A->length > B->length) ? A->length : B->length);
+   long nwindows = (length <= window) ? 1 : (length - window + step - 1) / step + 1; // the last one reaches the end
+   long *distances = (long *)malloc(nwindows * sizeof(long));
+   struct ThreadPool *pool = ThreadPool_Default();
+   long ntasks = WINDOW_PROFILE_TASKS_PER_THREAD * ThreadPool_Size(pool);
+   if (ntasks > nwindows)
+      ntasks = nwindows;
+   struct WindowProfileTask *tasks = (struct WindowProfileTask *)malloc(ntasks * sizeof(struct WindowProfileTask));
+   if (distances == NULL || tasks == NULL)
+   {
+      perror("WindowProfile_Run: malloc of the windows");
+      exit(EXIT_FAILURE);
+   }
+   struct ThreadPool_Group group = THREADPOOL_GROUP_INIT;
+   for (long t = 0; t < ntasks; ++t)
+   {
+      struct WindowProfileTask *task = &tasks[t];
+      task->A = A;
+      task->B = B;
+      task->window = window;
+      task->step = step;
+      task->engine = engine;
+      task->first = t * nwindows / ntasks;
+      task->last = (t + 1) * nwindows / ntasks;
+      task->distances = distances;
+      ThreadPool_Submit(pool, &group, _WindowProfile_RunTask, task);
+   }
+   ThreadPool_Wait(pool, &group);
+
+   fprintf(out, "# start\tend\tdistance\n");
+   for (long k = 0; k < nwindows; ++k)
+   {
+      long start = k * step;
+      long end = (start + window < length) ? start + window : length;
+      fprintf(out, "%ld\t%ld\t%ld\n", start, end, distances[k]);
+   }
+   free(tasks);
+   free(distances);
+}
@@ -0,0 +1,32 @@
+/**
+ * \file window_profile.h
+ * \brief windowed mode: profile of the distances between two sequences along windows, to localize divergent regions
+ * \version 0.1
+ * \date 16/10/2026
+ *
+ * Window k covers the bases [k*step, k*step+window( of both sequences (clipped to their ends); the windows follow each
+ * other until the end of the longest sequence. Both sequences are encoded once (cf sequence_encoding.h), and the
+ * windows are computed in parallel by the default pool of threads, by tasks of consecutive windows.
+ *
+ * The output is a table with one line per window, in the order of the windows:
+ *    # start<tab>end<tab>distance
+ *    start<tab>end<tab>distance
+ *    ...
+ * where start and end are the positions in bases of the window (counted from 0, end excluded).
+ */
+
+#ifndef __WINDOW_PROFILE_H__
+#define __WINDOW_PROFILE_H__
+
+#include <stdio.h>
+#include "Needleman-Wunsch-recmemo.h"
+
+/**
+ * \fn void WindowProfile_Run(const struct EncodedSequence *A, const struct EncodedSequence *B, long window, long step, enum NW_Engine engine, FILE *out);
+ * \brief computes with engine the distance between A and B in each window of window bases, every step bases,
+ * and writes the table on out
+ */
+void WindowProfile_Run(const struct EncodedSequence *A, const struct EncodedSequence *B, long window, long step,
+                       enum NW_Engine engine, FILE *out);
+
+#endif /* __WINDOW_PROFILE_H__ */